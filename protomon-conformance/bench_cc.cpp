@@ -0,0 +1,463 @@
+// C++ protobuf side of the cross-language conformance benchmark.
+//
+// This tool loads every test case listed in testdata/*/tests.txt and times
+// decoding and encoding its .bin payload with the C++ generated code, so the
+// numbers line up with protomon's `benches/cross_language.rs` on the exact
+// same bytes.
+//
+// Usage:
+//   # Print one JSON line per test case and operation:
+//   bazel run //:bench_cc -- --testdata_dir=$(pwd)/testdata [--iterations=100000]
+//
+//   # Serve timing requests for the criterion bench (see below):
+//   bazel run //:bench_cc -- --testdata_dir=$(pwd)/testdata --serve
+//
+//   # Also load a generate_binaries --synthesize corpus, as category "corpus":
+//   bazel run //:bench_cc -- --testdata_dir=$(pwd)/testdata --corpus_dir=$(pwd)/bench_corpus
+//
+//   # Report only deterministic serialization, split into its two passes:
+//   bazel run //:bench_cc -- --testdata_dir=$(pwd)/testdata --ops=byte_size,write,deterministic
+//
+// Serve protocol:
+//   One request per stdin line, "<op> <category>/<test_name> <iterations>",
+//   where op is "decode", "encode", "byte_size", "write", "deterministic",
+//   "skip", "packed:<field>" or "touch:<percent>". The reply is one line
+//   holding the elapsed nanoseconds for that many iterations, or
+//   "error: <message>". Timing happens here, so process and pipe overhead is
+//   not measured. "space_used <id> <iterations>" instead replies with the
+//   bytes the parsed message holds (SpaceUsedLong), the C++ side of the
+//   memory comparison in benches/deep_nesting.rs; iterations is ignored.
+//   "serialized <id> <iterations>" replies with the length of the message's
+//   deterministic serialization on one line, followed by exactly that many
+//   raw bytes; benches/encode.rs checks protomon's output against them.
+//
+// "decode" parses into a reused message (ParseFromString clears it first) and
+// "encode" serializes into a reused string, the usual hot-loop idioms.
+// "deterministic" serializes with deterministic serialization (map entries
+// sorted by key) the way SerializeToString does it: ByteSizeLong computes and
+// caches every submessage's size, then SerializeWithCachedSizes writes into a
+// buffer of exactly that size. "byte_size" times only the first pass and
+// "write" only the second, reusing sizes cached before the loop, so the two
+// add up to "deterministic". All three, and "serialized", work on a copy of
+// the message without its unknown fields: protomon's generated types drop
+// unknown fields, so that is what they encode.
+// "packed:<field>" parses only the records of one packed field, exactly as
+// they appear in the payload, so it times RepeatedField parsing of the bytes
+// benches/packed_corpus.rs decodes with ProtoPacked.
+// "touch:<percent>" parses an Outer with the generated code and then reads
+// every (100 / percent)-th item's fields, the eager side of the lazy-access
+// comparison in benches/lazy_access.rs.
+// "skip" walks the payload without parsing it, skipping every field with
+// WireFormatLite::SkipField and stepping into each top-level length-delimited
+// field to skip its fields too: the cost of skipping a container of records,
+// with nothing retained. benches/unknown_fields.rs compares it with "decode",
+// which keeps a NarrowRecords payload's extra fields in UnknownFieldSets.
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/wire_format_lite.h"
+
+#include "protos/scalars.pb.h"
+#include "protos/repeated.pb.h"
+#include "protos/nested.pb.h"
+#include "protos/edge_cases.pb.h"
+#include "protos/maps.pb.h"
+
+ABSL_FLAG(std::string, testdata_dir, "", "Directory containing the conformance testdata");
+ABSL_FLAG(std::string, corpus_dir, "",
+          "Optional generate_binaries --synthesize output, loaded as category \"corpus\"");
+ABSL_FLAG(bool, serve, false, "Answer timing requests on stdin instead of printing a report");
+ABSL_FLAG(int, iterations, 100000, "Iterations per test case and operation in report mode");
+ABSL_FLAG(std::vector<std::string>, ops, std::vector<std::string>({"decode", "encode"}),
+          "Operations to time in report mode, each on the test cases it applies to");
+
+// A conformance test case, parsed once so encode has something to serialize.
+struct BenchCase {
+  std::string id;  // "<category>/<test_name>"
+  std::string payload;
+  std::unique_ptr<google::protobuf::Message> message;
+  std::unique_ptr<google::protobuf::Message> scratch;
+  std::string buffer;
+  // Payloads holding a single field's records, by field name; see FieldPayload.
+  std::map<std::string, std::string> field_payloads;
+  // `message` without its unknown fields; see KnownFields.
+  std::unique_ptr<google::protobuf::Message> known;
+};
+
+// Prefix of the ops that time parsing a single packed field.
+constexpr absl::string_view kPackedOpPrefix = "packed:";
+
+// Prefix of the ops that time a full Outer parse followed by reading a
+// percentage of its items.
+constexpr absl::string_view kTouchOpPrefix = "touch:";
+
+// Receives what the touch and skip ops read, so the reads aren't optimized
+// away.
+volatile int64_t read_sink;
+
+// Simple path join
+std::string JoinPath(const std::string& a, const std::string& b) {
+  if (a.empty()) return b;
+  if (b.empty()) return a;
+  if (a.back() == '/') return a + b;
+  return a + "/" + b;
+}
+
+// Looks up a conformance message type in the generated pool. Referencing one
+// descriptor from each file keeps their generated code linked in.
+const google::protobuf::Message* FindPrototype(const std::string& message_type) {
+  static const google::protobuf::DescriptorPool* pool = [] {
+    conformance::Scalars::descriptor();
+    conformance::RepeatedScalars::descriptor();
+    conformance::Outer::descriptor();
+    conformance::Empty::descriptor();
+    conformance::Maps::descriptor();
+    return google::protobuf::DescriptorPool::generated_pool();
+  }();
+
+  const google::protobuf::Descriptor* descriptor =
+      pool->FindMessageTypeByName("conformance." + message_type);
+  if (descriptor == nullptr) return nullptr;
+  return google::protobuf::MessageFactory::generated_factory()->GetPrototype(descriptor);
+}
+
+// Loads every test case listed in `category_dir`'s tests.txt, keyed by
+// "<category>/<test_name>".
+bool LoadCategory(const std::string& category_dir, const std::string& category,
+                  std::map<std::string, BenchCase>* cases) {
+  std::ifstream tests(JoinPath(category_dir, "tests.txt"));
+  if (!tests) {
+    std::cerr << "No tests.txt found in " << category_dir << std::endl;
+    return true;  // Not an error, just skip
+  }
+
+  std::string line;
+  while (std::getline(tests, line)) {
+    if (line.empty() || line[0] == '#') continue;
+
+    std::vector<std::string> parts = absl::StrSplit(line, ' ');
+    if (parts.size() != 2) {
+      std::cerr << "Invalid line in tests.txt: " << line << std::endl;
+      return false;
+    }
+
+    const google::protobuf::Message* prototype = FindPrototype(parts[1]);
+    if (prototype == nullptr) {
+      std::cerr << "Unknown message type: " << parts[1] << std::endl;
+      return false;
+    }
+
+    std::string bin_path = JoinPath(category_dir, parts[0] + ".bin");
+    std::ifstream bin(bin_path, std::ios::binary);
+    if (!bin) {
+      std::cerr << "Failed to open: " << bin_path << std::endl;
+      return false;
+    }
+
+    BenchCase bench_case;
+    bench_case.id = absl::StrCat(category, "/", parts[0]);
+    bench_case.payload.assign(std::istreambuf_iterator<char>(bin),
+                              std::istreambuf_iterator<char>());
+    bench_case.message.reset(prototype->New());
+    bench_case.scratch.reset(prototype->New());
+    if (!bench_case.message->ParseFromString(bench_case.payload)) {
+      std::cerr << "Failed to parse: " << bin_path << std::endl;
+      return false;
+    }
+    std::string id = bench_case.id;
+    (*cases)[id] = std::move(bench_case);
+  }
+  return true;
+}
+
+// Returns the records of `field_name` copied out of `bench_case`'s payload,
+// tags included and in their original order, or null if the message has no
+// such field or the payload doesn't parse. Built on first use and cached.
+const std::string* FieldPayload(BenchCase* bench_case, const std::string& field_name) {
+  using google::protobuf::internal::WireFormatLite;
+
+  auto it = bench_case->field_payloads.find(field_name);
+  if (it != bench_case->field_payloads.end()) return &it->second;
+
+  const google::protobuf::FieldDescriptor* field =
+      bench_case->message->GetDescriptor()->FindFieldByName(field_name);
+  if (field == nullptr) return nullptr;
+
+  std::string records;
+  {
+    google::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const uint8_t*>(bench_case->payload.data()),
+        static_cast<int>(bench_case->payload.size()));
+    google::protobuf::io::StringOutputStream records_stream(&records);
+    google::protobuf::io::CodedOutputStream output(&records_stream);
+    while (uint32_t tag = input.ReadTag()) {
+      bool ok = WireFormatLite::GetTagFieldNumber(tag) == field->number()
+                    ? WireFormatLite::SkipField(&input, tag, &output)
+                    : WireFormatLite::SkipField(&input, tag);
+      if (!ok) return nullptr;
+    }
+    if (!input.ConsumedEntireMessage()) return nullptr;
+  }
+  return &(bench_case->field_payloads[field_name] = std::move(records));
+}
+
+// Returns `bench_case`'s message with its unknown fields discarded. Built on
+// first use and cached.
+const google::protobuf::Message& KnownFields(BenchCase* bench_case) {
+  if (bench_case->known == nullptr) {
+    bench_case->known.reset(bench_case->message->New());
+    bench_case->known->CopyFrom(*bench_case->message);
+    bench_case->known->DiscardUnknownFields();
+  }
+  return *bench_case->known;
+}
+
+// Serializes `message` deterministically into `buffer`, trusting the sizes a
+// ByteSizeLong() call that returned `size` cached.
+void WriteDeterministic(const google::protobuf::Message& message, size_t size,
+                        std::string* buffer) {
+  buffer->resize(size);
+  google::protobuf::io::ArrayOutputStream array(&(*buffer)[0], static_cast<int>(size));
+  google::protobuf::io::CodedOutputStream output(&array);
+  output.SetSerializationDeterministic(true);
+  message.SerializeWithCachedSizes(&output);
+}
+
+// Skips every field of `payload`, and every field inside its length-delimited
+// top-level fields. Returns the number of fields skipped, or -1 if the
+// payload doesn't parse.
+int64_t SkipRecords(const std::string& payload) {
+  using google::protobuf::internal::WireFormatLite;
+
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(payload.data()), static_cast<int>(payload.size()));
+  int64_t skipped = 0;
+  while (uint32_t tag = input.ReadTag()) {
+    skipped++;
+    if (WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      if (!WireFormatLite::SkipField(&input, tag)) return -1;
+      continue;
+    }
+    uint32_t length;
+    if (!input.ReadVarint32(&length)) return -1;
+    google::protobuf::io::CodedInputStream::Limit limit = input.PushLimit(length);
+    while (uint32_t inner_tag = input.ReadTag()) {
+      skipped++;
+      if (!WireFormatLite::SkipField(&input, inner_tag)) return -1;
+    }
+    if (!input.ConsumedEntireMessage()) return -1;
+    input.PopLimit(limit);
+  }
+  return input.ConsumedEntireMessage() ? skipped : -1;
+}
+
+// Runs `op` on `bench_case` `iterations` times and returns the elapsed time.
+// Returns a negative value for an unknown op or field, or a payload "skip"
+// cannot walk.
+int64_t TimeOp(const std::string& op, BenchCase* bench_case, uint64_t iterations) {
+  using Clock = std::chrono::steady_clock;
+
+  if (absl::StartsWith(op, kPackedOpPrefix)) {
+    const std::string* records =
+        FieldPayload(bench_case, op.substr(kPackedOpPrefix.size()));
+    if (records == nullptr) return -1;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      bench_case->scratch->ParseFromString(*records);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  }
+
+  if (absl::StartsWith(op, kTouchOpPrefix)) {
+    auto* outer = dynamic_cast<conformance::Outer*>(bench_case->scratch.get());
+    int percent;
+    if (outer == nullptr ||
+        !absl::SimpleAtoi(op.substr(kTouchOpPrefix.size()), &percent) || percent <= 0 ||
+        percent > 100) {
+      return -1;
+    }
+    const int stride = 100 / percent;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      outer->ParseFromString(bench_case->payload);
+      int64_t sum = 0;
+      for (int j = 0; j < outer->items_size(); j += stride) {
+        sum += outer->items(j).value() + outer->items(j).name().size();
+      }
+      read_sink = sum;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  }
+
+  if (op == "deterministic" || op == "byte_size" || op == "write") {
+    const google::protobuf::Message& known = KnownFields(bench_case);
+    // The sizes ByteSizeLong caches stay valid for "write": the message never
+    // changes.
+    const size_t cached_size = known.ByteSizeLong();
+    size_t size = 0;
+    Clock::time_point start = Clock::now();
+    if (op == "deterministic") {
+      for (uint64_t i = 0; i < iterations; i++) {
+        WriteDeterministic(known, known.ByteSizeLong(), &bench_case->buffer);
+      }
+    } else if (op == "byte_size") {
+      for (uint64_t i = 0; i < iterations; i++) {
+        size += known.ByteSizeLong();
+      }
+    } else {
+      for (uint64_t i = 0; i < iterations; i++) {
+        WriteDeterministic(known, cached_size, &bench_case->buffer);
+      }
+    }
+    read_sink = static_cast<int64_t>(size);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  }
+
+  Clock::time_point start = Clock::now();
+  if (op == "decode") {
+    for (uint64_t i = 0; i < iterations; i++) {
+      bench_case->scratch->ParseFromString(bench_case->payload);
+    }
+  } else if (op == "skip") {
+    int64_t skipped = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+      int64_t fields = SkipRecords(bench_case->payload);
+      if (fields < 0) return -1;
+      skipped += fields;
+    }
+    read_sink = skipped;
+  } else if (op == "encode") {
+    for (uint64_t i = 0; i < iterations; i++) {
+      bench_case->message->SerializeToString(&bench_case->buffer);
+    }
+  } else {
+    return -1;
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// Answers timing requests from stdin until EOF.
+int Serve(std::map<std::string, BenchCase>* cases) {
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream request(line);
+    std::string op;
+    std::string id;
+    uint64_t iterations = 0;
+    if (!(request >> op >> id >> iterations)) {
+      std::cout << "error: malformed request: " << line << std::endl;
+      continue;
+    }
+
+    auto it = cases->find(id);
+    if (it == cases->end()) {
+      std::cout << "error: unknown test case: " << id << std::endl;
+      continue;
+    }
+
+    if (op == "space_used") {
+      BenchCase& bench_case = it->second;
+      bench_case.scratch->ParseFromString(bench_case.payload);
+      std::cout << bench_case.scratch->SpaceUsedLong() << std::endl;
+      continue;
+    }
+    if (op == "serialized") {
+      BenchCase& bench_case = it->second;
+      const google::protobuf::Message& known = KnownFields(&bench_case);
+      WriteDeterministic(known, known.ByteSizeLong(), &bench_case.buffer);
+      std::cout << bench_case.buffer.size() << "\n";
+      std::cout.write(bench_case.buffer.data(), bench_case.buffer.size());
+      std::cout.flush();
+      continue;
+    }
+
+    int64_t elapsed_ns = TimeOp(op, &it->second, iterations);
+    if (elapsed_ns < 0) {
+      std::cout << "error: cannot run " << op << " on " << id << std::endl;
+      continue;
+    }
+    std::cout << elapsed_ns << std::endl;
+  }
+  return 0;
+}
+
+// Times every test case and prints one JSON object per line. Cases an op
+// doesn't apply to (a packed field they lack, "touch" on anything but an
+// Outer, "skip" on a payload that isn't a container of records) are left out;
+// an op that applies to no case at all is an error.
+int Report(std::map<std::string, BenchCase>* cases, int iterations,
+           const std::vector<std::string>& ops) {
+  std::map<std::string, int> timed_cases;
+  for (auto& [id, bench_case] : *cases) {
+    for (const std::string& op : ops) {
+      // One untimed pass to warm caches and the allocator, which also finds
+      // out whether the op applies.
+      if (TimeOp(op, &bench_case, iterations / 10 + 1) < 0) continue;
+      int64_t elapsed_ns = TimeOp(op, &bench_case, iterations);
+      timed_cases[op]++;
+
+      double ns_per_op = static_cast<double>(elapsed_ns) / iterations;
+      double mb_per_sec = ns_per_op > 0 ? bench_case.payload.size() * 1e3 / ns_per_op : 0;
+      std::cout << "{\"case\":\"" << id << "\",\"message\":\""
+                << bench_case.message->GetDescriptor()->full_name() << "\",\"op\":\"" << op
+                << "\",\"bytes\":" << bench_case.payload.size() << ",\"ns_per_op\":" << ns_per_op
+                << ",\"mb_per_sec\":" << mb_per_sec << "}" << std::endl;
+    }
+  }
+  for (const std::string& op : ops) {
+    if (timed_cases[op] == 0) {
+      std::cerr << "Error: no test case to run " << op << " on" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+
+  std::string testdata_dir = absl::GetFlag(FLAGS_testdata_dir);
+  if (testdata_dir.empty()) {
+    std::cerr << "Error: --testdata_dir is required" << std::endl;
+    return 1;
+  }
+
+  std::map<std::string, BenchCase> cases;
+  for (const std::string category : {"scalars", "repeated", "nested", "edge_cases", "maps"}) {
+    if (!LoadCategory(JoinPath(testdata_dir, category), category, &cases)) return 1;
+  }
+  std::string corpus_dir = absl::GetFlag(FLAGS_corpus_dir);
+  if (!corpus_dir.empty() && !LoadCategory(corpus_dir, "corpus", &cases)) return 1;
+  std::cerr << "Loaded " << cases.size() << " test cases" << std::endl;
+
+  if (absl::GetFlag(FLAGS_serve)) {
+    return Serve(&cases);
+  }
+
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  if (iterations <= 0) {
+    std::cerr << "Error: --iterations must be positive" << std::endl;
+    return 1;
+  }
+  return Report(&cases, iterations, absl::GetFlag(FLAGS_ops));
+}
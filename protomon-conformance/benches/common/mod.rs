@@ -0,0 +1,277 @@
+//! Corpus loading, message type dispatch, the `bench_cc` client and heap
+//! accounting, shared by the benches that compare protomon with C++ protobuf
+//! on the same payloads.
+
+// Each bench uses its own subset of these helpers.
+#![allow(dead_code, unused_macros)]
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::io::{BufRead, BufReader, Read, Write};
+use std::path::{Path, PathBuf};
+use std::process::{Child, ChildStdin, ChildStdout, Command, Stdio};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::Duration;
+
+use bytes::Bytes;
+
+/// The testdata categories, each a directory with a `tests.txt`.
+pub const CATEGORIES: &[&str] = &["scalars", "repeated", "nested", "edge_cases", "maps"];
+
+/// Call `$f::<T>($args)` where `T` is the generated type named `$name`.
+macro_rules! with_message_type {
+    ($name:expr, $f:ident $args:tt, [$($ty:ident),* $(,)?]) => {
+        match $name {
+            $(stringify!($ty) => $f::<protomon_conformance::protos::conformance::$ty> $args,)*
+            other => panic!("Unknown message type: {}", other),
+        }
+    };
+}
+
+/// Call `$f::<T>($args)` where `T` is the generated type of every top-level
+/// conformance message named `$name`. Benches using it declare
+/// `#[macro_use] mod common;`.
+macro_rules! dispatch {
+    ($name:expr, $f:ident $args:tt) => {
+        with_message_type!($name, $f $args, [
+            // Scalars
+            Scalars, Int32Value, Int64Value, Uint32Value, Uint64Value, Sint32Value, Sint64Value,
+            BoolValue, Fixed32Value, Sfixed32Value, Fixed64Value, Sfixed64Value, FloatValue,
+            DoubleValue, StringValue, BytesValue,
+            // Repeated
+            RepeatedScalars, RepeatedInt32, RepeatedInt64, RepeatedUint32, RepeatedUint64,
+            RepeatedSint32, RepeatedSint64, RepeatedBool, RepeatedFixed32, RepeatedSfixed32,
+            RepeatedFixed64, RepeatedSfixed64, RepeatedFloat, RepeatedDouble, RepeatedString,
+            RepeatedBytes,
+            // Nested
+            Outer, Level0, Node, OptionalNested,
+            // Edge cases
+            FieldNumbers, WireTypes, Empty, AllDefaults, OptionalFields, WideRecords, NarrowRecords,
+            // Maps
+            Maps, StringKeyMap, Int64KeyMap,
+        ])
+    };
+}
+
+/// A test case from a `tests.txt` manifest.
+pub struct Case {
+    pub category: &'static str,
+    pub name: String,
+    pub message_type: String,
+    pub payload: Bytes,
+}
+
+impl Case {
+    /// The id `bench_cc` knows this case by.
+    pub fn id(&self) -> String {
+        format!("{}/{}", self.category, self.name)
+    }
+}
+
+pub fn testdata_dir() -> PathBuf {
+    PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("testdata")
+}
+
+/// Names the `generate_binaries --synthesize` corpus for every bench that
+/// can run on one.
+pub const CORPUS_VAR: &str = "PROTOMON_BENCH_CORPUS";
+
+/// The synthetic corpus named by [`CORPUS_VAR`], if it is set.
+pub fn corpus_dir() -> Option<PathBuf> {
+    std::env::var_os(CORPUS_VAR).map(PathBuf::from)
+}
+
+/// The category and directory a bench runs on, and the `bench_cc` to compare
+/// with: the synthetic corpus, as category `corpus`, if [`CORPUS_VAR`] is
+/// set, and `testdata/<default_category>` otherwise.
+pub fn bench_corpus(default_category: &'static str) -> (&'static str, PathBuf, Option<CcBench>) {
+    match corpus_dir() {
+        Some(dir) => {
+            let cc = CcBench::for_corpus(Some(&dir));
+            ("corpus", dir, cc)
+        }
+        None => {
+            eprintln!("{} is not set; benchmarking testdata/{}", CORPUS_VAR, default_category);
+            let dir = testdata_dir().join(default_category);
+            (default_category, dir, CcBench::for_corpus(None))
+        }
+    }
+}
+
+/// Load the cases listed in `dir/tests.txt` as `category`.
+pub fn load_cases(category: &'static str, dir: &Path) -> Vec<Case> {
+    let manifest = std::fs::read_to_string(dir.join("tests.txt"))
+        .unwrap_or_else(|e| panic!("Failed to read {}/tests.txt: {}", dir.display(), e));
+
+    manifest
+        .lines()
+        .filter(|line| !line.is_empty() && !line.starts_with('#'))
+        .map(|line| {
+            let (name, message_type) = line
+                .split_once(' ')
+                .unwrap_or_else(|| panic!("Invalid line in tests.txt: {}", line));
+            let path = dir.join(format!("{}.bin", name));
+            let payload = std::fs::read(&path)
+                .unwrap_or_else(|e| panic!("Failed to read {:?}: {}", path, e));
+            Case {
+                category,
+                name: name.to_string(),
+                message_type: message_type.to_string(),
+                payload: Bytes::from(payload),
+            }
+        })
+        .collect()
+}
+
+/// A `bench_cc --serve` process that times operations on request.
+pub struct CcBench {
+    child: Child,
+    stdin: ChildStdin,
+    stdout: BufReader<ChildStdout>,
+}
+
+impl CcBench {
+    /// Spawn `bench_cc` on the testdata, with any extra flags in `args`.
+    pub fn spawn(path: &Path, args: &[String]) -> std::io::Result<Self> {
+        let mut child = Command::new(path)
+            .arg(format!("--testdata_dir={}", testdata_dir().display()))
+            .args(args)
+            .arg("--serve")
+            .stdin(Stdio::piped())
+            .stdout(Stdio::piped())
+            .spawn()?;
+        let stdin = child.stdin.take().expect("stdin is piped");
+        let stdout = BufReader::new(child.stdout.take().expect("stdout is piped"));
+        Ok(Self { child, stdin, stdout })
+    }
+
+    /// Spawn the `bench_cc` named by `PROTOMON_CC_BENCH`, if it is set.
+    pub fn from_env(args: &[String]) -> Option<Self> {
+        let cc = std::env::var_os("PROTOMON_CC_BENCH").map(|path| {
+            Self::spawn(Path::new(&path), args)
+                .unwrap_or_else(|e| panic!("Failed to spawn {:?}: {}", path, e))
+        });
+        if cc.is_none() {
+            eprintln!("PROTOMON_CC_BENCH is not set; benchmarking protomon only");
+        }
+        cc
+    }
+
+    /// [`from_env`](Self::from_env), also loading the synthetic `corpus` if
+    /// there is one.
+    pub fn for_corpus(corpus: Option<&Path>) -> Option<Self> {
+        let args: Vec<String> = corpus
+            .iter()
+            .map(|dir| format!("--corpus_dir={}", dir.display()))
+            .collect();
+        Self::from_env(&args)
+    }
+
+    /// `SpaceUsedLong()` of test case `id` parsed by C++.
+    pub fn space_used(&mut self, id: &str) -> u64 {
+        self.request("space_used", id, 1)
+    }
+
+    /// `", C++ SpaceUsedLong N B"` for `case`, to end a bench's summary
+    /// line, or nothing without `bench_cc`.
+    pub fn space_used_note(cc: &mut Option<Self>, case: &Case) -> String {
+        cc.as_mut()
+            .map(|cc| format!(", C++ SpaceUsedLong {} B", cc.space_used(&case.id())))
+            .unwrap_or_default()
+    }
+
+    /// Time `iters` runs of `op` on test case `id` inside the C++ process.
+    pub fn time(&mut self, op: &str, id: &str, iters: u64) -> Duration {
+        Duration::from_nanos(self.request(op, id, iters))
+    }
+
+    /// Send one request and return the number `bench_cc` replies with.
+    pub fn request(&mut self, op: &str, id: &str, iters: u64) -> u64 {
+        writeln!(self.stdin, "{} {} {}", op, id, iters).expect("bench_cc request failed");
+        let mut line = String::new();
+        self.stdout.read_line(&mut line).expect("bench_cc response failed");
+        line.trim()
+            .parse()
+            .unwrap_or_else(|_| panic!("bench_cc: {}", line.trim()))
+    }
+
+    /// The C++ deterministic serialization of test case `id`.
+    pub fn serialized(&mut self, id: &str) -> Vec<u8> {
+        let len = self.request("serialized", id, 0);
+        let mut bytes = vec![0; len as usize];
+        self.stdout.read_exact(&mut bytes).expect("bench_cc response failed");
+        bytes
+    }
+}
+
+impl Drop for CcBench {
+    fn drop(&mut self) {
+        let _ = self.child.kill();
+        let _ = self.child.wait();
+    }
+}
+
+/// The system allocator, tracking live and peak heap bytes and counting
+/// allocations. A bench that reports heap usage installs it with
+/// `#[global_allocator] static ALLOC: CountingAlloc = CountingAlloc;`.
+pub struct CountingAlloc;
+
+static LIVE_BYTES: AtomicUsize = AtomicUsize::new(0);
+static PEAK_BYTES: AtomicUsize = AtomicUsize::new(0);
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr = unsafe { System.alloc(layout) };
+        if !ptr.is_null() {
+            ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+            let live = LIVE_BYTES.fetch_add(layout.size(), Ordering::Relaxed) + layout.size();
+            PEAK_BYTES.fetch_max(live, Ordering::Relaxed);
+        }
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        unsafe { System.dealloc(ptr, layout) };
+        LIVE_BYTES.fetch_sub(layout.size(), Ordering::Relaxed);
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let new_ptr = unsafe { System.realloc(ptr, layout, new_size) };
+        if !new_ptr.is_null() {
+            ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+            LIVE_BYTES.fetch_sub(layout.size(), Ordering::Relaxed);
+            let live = LIVE_BYTES.fetch_add(new_size, Ordering::Relaxed) + new_size;
+            PEAK_BYTES.fetch_max(live, Ordering::Relaxed);
+        }
+        new_ptr
+    }
+}
+
+/// Heap activity while a closure ran.
+#[derive(Clone, Copy, Debug)]
+pub struct HeapUsage {
+    /// Peak heap growth, counting what the result still holds.
+    pub peak_bytes: usize,
+    /// Allocations and reallocations made.
+    pub allocations: usize,
+}
+
+/// Heap bytes currently allocated. Only meaningful in a bench that installs
+/// [`CountingAlloc`].
+pub fn live_bytes() -> usize {
+    LIVE_BYTES.load(Ordering::Relaxed)
+}
+
+/// Run `f` and return its result with the heap it used. Only meaningful in
+/// a bench that installs [`CountingAlloc`].
+pub fn heap_usage<R>(f: impl FnOnce() -> R) -> (R, HeapUsage) {
+    let baseline = LIVE_BYTES.load(Ordering::Relaxed);
+    PEAK_BYTES.store(baseline, Ordering::Relaxed);
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed);
+    let result = f();
+    let usage = HeapUsage {
+        peak_bytes: PEAK_BYTES.load(Ordering::Relaxed) - baseline,
+        allocations: ALLOCATIONS.load(Ordering::Relaxed) - allocations,
+    };
+    (result, usage)
+}
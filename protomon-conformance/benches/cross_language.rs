@@ -0,0 +1,74 @@
+//! Cross-language benchmark: protomon vs C++ protobuf on the conformance corpus.
+//!
+//! Every test case listed in `testdata/*/tests.txt` is decoded from its `.bin`
+//! payload and re-encoded with protomon's generated types. If
+//! `PROTOMON_CC_BENCH` points at the `bench_cc` binary (`bazel build
+//! //:bench_cc`), the same payloads also go through C++ generated code, timed
+//! inside that process, and its results land in the same criterion groups:
+//!
+//! ```text
+//! PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench cross_language
+//! ```
+//!
+//! Groups are `<op>/<category>`, with a `protomon/<test>` and a `cpp/<test>`
+//! entry per test case, so the criterion report compares them side by side.
+
+#[macro_use]
+mod common;
+
+use criterion::measurement::WallTime;
+use criterion::{criterion_group, criterion_main, BenchmarkGroup, BenchmarkId, Criterion, Throughput};
+use protomon::codec::ProtoMessage;
+
+use common::{load_cases, testdata_dir, Case, CcBench, CATEGORIES};
+
+fn bench_decode<T: ProtoMessage>(group: &mut BenchmarkGroup<'_, WallTime>, case: &Case) {
+    group.bench_with_input(
+        BenchmarkId::new("protomon", &case.name),
+        &case.payload,
+        |b, payload| b.iter(|| T::decode_message(std::hint::black_box(payload.clone())).unwrap()),
+    );
+}
+
+fn bench_encode<T: ProtoMessage>(group: &mut BenchmarkGroup<'_, WallTime>, case: &Case) {
+    let msg = T::decode_message(case.payload.clone()).unwrap();
+    let mut buf = Vec::with_capacity(msg.encoded_message_len());
+    group.bench_function(BenchmarkId::new("protomon", &case.name), |b| {
+        b.iter(|| {
+            buf.clear();
+            std::hint::black_box(&msg).encode_message(&mut buf);
+            std::hint::black_box(buf.len())
+        })
+    });
+}
+
+fn cross_language_benchmark(c: &mut Criterion) {
+    let mut cc = CcBench::from_env(&[]);
+
+    for &category in CATEGORIES {
+        let cases = load_cases(category, &testdata_dir().join(category));
+
+        for op in ["decode", "encode"] {
+            let mut group = c.benchmark_group(format!("{}/{}", op, category));
+            for case in &cases {
+                group.throughput(Throughput::Bytes(case.payload.len() as u64));
+                if op == "decode" {
+                    dispatch!(case.message_type.as_str(), bench_decode(&mut group, case));
+                } else {
+                    dispatch!(case.message_type.as_str(), bench_encode(&mut group, case));
+                }
+
+                if let Some(cc) = cc.as_mut() {
+                    let id = case.id();
+                    group.bench_function(BenchmarkId::new("cpp", &case.name), |b| {
+                        b.iter_custom(|iters| cc.time(op, &id, iters))
+                    });
+                }
+            }
+            group.finish();
+        }
+    }
+}
+
+criterion_group!(benches, cross_language_benchmark);
+criterion_main!(benches);
@@ -0,0 +1,147 @@
+//! Deep-recursion benchmark: protomon vs C++ protobuf on deeply nested `Node`s.
+//!
+//! Each `Node` test case is decoded three ways:
+//!
+//! * `eager`: decode the whole tree into owned nodes, recursing through every
+//!   child the way C++ parsing does.
+//! * `lazy_spine`: wrap the payload in a `LazyMessage` and decode on demand
+//!   along the first-child path only, leaving every sibling undecoded.
+//! * `cpp`: C++ `ParseFromString` of the same bytes, timed in `bench_cc`.
+//!
+//! Criterion only measures time, so each case also prints the peak heap
+//! growth of `eager` and `lazy_spine` (from a counting global allocator), the
+//! stack `eager` used at its deepest, and the bytes the parsed C++ message
+//! holds (`SpaceUsedLong`).
+//!
+//! The testdata trees are a few levels deep. For payloads nested up to C++'s
+//! recursion limit, point `PROTOMON_BENCH_CORPUS` at a `generate_binaries
+//! --synthesize` corpus, whose `node_spine_*` cases are 10 to 100 levels deep:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench deep_nesting
+//! ```
+
+mod common;
+
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use protomon::codec::{LazyMessage, ProtoMessage, Repeated};
+use protomon_conformance::protos::conformance::Node;
+
+use common::{bench_corpus, heap_usage, load_cases, Case, CcBench, CountingAlloc};
+
+#[global_allocator]
+static ALLOC: CountingAlloc = CountingAlloc;
+
+/// Lowest stack address `materialize` has reached, for the stack report.
+static STACK_LOW: AtomicUsize = AtomicUsize::new(usize::MAX);
+
+fn stack_address() -> usize {
+    let marker = 0u8;
+    std::hint::black_box(&marker) as *const u8 as usize
+}
+
+/// Decode `node` and all of its descendants into owned nodes.
+fn materialize(node: &Node) -> Node {
+    STACK_LOW.fetch_min(stack_address(), Ordering::Relaxed);
+    let children = node
+        .children
+        .iter()
+        .map(|child| Box::new(materialize(&child.unwrap())))
+        .collect();
+    Node {
+        id: node.id,
+        label: node.label.clone(),
+        children: Repeated::owned(children),
+    }
+}
+
+/// Number of nodes in a materialized tree.
+fn count_nodes(node: &Node) -> usize {
+    1 + node
+        .children
+        .iter()
+        .map(|child| count_nodes(&child.unwrap()))
+        .sum::<usize>()
+}
+
+/// Follow the first-child path from `node`, returning its depth and the id
+/// of the node it ends at. On a lazily decoded node this decodes one child
+/// per level and leaves every sibling undecoded.
+fn follow_spine(mut node: Node) -> (usize, i32) {
+    let mut depth = 0;
+    while let Some(child) = node.children.iter().next() {
+        node = *child.unwrap();
+        depth += 1;
+    }
+    (depth, node.id)
+}
+
+fn lazy_spine(payload: &LazyMessage<Node>) -> (usize, i32) {
+    follow_spine(payload.decode().unwrap())
+}
+
+fn bench_case(c: &mut Criterion, case: &Case, cc: &mut Option<CcBench>) {
+    let root = Node::decode_message(case.payload.clone()).unwrap();
+    let lazy = LazyMessage::<Node>::new(case.payload.clone());
+
+    let top = stack_address();
+    STACK_LOW.store(usize::MAX, Ordering::Relaxed);
+    let (tree, eager_heap) = heap_usage(|| materialize(&root));
+    let eager_stack = top.saturating_sub(STACK_LOW.load(Ordering::Relaxed));
+    let ((depth, deepest), lazy_heap) = heap_usage(|| lazy_spine(&lazy));
+    assert_eq!(
+        follow_spine(tree.clone()),
+        (depth, deepest),
+        "{}: eager and lazy decode disagree on the spine",
+        case.name
+    );
+
+    let nodes = count_nodes(&tree);
+    let cpp_space = CcBench::space_used_note(cc, case);
+    eprintln!(
+        "{}: {} nodes, depth {}; eager peak heap {} B, stack ~{} B; lazy_spine peak heap {} B{}",
+        case.name,
+        nodes,
+        depth,
+        eager_heap.peak_bytes,
+        eager_stack,
+        lazy_heap.peak_bytes,
+        cpp_space
+    );
+    drop(tree);
+
+    let mut group = c.benchmark_group(format!("nested/{}", case.name));
+    group.throughput(Throughput::Bytes(case.payload.len() as u64));
+    group.bench_function(BenchmarkId::new("eager", depth), |b| {
+        b.iter(|| {
+            let root = Node::decode_message(std::hint::black_box(case.payload.clone())).unwrap();
+            materialize(&root)
+        })
+    });
+    group.bench_function(BenchmarkId::new("lazy_spine", depth), |b| {
+        b.iter(|| lazy_spine(std::hint::black_box(&lazy)))
+    });
+    if let Some(cc) = cc.as_mut() {
+        let id = case.id();
+        group.bench_function(BenchmarkId::new("cpp", depth), |b| {
+            b.iter_custom(|iters| cc.time("decode", &id, iters))
+        });
+    }
+    group.finish();
+}
+
+fn deep_nesting_benchmark(c: &mut Criterion) {
+    let (category, dir, mut cc) = bench_corpus("nested");
+
+    for case in load_cases(category, &dir) {
+        if case.message_type == "Node" {
+            bench_case(c, &case, &mut cc);
+        }
+    }
+}
+
+criterion_group!(benches, deep_nesting_benchmark);
+criterion_main!(benches);
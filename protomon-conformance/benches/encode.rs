@@ -0,0 +1,180 @@
+//! Encode benchmark: protomon vs C++ deterministic serialization.
+//!
+//! Every test case is decoded once and then serialized, repeatedly, by:
+//!
+//! * `len`: `encoded_message_len`, the length pass a caller makes to size its
+//!   buffer.
+//! * `protomon`: `encode_message` into a reused buffer. protomon caches no
+//!   sizes, so every nested message's length prefix (`encode_message_field`)
+//!   costs another length pass over that message while writing.
+//! * `cpp`: C++ deterministic serialization, `ByteSizeLong` followed by
+//!   `SerializeWithCachedSizes`, timed in `bench_cc`; `cpp_byte_size` and
+//!   `cpp_write` time its two passes separately.
+//!
+//! The messages are decoded from the wire, so their repeated fields are still
+//! lazy: `len` reads their lengths off what decoding recorded, and
+//! `protomon` decodes every element of a repeated message field again to
+//! encode it. That is the cost of re-encoding a received message, not of
+//! encoding one built in memory.
+//!
+//! Groups are `serialize/<category>`, one `<method>/<test>` entry per case.
+//! With `PROTOMON_CC_BENCH` set, each case's protomon encoding must equal the
+//! C++ bytes exactly (deterministic serialization orders map entries by key,
+//! as protomon's `BTreeMap`s do), and a quick per-message breakdown is
+//! printed before timing: ns per message for each side and each pass, and
+//! protomon's slowdown against C++. Set `PROTOMON_BENCH_CORPUS` to a
+//! `generate_binaries --synthesize` corpus to add its payloads as category
+//! `corpus`:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench encode
+//! ```
+
+#[macro_use]
+mod common;
+
+use std::path::Path;
+use std::time::Instant;
+
+use criterion::measurement::WallTime;
+use criterion::{criterion_group, criterion_main, BenchmarkGroup, BenchmarkId, Criterion, Throughput};
+use protomon::codec::ProtoMessage;
+
+use common::{corpus_dir, load_cases, testdata_dir, Case, CcBench, CATEGORIES};
+
+/// Bytes the per-message breakdown serializes per measurement, so it takes
+/// about as long for every payload size.
+const BREAKDOWN_BYTES: u64 = 16 << 20;
+
+/// Average ns per call of `f` over `iters` calls.
+fn ns_per_call(iters: u64, mut f: impl FnMut()) -> f64 {
+    let start = Instant::now();
+    for _ in 0..iters {
+        f();
+    }
+    start.elapsed().as_nanos() as f64 / iters as f64
+}
+
+/// Check `case`'s protomon encoding against C++'s and print where each
+/// side's time goes. Returns whether the bytes matched.
+fn breakdown<T: ProtoMessage>(case: &Case, msg: &T, encoded: &[u8], cc: &mut CcBench) -> bool {
+    let id = case.id();
+    let expected = cc.serialized(&id);
+    let exact = encoded == expected.as_slice();
+    if !exact {
+        let offset = encoded
+            .iter()
+            .zip(&expected)
+            .position(|(a, b)| a != b)
+            .unwrap_or(encoded.len().min(expected.len()));
+        eprintln!(
+            "{}: protomon wrote {} B, C++ {} B; first difference at byte {}",
+            id,
+            encoded.len(),
+            expected.len(),
+            offset
+        );
+    }
+
+    let iters = (BREAKDOWN_BYTES / (encoded.len() as u64 + 64)).clamp(1, 100_000);
+    let mut buf = Vec::with_capacity(encoded.len());
+    let len_ns = ns_per_call(iters, || {
+        std::hint::black_box(std::hint::black_box(msg).encoded_message_len());
+    });
+    let encode_ns = ns_per_call(iters, || {
+        buf.clear();
+        std::hint::black_box(msg).encode_message(&mut buf);
+        std::hint::black_box(buf.len());
+    });
+    let cc_ns = |cc: &mut CcBench, op| cc.request(op, &id, iters) as f64 / iters as f64;
+    let cpp_ns = cc_ns(cc, "deterministic");
+    let cpp_size_ns = cc_ns(cc, "byte_size");
+    let cpp_write_ns = cc_ns(cc, "write");
+    eprintln!(
+        "{}: {} B, {}; protomon {:.1} ns (length pass {:.1} ns), \
+         C++ {:.1} ns (ByteSizeLong {:.1} ns, write {:.1} ns), {:.2}x C++",
+        id,
+        encoded.len(),
+        if exact { "byte-exact" } else { "MISMATCH" },
+        encode_ns,
+        len_ns,
+        cpp_ns,
+        cpp_size_ns,
+        cpp_write_ns,
+        encode_ns / cpp_ns
+    );
+    exact
+}
+
+fn bench_case<T: ProtoMessage>(
+    group: &mut BenchmarkGroup<'_, WallTime>,
+    case: &Case,
+    cc: &mut Option<CcBench>,
+    mismatches: &mut Vec<String>,
+) {
+    let msg = T::decode_message(case.payload.clone()).unwrap();
+    let mut buf = Vec::with_capacity(msg.encoded_message_len());
+    msg.encode_message(&mut buf);
+    if let Some(cc) = cc.as_mut() {
+        if !breakdown(case, &msg, &buf, cc) {
+            mismatches.push(case.id());
+        }
+    }
+
+    group.throughput(Throughput::Bytes(buf.len() as u64));
+    group.bench_function(BenchmarkId::new("len", &case.name), |b| {
+        b.iter(|| std::hint::black_box(&msg).encoded_message_len())
+    });
+    group.bench_function(BenchmarkId::new("protomon", &case.name), |b| {
+        b.iter(|| {
+            buf.clear();
+            std::hint::black_box(&msg).encode_message(&mut buf);
+            std::hint::black_box(buf.len())
+        })
+    });
+    if let Some(cc) = cc.as_mut() {
+        let id = case.id();
+        let ops = [("cpp_byte_size", "byte_size"), ("cpp_write", "write"), ("cpp", "deterministic")];
+        for (name, op) in ops {
+            group.bench_function(BenchmarkId::new(name, &case.name), |b| {
+                b.iter_custom(|iters| cc.time(op, &id, iters))
+            });
+        }
+    }
+}
+
+fn bench_category(
+    c: &mut Criterion,
+    category: &'static str,
+    dir: &Path,
+    cc: &mut Option<CcBench>,
+    mismatches: &mut Vec<String>,
+) {
+    let mut group = c.benchmark_group(format!("serialize/{}", category));
+    for case in load_cases(category, dir) {
+        dispatch!(case.message_type.as_str(), bench_case(&mut group, &case, cc, mismatches));
+    }
+    group.finish();
+}
+
+fn encode_benchmark(c: &mut Criterion) {
+    let corpus = corpus_dir();
+    let mut cc = CcBench::for_corpus(corpus.as_deref());
+
+    let mut mismatches = Vec::new();
+    for &category in CATEGORIES {
+        bench_category(c, category, &testdata_dir().join(category), &mut cc, &mut mismatches);
+    }
+    if let Some(dir) = &corpus {
+        bench_category(c, "corpus", dir, &mut cc, &mut mismatches);
+    }
+    assert!(
+        mismatches.is_empty(),
+        "protomon's encoding differs from C++ deterministic serialization for: {}",
+        mismatches.join(", ")
+    );
+}
+
+criterion_group!(benches, encode_benchmark);
+criterion_main!(benches);
@@ -0,0 +1,108 @@
+//! Lazy-access benchmark: protomon partial reads vs C++ full parse of `Outer`.
+//!
+//! Readers of a wide message often want a few of its items, not all of them.
+//! For every `Outer` test case and access ratio K, this reads the fields of
+//! every (100 / K)-th item three ways:
+//!
+//! * `lazy`: `LazyMessage::decode`, then `items.iter().step_by(..)`, which
+//!   decodes only the items it returns.
+//! * `eager`: decode every item into a `Vec` first, as a full parse does,
+//!   then read the same items from it.
+//! * `cpp`: C++ `ParseFromString` with the generated code, then the same reads
+//!   through the accessors, timed in `bench_cc` (`touch:<K>`).
+//!
+//! Groups are `lazy_access/<test>`, with a `<method>/<K>` entry per ratio, so
+//! the ratio at which `lazy` stops beating `cpp` reads straight off the
+//! report. The testdata `Outer`s hold a handful of items; point
+//! `PROTOMON_BENCH_CORPUS` at a `generate_binaries --synthesize` corpus for
+//! `outer_items`, which holds `--elements / 10` of them:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench lazy_access
+//! ```
+
+mod common;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use protomon::codec::LazyMessage;
+use protomon_conformance::protos::conformance::{outer, Outer};
+
+use common::{bench_corpus, load_cases, Case, CcBench};
+
+/// Percentages of the items read, as in `bench_cc`'s `touch:<percent>`.
+const ACCESS_PERCENTS: [usize; 6] = [1, 5, 10, 25, 50, 100];
+
+/// What reading an item touches, summed so the reads can't be skipped.
+fn touch(item: &outer::Inner) -> i64 {
+    i64::from(item.value) + item.name.as_str().len() as i64
+}
+
+fn lazy_read(payload: &LazyMessage<Outer>, stride: usize) -> i64 {
+    let outer = payload.decode().unwrap();
+    outer
+        .items
+        .iter()
+        .step_by(stride)
+        .map(|item| touch(&item.unwrap()))
+        .sum()
+}
+
+fn eager_read(payload: &LazyMessage<Outer>, stride: usize) -> i64 {
+    let outer = payload.decode().unwrap();
+    let items: Vec<outer::Inner> = outer.items.iter().collect::<Result<_, _>>().unwrap();
+    items.iter().step_by(stride).map(touch).sum()
+}
+
+fn bench_case(c: &mut Criterion, case: &Case, cc: &mut Option<CcBench>) {
+    let payload = LazyMessage::<Outer>::new(case.payload.clone());
+    let items = payload.decode().unwrap().items.len();
+
+    let mut group = c.benchmark_group(format!("lazy_access/{}", case.name));
+    group.throughput(Throughput::Bytes(case.payload.len() as u64));
+    for percent in ACCESS_PERCENTS {
+        let stride = 100 / percent;
+        assert_eq!(
+            lazy_read(&payload, stride),
+            eager_read(&payload, stride),
+            "{}: lazy and eager reads disagree at {}%",
+            case.name,
+            percent
+        );
+        eprintln!(
+            "{}: {}% reads {} of {} items",
+            case.name,
+            percent,
+            items.div_ceil(stride),
+            items
+        );
+
+        group.bench_function(BenchmarkId::new("lazy", percent), |b| {
+            b.iter(|| lazy_read(std::hint::black_box(&payload), stride))
+        });
+        group.bench_function(BenchmarkId::new("eager", percent), |b| {
+            b.iter(|| eager_read(std::hint::black_box(&payload), stride))
+        });
+        if let Some(cc) = cc.as_mut() {
+            let op = format!("touch:{}", percent);
+            let id = case.id();
+            group.bench_function(BenchmarkId::new("cpp", percent), |b| {
+                b.iter_custom(|iters| cc.time(&op, &id, iters))
+            });
+        }
+    }
+    group.finish();
+}
+
+fn lazy_access_benchmark(c: &mut Criterion) {
+    let (category, dir, mut cc) = bench_corpus("nested");
+
+    for case in load_cases(category, &dir) {
+        if case.message_type == "Outer" {
+            bench_case(c, &case, &mut cc);
+        }
+    }
+}
+
+criterion_group!(benches, lazy_access_benchmark);
+criterion_main!(benches);
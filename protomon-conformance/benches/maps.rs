@@ -0,0 +1,141 @@
+//! Map benchmark: protomon map decode and encode vs C++ `Map<K, V>`.
+//!
+//! Every `StringKeyMap` and `Int64KeyMap` test case is decoded into the
+//! generated `BTreeMap` field and into a `HashMap` one (`map_type = "hash"`,
+//! declared here because the conformance protos don't import protomon's
+//! extensions), then encoded back from each. With `PROTOMON_CC_BENCH` set,
+//! C++ parsing into and serializing from its `Map` land in the same group,
+//! `maps/<test>`, with one `<method>/<entries>` entry per method.
+//!
+//! Map decode time is dominated by building the map, so each case also
+//! prints the heap growth and number of allocations one decode makes, from a
+//! counting global allocator, and the parsed C++ message's `SpaceUsedLong()`.
+//!
+//! The handwritten testdata maps hold a few entries; point
+//! `PROTOMON_BENCH_CORPUS` at a `generate_binaries --synthesize` corpus for
+//! `map_string_*` and `map_int64_*`, of 10 to 1M entries by default:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench maps
+//! ```
+
+mod common;
+
+use std::collections::HashMap;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use protomon::codec::{ProtoMessage, ProtoString};
+use protomon::ProtoMessage as ProtoMessageDerive;
+use protomon_conformance::protos::conformance::{Int64KeyMap, StringKeyMap};
+
+use common::{bench_corpus, heap_usage, load_cases, Case, CcBench, CountingAlloc};
+
+#[global_allocator]
+static ALLOC: CountingAlloc = CountingAlloc;
+
+/// `StringKeyMap` with a `HashMap` field.
+#[derive(Debug, Default, ProtoMessageDerive)]
+pub struct StringKeyHashMap {
+    #[proto(tag = 1, map)]
+    pub entries: HashMap<String, i64>,
+}
+
+/// `Int64KeyMap` with a `HashMap` field.
+#[derive(Debug, Default, ProtoMessageDerive)]
+pub struct Int64KeyHashMap {
+    #[proto(tag = 1, map)]
+    pub entries: HashMap<i64, ProtoString>,
+}
+
+/// Benchmark decoding `case` as `B` (a `BTreeMap` message) and `H` (its
+/// `HashMap` twin), and encoding each back. `entries` counts a message's
+/// map entries.
+fn bench_map<B, H>(
+    c: &mut Criterion,
+    case: &Case,
+    cc: &mut Option<CcBench>,
+    entries: (fn(&B) -> usize, fn(&H) -> usize),
+) where
+    B: ProtoMessage,
+    H: ProtoMessage,
+{
+    let (btree, btree_heap) = heap_usage(|| B::decode_message(case.payload.clone()).unwrap());
+    let (hash, hash_heap) = heap_usage(|| H::decode_message(case.payload.clone()).unwrap());
+    let len = entries.0(&btree);
+    assert_eq!(len, entries.1(&hash), "{}: BTreeMap and HashMap disagree", case.name);
+
+    let cpp_space = CcBench::space_used_note(cc, case);
+    eprintln!(
+        "{}: {} entries, {} B; BTreeMap decode {} B in {} allocations, \
+         HashMap decode {} B in {} allocations{}",
+        case.name,
+        len,
+        case.payload.len(),
+        btree_heap.peak_bytes,
+        btree_heap.allocations,
+        hash_heap.peak_bytes,
+        hash_heap.allocations,
+        cpp_space
+    );
+
+    let mut group = c.benchmark_group(format!("maps/{}", case.name));
+    group.throughput(Throughput::Elements(len as u64));
+    group.bench_function(BenchmarkId::new("decode_btree", len), |b| {
+        b.iter(|| B::decode_message(std::hint::black_box(case.payload.clone())).unwrap())
+    });
+    group.bench_function(BenchmarkId::new("decode_hash", len), |b| {
+        b.iter(|| H::decode_message(std::hint::black_box(case.payload.clone())).unwrap())
+    });
+
+    let mut buf = Vec::with_capacity(case.payload.len());
+    group.bench_function(BenchmarkId::new("encode_btree", len), |b| {
+        b.iter(|| {
+            buf.clear();
+            std::hint::black_box(&btree).encode_message(&mut buf);
+            std::hint::black_box(buf.len())
+        })
+    });
+    group.bench_function(BenchmarkId::new("encode_hash", len), |b| {
+        b.iter(|| {
+            buf.clear();
+            std::hint::black_box(&hash).encode_message(&mut buf);
+            std::hint::black_box(buf.len())
+        })
+    });
+
+    if let Some(cc) = cc.as_mut() {
+        let id = case.id();
+        for op in ["decode", "encode"] {
+            group.bench_function(BenchmarkId::new(format!("cpp_{}", op), len), |b| {
+                b.iter_custom(|iters| cc.time(op, &id, iters))
+            });
+        }
+    }
+    group.finish();
+}
+
+fn maps_benchmark(c: &mut Criterion) {
+    let (category, dir, mut cc) = bench_corpus("maps");
+
+    for case in load_cases(category, &dir) {
+        match case.message_type.as_str() {
+            "StringKeyMap" => bench_map::<StringKeyMap, StringKeyHashMap>(
+                c,
+                &case,
+                &mut cc,
+                (|m| m.entries.len(), |m| m.entries.len()),
+            ),
+            "Int64KeyMap" => bench_map::<Int64KeyMap, Int64KeyHashMap>(
+                c,
+                &case,
+                &mut cc,
+                (|m| m.entries.len(), |m| m.entries.len()),
+            ),
+            _ => {}
+        }
+    }
+}
+
+criterion_group!(benches, maps_benchmark);
+criterion_main!(benches);
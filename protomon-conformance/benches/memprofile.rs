@@ -0,0 +1,142 @@
+//! Memory-footprint profile: what a decoded protomon message keeps alive,
+//! next to what the parsed C++ message holds.
+//!
+//! Not a timing benchmark: every test case is decoded once and reported as
+//!
+//! * `heap`: live heap the decoded message owns (boxes, `Vec`s, maps), from a
+//!   counting global allocator.
+//! * `buffer`: input bytes the message keeps alive. `ProtoString`,
+//!   `ProtoPacked` chunks, lazy repeated fields and unknown fields are
+//!   slices of the input `Bytes`, so any one of them pins the whole buffer
+//!   it was decoded from.
+//! * `inline`: `size_of` the message struct itself.
+//! * `cpp`: the parsed C++ message's `SpaceUsedLong()` from `bench_cc`, which
+//!   includes the object itself and owns copies of everything.
+//!
+//! `heap + buffer + inline` against `cpp` is the zero-copy vs owned trade-off:
+//! protomon wins when the payload is bulk strings and packed data it can
+//! borrow, and loses when a small field pins a large buffer. Each category
+//! ends with its totals. Set `PROTOMON_BENCH_CORPUS` to a
+//! `generate_binaries --synthesize` corpus to add its payloads as category
+//! `corpus`:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench memprofile
+//! ```
+//!
+//! The harness side is `harness_compiled_conformance --mode=memprofile`,
+//! which prints `SpaceUsedLong()` and the heap C++ parsing allocated per
+//! message.
+
+#[macro_use]
+mod common;
+
+use std::path::Path;
+
+use bytes::Bytes;
+use protomon::codec::ProtoMessage;
+
+use common::{
+    corpus_dir, live_bytes, load_cases, testdata_dir, Case, CcBench, CountingAlloc, CATEGORIES,
+};
+
+#[global_allocator]
+static ALLOC: CountingAlloc = CountingAlloc;
+
+/// What one decoded message keeps alive, in bytes.
+#[derive(Clone, Copy, Default)]
+struct Footprint {
+    wire: usize,
+    heap: usize,
+    buffer: usize,
+    inline: usize,
+    cpp: Option<u64>,
+}
+
+impl Footprint {
+    fn protomon(&self) -> usize {
+        self.heap + self.buffer + self.inline
+    }
+
+    fn add(&mut self, other: &Footprint) {
+        self.wire += other.wire;
+        self.heap += other.heap;
+        self.buffer += other.buffer;
+        self.inline += other.inline;
+        self.cpp = match (self.cpp, other.cpp) {
+            (Some(a), Some(b)) => Some(a + b),
+            (a, b) => a.or(b),
+        };
+    }
+
+    fn print(&self, name: &str) {
+        let cpp = match self.cpp {
+            Some(cpp) if cpp > 0 => format!(
+                "{:>10} {:>7.2}x",
+                cpp,
+                self.protomon() as f64 / cpp as f64
+            ),
+            Some(cpp) => format!("{:>10} {:>8}", cpp, "-"),
+            None => format!("{:>10} {:>8}", "-", "-"),
+        };
+        println!(
+            "{:<40} {:>10} {:>10} {:>10} {:>8} {:>10} {}",
+            name,
+            self.wire,
+            self.heap,
+            self.buffer,
+            self.inline,
+            self.protomon(),
+            cpp
+        );
+    }
+}
+
+fn profile<T: ProtoMessage>(case: &Case, cc: &mut Option<CcBench>) -> Footprint {
+    // A buffer of its own, so only the decoded message can keep it alive.
+    // Cloning it up front allocates its refcount outside the measurement.
+    let payload = Bytes::from(case.payload.to_vec());
+    let input = payload.clone();
+
+    let before = live_bytes();
+    let msg = T::decode_message(input).unwrap();
+    let heap = live_bytes().saturating_sub(before);
+    let buffer = if payload.is_unique() { 0 } else { payload.len() };
+    drop(msg);
+
+    Footprint {
+        wire: payload.len(),
+        heap,
+        buffer,
+        inline: std::mem::size_of::<T>(),
+        cpp: cc.as_mut().map(|cc| cc.space_used(&case.id())),
+    }
+}
+
+fn profile_category(category: &'static str, dir: &Path, cc: &mut Option<CcBench>) {
+    println!(
+        "{:<40} {:>10} {:>10} {:>10} {:>8} {:>10} {:>10} {:>8}",
+        category, "wire", "heap", "buffer", "inline", "protomon", "cpp", "vs cpp"
+    );
+    let mut total = Footprint::default();
+    for case in load_cases(category, dir) {
+        let footprint = dispatch!(case.message_type.as_str(), profile(&case, cc));
+        footprint.print(&case.name);
+        total.add(&footprint);
+    }
+    total.print("total");
+    println!();
+}
+
+fn main() {
+    let corpus = corpus_dir();
+    let mut cc = CcBench::for_corpus(corpus.as_deref());
+
+    for &category in CATEGORIES {
+        profile_category(category, &testdata_dir().join(category), &mut cc);
+    }
+    if let Some(dir) = &corpus {
+        profile_category("corpus", dir, &mut cc);
+    }
+}
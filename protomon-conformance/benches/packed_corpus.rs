@@ -0,0 +1,140 @@
+//! Packed-field decode benchmark on payloads serialized by C++ protobuf.
+//!
+//! Every packed numeric field of the repeated test cases is decoded three
+//! ways: lazily with `ProtoPacked::iter`, in bulk with `decode_into` (into a
+//! reused `Vec`), and by rebuilding the field chunk by chunk with
+//! `push_chunk` before `decode_into`, the path a field split across several
+//! records takes. The chunks are the ones C++ `SerializeToString` wrote, so
+//! the bench sees its segmentation, not a Rust-side approximation of it.
+//!
+//! The handwritten testdata is tiny; point `PROTOMON_BENCH_CORPUS` at a
+//! `generate_binaries --synthesize` corpus for large payloads, including
+//! `repeated_scalars_chunked`, whose fields each arrive in many records:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench packed_corpus
+//! ```
+//!
+//! With `PROTOMON_CC_BENCH` set, `bench_cc` also times C++ parsing the same
+//! field's records into its `RepeatedField`. Groups are `packed/<test>`,
+//! with a `<method>/<field>` entry per decoding method and packed field.
+
+mod common;
+
+use std::fmt::Debug;
+
+use criterion::measurement::WallTime;
+use criterion::{criterion_group, criterion_main, BenchmarkGroup, BenchmarkId, Criterion, Throughput};
+use protomon::codec::{PackedDecode, ProtoDecode, ProtoMessage, ProtoPacked};
+use protomon_conformance::protos::conformance::*;
+
+use common::{bench_corpus, load_cases, Case, CcBench};
+
+/// Benchmark decoding one packed field of `case` with each method.
+fn bench_field<T>(
+    group: &mut BenchmarkGroup<'_, WallTime>,
+    case: &Case,
+    field: &str,
+    packed: &ProtoPacked<T>,
+    cc: Option<&mut CcBench>,
+) where
+    T: PackedDecode + ProtoDecode + PartialEq + Debug,
+{
+    if packed.is_empty() {
+        return;
+    }
+
+    // The methods must agree element by element before their times mean
+    // anything.
+    let values = packed.decode().unwrap();
+    let iterated: Vec<T> = packed.iter().collect::<Result<_, _>>().unwrap();
+    assert_eq!(iterated, values, "{}: iter and decode disagree on {}", case.name, field);
+
+    group.throughput(Throughput::Elements(values.len() as u64));
+    group.bench_function(BenchmarkId::new("iter", field), |b| {
+        b.iter(|| {
+            std::hint::black_box(packed)
+                .iter()
+                .map(|value| std::hint::black_box(value.unwrap()))
+                .count()
+        })
+    });
+
+    let mut dst = Vec::with_capacity(values.len());
+    group.bench_function(BenchmarkId::new("decode_into", field), |b| {
+        b.iter(|| {
+            dst.clear();
+            std::hint::black_box(packed).decode_into(&mut dst).unwrap();
+            std::hint::black_box(dst.len())
+        })
+    });
+
+    group.bench_function(
+        BenchmarkId::new(format!("push_chunk_x{}", packed.chunk_count()), field),
+        |b| {
+            b.iter(|| {
+                let mut rebuilt = ProtoPacked::<T>::new();
+                for chunk in std::hint::black_box(packed).chunks() {
+                    rebuilt.push_chunk(chunk.clone());
+                }
+                dst.clear();
+                rebuilt.decode_into(&mut dst).unwrap();
+                std::hint::black_box(dst.len())
+            })
+        },
+    );
+
+    if let Some(cc) = cc {
+        let op = format!("packed:{}", field);
+        let id = case.id();
+        group.bench_function(BenchmarkId::new("cpp_RepeatedField", field), |b| {
+            b.iter_custom(|iters| cc.time(&op, &id, iters))
+        });
+    }
+}
+
+/// Decode `$case` as `$ty` and call `bench_field` on each listed packed field.
+macro_rules! bench_fields {
+    ($group:expr, $case:expr, $cc:expr, $ty:ident, [$($field:ident),* $(,)?]) => {{
+        let msg = $ty::decode_message($case.payload.clone()).unwrap();
+        $(bench_field($group, $case, stringify!($field), &msg.$field, $cc.as_mut());)*
+    }};
+}
+
+fn bench_case(group: &mut BenchmarkGroup<'_, WallTime>, case: &Case, cc: &mut Option<CcBench>) {
+    match case.message_type.as_str() {
+        "RepeatedScalars" => bench_fields!(group, case, cc, RepeatedScalars, [
+            val_int32, val_int64, val_uint32, val_uint64, val_sint32, val_sint64, val_bool,
+            val_fixed32, val_sfixed32, val_fixed64, val_sfixed64, val_float, val_double,
+        ]),
+        "RepeatedInt32" => bench_fields!(group, case, cc, RepeatedInt32, [values]),
+        "RepeatedInt64" => bench_fields!(group, case, cc, RepeatedInt64, [values]),
+        "RepeatedUint32" => bench_fields!(group, case, cc, RepeatedUint32, [values]),
+        "RepeatedUint64" => bench_fields!(group, case, cc, RepeatedUint64, [values]),
+        "RepeatedSint32" => bench_fields!(group, case, cc, RepeatedSint32, [values]),
+        "RepeatedSint64" => bench_fields!(group, case, cc, RepeatedSint64, [values]),
+        "RepeatedBool" => bench_fields!(group, case, cc, RepeatedBool, [values]),
+        "RepeatedFixed32" => bench_fields!(group, case, cc, RepeatedFixed32, [values]),
+        "RepeatedSfixed32" => bench_fields!(group, case, cc, RepeatedSfixed32, [values]),
+        "RepeatedFixed64" => bench_fields!(group, case, cc, RepeatedFixed64, [values]),
+        "RepeatedSfixed64" => bench_fields!(group, case, cc, RepeatedSfixed64, [values]),
+        "RepeatedFloat" => bench_fields!(group, case, cc, RepeatedFloat, [values]),
+        "RepeatedDouble" => bench_fields!(group, case, cc, RepeatedDouble, [values]),
+        // Strings, bytes and messages are never packed.
+        _ => {}
+    }
+}
+
+fn packed_corpus_benchmark(c: &mut Criterion) {
+    let (category, dir, mut cc) = bench_corpus("repeated");
+
+    for case in load_cases(category, &dir) {
+        let mut group = c.benchmark_group(format!("packed/{}", case.name));
+        bench_case(&mut group, &case, &mut cc);
+        group.finish();
+    }
+}
+
+criterion_group!(benches, packed_corpus_benchmark);
+criterion_main!(benches);
@@ -0,0 +1,174 @@
+//! Unknown-field benchmark: a newer writer's records read with an older schema.
+//!
+//! `generate_binaries --synthesize` writes `unknown_wide_records`, C++
+//! `WideRecords` listed as `NarrowRecords`: every record carries fields of
+//! every wire type that `NarrowRecord` doesn't know. Each such case is
+//! decoded, record by record:
+//!
+//! * `skip`: as the generated `NarrowRecords`, dropping unknown fields with
+//!   `skip_field`.
+//! * `retain`: as a `NarrowRecords` that keeps them (`#[proto(unknown)]`),
+//!   so every unknown field is also copied out for re-encoding.
+//! * `wide`: as the generated `WideRecords`, decoding every field; the cost
+//!   of knowing the newer schema.
+//! * `cpp_skip`: C++ `WireFormatLite::SkipField` over the same records.
+//! * `cpp_unknown`: C++ `ParseFromString` as `NarrowRecords`, keeping the
+//!   extra fields in `UnknownFieldSet`s.
+//!
+//! Each case also prints how many bytes the retained unknown fields hold and
+//! the parsed C++ message's `SpaceUsedLong()`. The payloads only exist in a
+//! synthesized corpus:
+//!
+//! ```text
+//! PROTOMON_BENCH_CORPUS=$(pwd)/bench_corpus \
+//!     PROTOMON_CC_BENCH=$(pwd)/bazel-bin/bench_cc cargo bench --bench unknown_fields
+//! ```
+
+extern crate alloc;
+
+mod common;
+
+use bytes::Bytes;
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use protomon::codec::{ProtoBytes, ProtoMessage, ProtoString, Repeated};
+use protomon::ProtoMessage as ProtoMessageDerive;
+use protomon_conformance::protos::conformance::{NarrowRecords, WideRecords};
+
+use common::{corpus_dir, load_cases, Case, CcBench, CORPUS_VAR};
+
+/// `NarrowRecord`, keeping the fields it doesn't know.
+#[derive(Debug, Clone, Default, ProtoMessageDerive)]
+pub struct RetainedRecord {
+    #[proto(tag = 1)]
+    pub id: i32,
+    #[proto(tag = 2)]
+    pub name: ProtoString,
+    #[proto(unknown)]
+    pub _unknown: Bytes,
+}
+
+/// `NarrowRecords` of [`RetainedRecord`]s.
+#[derive(Debug, Default, ProtoMessageDerive)]
+pub struct RetainedRecords {
+    #[proto(tag = 1, repeated)]
+    pub records: Repeated<RetainedRecord>,
+}
+
+/// The records of a `NarrowRecords` (or `WideRecords`), undecoded.
+#[derive(Debug, Default, ProtoMessageDerive)]
+pub struct RawRecords {
+    #[proto(tag = 1, repeated)]
+    pub records: Repeated<ProtoBytes>,
+}
+
+/// Decode every record, the way a reader consumes the container.
+fn skip(payload: &Bytes) -> i64 {
+    let msg = NarrowRecords::decode_message(payload.clone()).unwrap();
+    msg.records
+        .iter()
+        .map(|record| {
+            let record = record.unwrap();
+            i64::from(record.id) + record.name.as_str().len() as i64
+        })
+        .sum()
+}
+
+fn retain(payload: &Bytes) -> i64 {
+    let msg = RetainedRecords::decode_message(payload.clone()).unwrap();
+    msg.records
+        .iter()
+        .map(|record| {
+            let record = record.unwrap();
+            i64::from(record.id) + record.name.as_str().len() as i64 + record._unknown.len() as i64
+        })
+        .sum()
+}
+
+fn wide(payload: &Bytes) -> i64 {
+    let msg = WideRecords::decode_message(payload.clone()).unwrap();
+    msg.records
+        .iter()
+        .map(|record| {
+            let record = record.unwrap();
+            i64::from(record.id) + record.name.as_str().len() as i64
+        })
+        .sum()
+}
+
+fn bench_case(c: &mut Criterion, case: &Case, cc: &mut Option<CcBench>) {
+    // Retaining must not lose anything: each record re-encodes to exactly
+    // the bytes C++ wrote for it.
+    let retained = RetainedRecords::decode_message(case.payload.clone()).unwrap();
+    let written = RawRecords::decode_message(case.payload.clone()).unwrap();
+    assert_eq!(retained.records.len(), written.records.len());
+    let mut records = 0;
+    let mut unknown_bytes = 0;
+    for (record, original) in retained.records.iter().zip(written.records.iter()) {
+        let record = record.unwrap();
+        let mut reencoded = Vec::new();
+        record.encode_message(&mut reencoded);
+        assert_eq!(
+            reencoded[..],
+            original.unwrap()[..],
+            "{}: record {} did not round-trip",
+            case.name,
+            record.id
+        );
+        records += 1;
+        unknown_bytes += record._unknown.len();
+    }
+    assert_eq!(skip(&case.payload), wide(&case.payload));
+
+    let cpp_space = CcBench::space_used_note(cc, case);
+    eprintln!(
+        "{}: {} records, {} B; retained unknown fields {} B{}",
+        case.name,
+        records,
+        case.payload.len(),
+        unknown_bytes,
+        cpp_space
+    );
+
+    let mut group = c.benchmark_group(format!("unknown_fields/{}", case.name));
+    group.throughput(Throughput::Bytes(case.payload.len() as u64));
+    group.bench_function(BenchmarkId::new("skip", records), |b| {
+        b.iter(|| skip(std::hint::black_box(&case.payload)))
+    });
+    group.bench_function(BenchmarkId::new("retain", records), |b| {
+        b.iter(|| retain(std::hint::black_box(&case.payload)))
+    });
+    group.bench_function(BenchmarkId::new("wide", records), |b| {
+        b.iter(|| wide(std::hint::black_box(&case.payload)))
+    });
+    if let Some(cc) = cc.as_mut() {
+        let id = case.id();
+        group.bench_function(BenchmarkId::new("cpp_skip", records), |b| {
+            b.iter_custom(|iters| cc.time("skip", &id, iters))
+        });
+        group.bench_function(BenchmarkId::new("cpp_unknown", records), |b| {
+            b.iter_custom(|iters| cc.time("decode", &id, iters))
+        });
+    }
+    group.finish();
+}
+
+fn unknown_fields_benchmark(c: &mut Criterion) {
+    let Some(dir) = corpus_dir() else {
+        eprintln!(
+            "{} is not set; the wide payloads only exist in a \
+             generate_binaries --synthesize corpus",
+            CORPUS_VAR
+        );
+        return;
+    };
+    let mut cc = CcBench::for_corpus(Some(&dir));
+
+    for case in load_cases("corpus", &dir) {
+        if case.message_type == "NarrowRecords" {
+            bench_case(c, &case, &mut cc);
+        }
+    }
+}
+
+criterion_group!(benches, unknown_fields_benchmark);
+criterion_main!(benches);
@@ -5,6 +5,7 @@ fn main() -> Result<(), Box<dyn std::error::Error>> {
             "protos/repeated.proto",
             "protos/nested.proto",
             "protos/edge_cases.proto",
+            "protos/maps.proto",
         ],
         &["protos/"],
     )?;
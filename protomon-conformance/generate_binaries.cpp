@@ -6,20 +6,54 @@
 //
 // Usage:
 //   bazel run //conformance:generate_binaries -- --output_dir=/path/to/testdata
-
+//
+//   Test cases are generated in parallel (--jobs). A manifest in the output
+//   directory records what each .bin was built from, so test cases whose
+//   .textproto hasn't changed are skipped; pass --force to rebuild them all.
+//
+//   # Build large benchmark payloads programmatically instead, reproducibly
+//   # from --seed, along with a tests.txt manifest listing them:
+//   bazel run //conformance:generate_binaries -- --synthesize --output_dir=/path/to/bench_corpus
+//
+//   Each varint payload is also decoded with CodedInputStream::ReadVarint64,
+//   and the value count, sum and time per pass are written to
+//   varint_reference.txt, the target protomon's leb128 bench checks against.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/message.h"
 #include "google/protobuf/text_format.h"
 
 // Include all conformance proto headers
@@ -27,9 +61,29 @@
 #include "protos/repeated.pb.h"
 #include "protos/nested.pb.h"
 #include "protos/edge_cases.pb.h"
+#include "protos/maps.pb.h"
 
 ABSL_FLAG(std::string, output_dir, "", "Output directory for binary files");
 ABSL_FLAG(std::string, input_dir, "", "Input directory containing testdata");
+ABSL_FLAG(int, jobs, 0, "Test cases to generate in parallel (default: one per CPU)");
+ABSL_FLAG(bool, force, false, "Regenerate every .bin, even if its .textproto is unchanged");
+ABSL_FLAG(bool, synthesize, false,
+          "Generate synthetic benchmark payloads into --output_dir instead of the testdata");
+ABSL_FLAG(uint64_t, seed, 1, "Random seed for --synthesize");
+ABSL_FLAG(int, elements, 1000000, "Elements per repeated field for --synthesize");
+ABSL_FLAG(int, tree_depth, 6, "Depth of the synthesized Node trees");
+ABSL_FLAG(int, tree_fanout, 4, "Children per interior node of the synthesized Node trees");
+ABSL_FLAG(int, packed_chunks, 16,
+          "Records per packed field in the synthesized repeated_scalars_chunked payload");
+ABSL_FLAG(std::vector<std::string>, spine_depths,
+          std::vector<std::string>({"10", "50", "100"}),
+          "Nesting depths of the synthesized Node spines, at most C++'s default recursion limit");
+ABSL_FLAG(int, spine_fanout, 8, "Children per Node along a synthesized spine");
+ABSL_FLAG(std::vector<std::string>, map_sizes,
+          std::vector<std::string>({"10", "1000", "100000", "1000000"}),
+          "Entries in each synthesized map, one StringKeyMap and one Int64KeyMap per size");
+ABSL_FLAG(int, varint_passes, 20,
+          "Timed ReadVarint64 passes over each varint payload for varint_reference.txt");
 
 // Simple path join
 std::string JoinPath(const std::string& a, const std::string& b) {
@@ -39,13 +93,6 @@ std::string JoinPath(const std::string& a, const std::string& b) {
   return a + "/" + b;
 }
 
-// Get directory part of path
-std::string DirName(const std::string& path) {
-  auto pos = path.rfind('/');
-  if (pos == std::string::npos) return ".";
-  return path.substr(0, pos);
-}
-
 // Create directory (including parents)
 bool MkdirP(const std::string& path) {
   std::string current;
@@ -65,64 +112,207 @@ bool FileExists(const std::string& path) {
   return stat(path.c_str(), &st) == 0;
 }
 
-// Helper to read a file into a string
-std::string ReadFile(const std::string& path) {
+// Helper to read a file into a string. Returns false if it can't be opened.
+bool ReadFile(const std::string& path, std::string* contents) {
   std::ifstream file(path);
-  if (!file) {
-    std::cerr << "Failed to open: " << path << std::endl;
-    return "";
-  }
+  if (!file) return false;
   std::stringstream buffer;
   buffer << file.rdbuf();
-  return buffer.str();
+  *contents = buffer.str();
+  return true;
 }
 
-// Helper to write binary data to a file
+// Helper to write binary data to a file atomically: the data goes to a
+// temporary file that is renamed over `path`, so readers (and an interrupted
+// run) never see a partial file. The parent directory must exist.
 bool WriteFile(const std::string& path, const std::string& data) {
-  // Create parent directory
-  MkdirP(DirName(path));
-
-  std::ofstream file(path, std::ios::binary);
-  if (!file) {
-    std::cerr << "Failed to create: " << path << std::endl;
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary);
+    if (!file) {
+      std::cerr << "Failed to create: " << tmp_path << std::endl;
+      return false;
+    }
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file) {
+      std::cerr << "Failed to write: " << tmp_path << std::endl;
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::cerr << "Failed to rename " << tmp_path << " to " << path << ": " << strerror(errno)
+              << std::endl;
+    std::remove(tmp_path.c_str());
     return false;
   }
-  file.write(data.data(), data.size());
   return true;
 }
 
-// Template function to process a single test case
-template <typename MessageType>
-bool ProcessTestCase(const std::string& textproto_path, const std::string& bin_path) {
-  std::string text_content = ReadFile(textproto_path);
-  if (text_content.empty() && !FileExists(textproto_path)) {
-    return false;
+// 64-bit FNV-1a, stable across runs and platforms, for the manifest.
+uint64_t Fingerprint(const std::string& data) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+// A test case listed in a category's tests.txt.
+struct TestCase {
+  std::string id;  // "<category>/<test_name>"
+  std::string category;
+  std::string message_type;
+  std::string textproto_path;
+  std::string bin_path;
+};
+
+// What the last run generated a test case's .bin from. Size and mtime let an
+// unchanged .textproto be skipped without reading it; the fingerprint catches
+// files that were touched but not changed. The schema fingerprint covers the
+// message type's definition, so editing a .proto regenerates its test cases.
+struct ManifestEntry {
+  std::string message_type;
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  uint64_t fingerprint = 0;
+  uint64_t schema_fingerprint = 0;
+};
+
+using Manifest = std::map<std::string, ManifestEntry>;
+
+constexpr char kManifestFile[] = ".generate_binaries.manifest";
+
+// Loads the manifest from `output_dir`. A missing or malformed manifest just
+// means everything is regenerated.
+Manifest LoadManifest(const std::string& output_dir) {
+  Manifest manifest;
+  std::ifstream file(JoinPath(output_dir, kManifestFile));
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    std::string id;
+    ManifestEntry entry;
+    if (fields >> id >> entry.message_type >> entry.size >> entry.mtime >> std::hex >>
+        entry.fingerprint >> entry.schema_fingerprint) {
+      manifest[id] = entry;
+    }
+  }
+  return manifest;
+}
+
+bool SaveManifest(const std::string& output_dir, const Manifest& manifest) {
+  std::ostringstream out;
+  out << "# generate_binaries manifest: id message_type size mtime fingerprint schema\n";
+  for (const auto& [id, entry] : manifest) {
+    out << id << " " << entry.message_type << " " << entry.size << " " << entry.mtime << " "
+        << std::hex << entry.fingerprint << " " << entry.schema_fingerprint << std::dec << "\n";
   }
+  return WriteFile(JoinPath(output_dir, kManifestFile), out.str());
+}
 
-  MessageType message;
-  if (!google::protobuf::TextFormat::ParseFromString(text_content, &message)) {
-    std::cerr << "Failed to parse: " << textproto_path << std::endl;
+// Parses a textproto as `prototype`'s type and writes its binary encoding
+bool ProcessTestCase(const google::protobuf::Message& prototype, const std::string& text_content,
+                     const std::string& bin_path, std::string* log) {
+  std::unique_ptr<google::protobuf::Message> message(prototype.New());
+  if (!google::protobuf::TextFormat::ParseFromString(text_content, message.get())) {
+    *log = "Failed to parse";
     return false;
   }
 
   std::string binary;
-  if (!message.SerializeToString(&binary)) {
-    std::cerr << "Failed to serialize: " << textproto_path << std::endl;
+  if (!message->SerializeToString(&binary)) {
+    *log = "Failed to serialize";
     return false;
   }
 
   if (!WriteFile(bin_path, binary)) {
+    *log = "Failed to write " + bin_path;
     return false;
   }
 
-  std::cout << "Generated: " << bin_path << " (" << binary.size() << " bytes)" << std::endl;
+  *log = absl::StrCat("Generated: ", bin_path, " (", binary.size(), " bytes)");
   return true;
 }
 
-// Process all test cases in a category
-bool ProcessCategory(const std::string& input_dir, const std::string& output_dir,
-                     const std::string& category) {
-  std::string tests_file = JoinPath(JoinPath(input_dir, category), "tests.txt");
+// A message type test cases can be generated from.
+struct RegisteredType {
+  const google::protobuf::Message* prototype;
+  // Fingerprint of the FileDescriptorProtos of the type's file and everything
+  // it imports, as compiled into this binary.
+  uint64_t schema_fingerprint;
+};
+
+// Message types by the name tests.txt uses for them.
+using MessageRegistry = absl::flat_hash_map<std::string, RegisteredType>;
+
+// Appends the serialized FileDescriptorProto of `file` and, first, of its
+// transitive imports to `schema`, each file once.
+void AppendSchema(const google::protobuf::FileDescriptor* file,
+                  std::set<const google::protobuf::FileDescriptor*>* seen, std::string* schema) {
+  if (!seen->insert(file).second) return;
+  for (int i = 0; i < file->dependency_count(); i++) {
+    AppendSchema(file->dependency(i), seen, schema);
+  }
+  google::protobuf::FileDescriptorProto proto;
+  file->CopyTo(&proto);
+  schema->append(proto.SerializeAsString());
+}
+
+uint64_t SchemaFingerprint(const google::protobuf::FileDescriptor* file) {
+  std::set<const google::protobuf::FileDescriptor*> seen;
+  std::string schema;
+  AppendSchema(file, &seen, &schema);
+  return Fingerprint(schema);
+}
+
+// Registers `descriptor` and its nested types, named relative to the package
+// ("Outer", "Outer.Inner").
+void RegisterMessage(const google::protobuf::Descriptor* descriptor, const std::string& prefix,
+                     uint64_t schema_fingerprint, MessageRegistry* registry) {
+  std::string name = prefix + descriptor->name();
+  (*registry)[name] = {
+      google::protobuf::MessageFactory::generated_factory()->GetPrototype(descriptor),
+      schema_fingerprint};
+  for (int i = 0; i < descriptor->nested_type_count(); i++) {
+    RegisterMessage(descriptor->nested_type(i), name + ".", schema_fingerprint, registry);
+  }
+}
+
+// Every message type in the conformance protos. The registry is built from
+// the generated descriptors, so a message added to an existing proto needs no
+// change here; a new proto file needs its header included above and one of
+// its messages listed below.
+const MessageRegistry& Registry() {
+  static const MessageRegistry* registry = [] {
+    const google::protobuf::FileDescriptor* files[] = {
+        conformance::Scalars::descriptor()->file(),
+        conformance::RepeatedScalars::descriptor()->file(),
+        conformance::Outer::descriptor()->file(),
+        conformance::Empty::descriptor()->file(),
+        conformance::Maps::descriptor()->file(),
+    };
+
+    auto* registry = new MessageRegistry;
+    for (const google::protobuf::FileDescriptor* file : files) {
+      uint64_t schema_fingerprint = SchemaFingerprint(file);
+      for (int i = 0; i < file->message_type_count(); i++) {
+        RegisterMessage(file->message_type(i), "", schema_fingerprint, registry);
+      }
+    }
+    return registry;
+  }();
+  return *registry;
+}
+
+// Reads the test cases listed in a category's tests.txt
+bool CollectCategory(const std::string& input_dir, const std::string& output_dir,
+                     const std::string& category, std::vector<TestCase>* test_cases) {
+  std::string category_dir = JoinPath(input_dir, category);
+  std::string tests_file = JoinPath(category_dir, "tests.txt");
 
   std::ifstream file(tests_file);
   if (!file) {
@@ -130,10 +320,8 @@ bool ProcessCategory(const std::string& input_dir, const std::string& output_dir
     return true;  // Not an error, just skip
   }
 
+  bool ok = true;
   std::string line;
-  int success_count = 0;
-  int fail_count = 0;
-
   while (std::getline(file, line)) {
     // Skip empty lines and comments
     if (line.empty() || line[0] == '#') continue;
@@ -142,84 +330,555 @@ bool ProcessCategory(const std::string& input_dir, const std::string& output_dir
     std::vector<std::string> parts = absl::StrSplit(line, ' ');
     if (parts.size() != 2) {
       std::cerr << "Invalid line in tests.txt: " << line << std::endl;
+      ok = false;
       continue;
     }
 
-    std::string test_name = parts[0];
-    std::string message_type = parts[1];
-
-    std::string category_dir = JoinPath(input_dir, category);
-    std::string textproto_path = JoinPath(category_dir, test_name + ".textproto");
-    std::string bin_path = JoinPath(JoinPath(output_dir, category), test_name + ".bin");
-
-    // Dispatch based on message type
-    bool ok = false;
-
-    // Scalars
-    if (message_type == "Scalars") ok = ProcessTestCase<conformance::Scalars>(textproto_path, bin_path);
-    else if (message_type == "Int32Value") ok = ProcessTestCase<conformance::Int32Value>(textproto_path, bin_path);
-    else if (message_type == "Int64Value") ok = ProcessTestCase<conformance::Int64Value>(textproto_path, bin_path);
-    else if (message_type == "Uint32Value") ok = ProcessTestCase<conformance::Uint32Value>(textproto_path, bin_path);
-    else if (message_type == "Uint64Value") ok = ProcessTestCase<conformance::Uint64Value>(textproto_path, bin_path);
-    else if (message_type == "Sint32Value") ok = ProcessTestCase<conformance::Sint32Value>(textproto_path, bin_path);
-    else if (message_type == "Sint64Value") ok = ProcessTestCase<conformance::Sint64Value>(textproto_path, bin_path);
-    else if (message_type == "BoolValue") ok = ProcessTestCase<conformance::BoolValue>(textproto_path, bin_path);
-    else if (message_type == "Fixed32Value") ok = ProcessTestCase<conformance::Fixed32Value>(textproto_path, bin_path);
-    else if (message_type == "Sfixed32Value") ok = ProcessTestCase<conformance::Sfixed32Value>(textproto_path, bin_path);
-    else if (message_type == "Fixed64Value") ok = ProcessTestCase<conformance::Fixed64Value>(textproto_path, bin_path);
-    else if (message_type == "Sfixed64Value") ok = ProcessTestCase<conformance::Sfixed64Value>(textproto_path, bin_path);
-    else if (message_type == "FloatValue") ok = ProcessTestCase<conformance::FloatValue>(textproto_path, bin_path);
-    else if (message_type == "DoubleValue") ok = ProcessTestCase<conformance::DoubleValue>(textproto_path, bin_path);
-    else if (message_type == "StringValue") ok = ProcessTestCase<conformance::StringValue>(textproto_path, bin_path);
-    else if (message_type == "BytesValue") ok = ProcessTestCase<conformance::BytesValue>(textproto_path, bin_path);
-
-    // Repeated
-    else if (message_type == "RepeatedScalars") ok = ProcessTestCase<conformance::RepeatedScalars>(textproto_path, bin_path);
-    else if (message_type == "RepeatedInt32") ok = ProcessTestCase<conformance::RepeatedInt32>(textproto_path, bin_path);
-    else if (message_type == "RepeatedInt64") ok = ProcessTestCase<conformance::RepeatedInt64>(textproto_path, bin_path);
-    else if (message_type == "RepeatedUint32") ok = ProcessTestCase<conformance::RepeatedUint32>(textproto_path, bin_path);
-    else if (message_type == "RepeatedUint64") ok = ProcessTestCase<conformance::RepeatedUint64>(textproto_path, bin_path);
-    else if (message_type == "RepeatedSint32") ok = ProcessTestCase<conformance::RepeatedSint32>(textproto_path, bin_path);
-    else if (message_type == "RepeatedSint64") ok = ProcessTestCase<conformance::RepeatedSint64>(textproto_path, bin_path);
-    else if (message_type == "RepeatedBool") ok = ProcessTestCase<conformance::RepeatedBool>(textproto_path, bin_path);
-    else if (message_type == "RepeatedFixed32") ok = ProcessTestCase<conformance::RepeatedFixed32>(textproto_path, bin_path);
-    else if (message_type == "RepeatedSfixed32") ok = ProcessTestCase<conformance::RepeatedSfixed32>(textproto_path, bin_path);
-    else if (message_type == "RepeatedFixed64") ok = ProcessTestCase<conformance::RepeatedFixed64>(textproto_path, bin_path);
-    else if (message_type == "RepeatedSfixed64") ok = ProcessTestCase<conformance::RepeatedSfixed64>(textproto_path, bin_path);
-    else if (message_type == "RepeatedFloat") ok = ProcessTestCase<conformance::RepeatedFloat>(textproto_path, bin_path);
-    else if (message_type == "RepeatedDouble") ok = ProcessTestCase<conformance::RepeatedDouble>(textproto_path, bin_path);
-    else if (message_type == "RepeatedString") ok = ProcessTestCase<conformance::RepeatedString>(textproto_path, bin_path);
-    else if (message_type == "RepeatedBytes") ok = ProcessTestCase<conformance::RepeatedBytes>(textproto_path, bin_path);
-
-    // Nested
-    else if (message_type == "Outer") ok = ProcessTestCase<conformance::Outer>(textproto_path, bin_path);
-    else if (message_type == "Level0") ok = ProcessTestCase<conformance::Level0>(textproto_path, bin_path);
-    else if (message_type == "Node") ok = ProcessTestCase<conformance::Node>(textproto_path, bin_path);
-    else if (message_type == "OptionalNested") ok = ProcessTestCase<conformance::OptionalNested>(textproto_path, bin_path);
-
-    // Edge cases
-    else if (message_type == "FieldNumbers") ok = ProcessTestCase<conformance::FieldNumbers>(textproto_path, bin_path);
-    else if (message_type == "WireTypes") ok = ProcessTestCase<conformance::WireTypes>(textproto_path, bin_path);
-    else if (message_type == "Empty") ok = ProcessTestCase<conformance::Empty>(textproto_path, bin_path);
-    else if (message_type == "AllDefaults") ok = ProcessTestCase<conformance::AllDefaults>(textproto_path, bin_path);
-    else if (message_type == "OptionalFields") ok = ProcessTestCase<conformance::OptionalFields>(textproto_path, bin_path);
-
-    else {
-      std::cerr << "Unknown message type: " << message_type << std::endl;
-      fail_count++;
-      continue;
+    TestCase test_case;
+    test_case.id = absl::StrCat(category, "/", parts[0]);
+    test_case.category = category;
+    test_case.message_type = parts[1];
+    test_case.textproto_path = JoinPath(category_dir, parts[0] + ".textproto");
+    test_case.bin_path = JoinPath(JoinPath(output_dir, category), parts[0] + ".bin");
+    test_cases->push_back(std::move(test_case));
+  }
+  return ok;
+}
+
+enum class Outcome { kGenerated, kUpToDate, kFailed };
+
+struct TestResult {
+  Outcome outcome = Outcome::kFailed;
+  std::string log;
+  ManifestEntry entry;
+};
+
+// Regenerates one test case unless the manifest shows its .bin is current.
+TestResult RunTestCase(const TestCase& test_case, const ManifestEntry* previous, bool force) {
+  TestResult result;
+  result.entry.message_type = test_case.message_type;
+
+  auto registered = Registry().find(test_case.message_type);
+  if (registered == Registry().end()) {
+    result.log = absl::StrCat("Unknown message type ", test_case.message_type, ": ",
+                              test_case.textproto_path);
+    return result;
+  }
+  result.entry.schema_fingerprint = registered->second.schema_fingerprint;
+
+  std::error_code ec;
+  result.entry.size = std::filesystem::file_size(test_case.textproto_path, ec);
+  if (!ec) {
+    result.entry.mtime =
+        std::filesystem::last_write_time(test_case.textproto_path, ec).time_since_epoch().count();
+  }
+  if (ec) {
+    result.log = "Failed to open: " + test_case.textproto_path;
+    return result;
+  }
+
+  bool have_previous = !force && previous != nullptr &&
+                       previous->message_type == test_case.message_type &&
+                       previous->schema_fingerprint == result.entry.schema_fingerprint &&
+                       FileExists(test_case.bin_path);
+  if (have_previous && previous->size == result.entry.size &&
+      previous->mtime == result.entry.mtime) {
+    result.entry.fingerprint = previous->fingerprint;
+    result.outcome = Outcome::kUpToDate;
+    return result;
+  }
+
+  std::string text_content;
+  if (!ReadFile(test_case.textproto_path, &text_content)) {
+    result.log = "Failed to open: " + test_case.textproto_path;
+    return result;
+  }
+  result.entry.fingerprint = Fingerprint(text_content);
+  if (have_previous && previous->fingerprint == result.entry.fingerprint) {
+    result.outcome = Outcome::kUpToDate;
+    return result;
+  }
+
+  if (ProcessTestCase(*registered->second.prototype, text_content, test_case.bin_path,
+                      &result.log)) {
+    result.outcome = Outcome::kGenerated;
+  } else {
+    result.log = absl::StrCat(result.log, ": ", test_case.textproto_path);
+  }
+  return result;
+}
+
+// Runs every test case on `jobs` threads, returning results in input order.
+std::vector<TestResult> RunTestCases(const std::vector<TestCase>& test_cases,
+                                     const Manifest& manifest, bool force, int jobs) {
+  std::vector<TestResult> results(test_cases.size());
+  std::atomic<size_t> next{0};
+
+  auto worker = [&] {
+    for (size_t i = next++; i < test_cases.size(); i = next++) {
+      auto it = manifest.find(test_cases[i].id);
+      results[i] = RunTestCase(test_cases[i], it != manifest.end() ? &it->second : nullptr, force);
     }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < jobs; i++) threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads) thread.join();
+  return results;
+}
 
-    if (ok) {
-      success_count++;
-    } else {
-      fail_count++;
+// Synthetic benchmark corpus.
+//
+// Values are drawn straight from std::mt19937_64, whose output sequence is
+// fixed by the standard, rather than through std:: distributions (which are
+// implementation-defined), so a seed produces the same bytes everywhere.
+
+// Returns a random value in [0, n).
+uint64_t RandomBelow(std::mt19937_64& rng, uint64_t n) { return rng() % n; }
+
+// Returns a random int64 whose varint encoding is exactly `length` bytes.
+int64_t RandomInt64OfVarintLength(std::mt19937_64& rng, int length) {
+  // Negative int64 values are always sign-extended to 10 bytes.
+  if (length == 10) return -1 - static_cast<int64_t>(RandomBelow(rng, uint64_t{1} << 62));
+
+  uint64_t lo = length == 1 ? 0 : uint64_t{1} << (7 * (length - 1));
+  uint64_t hi = length == 9 ? uint64_t{1} << 63 : uint64_t{1} << (7 * length);
+  return static_cast<int64_t>(lo + RandomBelow(rng, hi - lo));
+}
+
+// `count` varints all `length` bytes long, or of uniformly mixed 1-10 byte
+// lengths if `length` is 0.
+conformance::RepeatedInt64 SynthesizeVarints(std::mt19937_64& rng, int count, int length) {
+  conformance::RepeatedInt64 message;
+  message.mutable_values()->Reserve(count);
+  for (int i = 0; i < count; i++) {
+    int n = length != 0 ? length : 1 + static_cast<int>(RandomBelow(rng, 10));
+    message.add_values(RandomInt64OfVarintLength(rng, n));
+  }
+  return message;
+}
+
+// A varint length and how often it occurs, in per mille of the values.
+struct LengthWeight {
+  int length;
+  int weight;
+};
+
+// Varint length histograms shaped like production traffic rather than
+// uniform: counts, enum values and small ids dominate, and every negative
+// int32 is sign-extended to 10 bytes.
+constexpr LengthWeight kShapedInt32Lengths[] = {
+    {1, 700}, {2, 200}, {3, 50}, {4, 10}, {5, 10}, {10, 30},
+};
+constexpr LengthWeight kShapedUint64Lengths[] = {
+    {1, 550}, {2, 250}, {3, 80}, {4, 40}, {5, 30}, {6, 20}, {7, 10}, {8, 10}, {9, 5}, {10, 5},
+};
+
+// Returns a length drawn from `lengths`, whose weights sum to 1000.
+template <size_t N>
+int RandomLength(std::mt19937_64& rng, const LengthWeight (&lengths)[N]) {
+  int pick = static_cast<int>(RandomBelow(rng, 1000));
+  for (const LengthWeight& entry : lengths) {
+    if (pick < entry.weight) return entry.length;
+    pick -= entry.weight;
+  }
+  return lengths[N - 1].length;
+}
+
+// Returns a random int32 whose varint encoding is exactly `length` bytes:
+// 1 to 5 for non-negative values, 10 for negative ones.
+int32_t RandomInt32OfVarintLength(std::mt19937_64& rng, int length) {
+  if (length == 10) return static_cast<int32_t>(-1 - RandomBelow(rng, uint64_t{1} << 31));
+
+  uint64_t lo = length == 1 ? 0 : uint64_t{1} << (7 * (length - 1));
+  uint64_t hi = length == 5 ? uint64_t{1} << 31 : uint64_t{1} << (7 * length);
+  return static_cast<int32_t>(lo + RandomBelow(rng, hi - lo));
+}
+
+// `count` int32 varints with kShapedInt32Lengths.
+conformance::RepeatedInt32 SynthesizeShapedInt32s(std::mt19937_64& rng, int count) {
+  conformance::RepeatedInt32 message;
+  message.mutable_values()->Reserve(count);
+  for (int i = 0; i < count; i++) {
+    message.add_values(RandomInt32OfVarintLength(rng, RandomLength(rng, kShapedInt32Lengths)));
+  }
+  return message;
+}
+
+// `count` uint64 varints with kShapedUint64Lengths.
+conformance::RepeatedUint64 SynthesizeShapedUint64s(std::mt19937_64& rng, int count) {
+  conformance::RepeatedUint64 message;
+  message.mutable_values()->Reserve(count);
+  for (int i = 0; i < count; i++) {
+    int length = RandomLength(rng, kShapedUint64Lengths);
+    message.add_values(static_cast<uint64_t>(RandomInt64OfVarintLength(rng, length)));
+  }
+  return message;
+}
+
+// `count` random byte strings of 0 to `max_length` bytes.
+conformance::RepeatedBytes SynthesizeSmallBytes(std::mt19937_64& rng, int count,
+                                                int max_length) {
+  conformance::RepeatedBytes message;
+  message.mutable_values()->Reserve(count);
+  for (int i = 0; i < count; i++) {
+    std::string* value = message.add_values();
+    value->resize(RandomBelow(rng, max_length + 1));
+    for (char& c : *value) c = static_cast<char>(rng());
+  }
+  return message;
+}
+
+// `count` values in every packed field of RepeatedScalars. Varints get a
+// random magnitude, so their encodings spread over every length; floating
+// point values are in [0, 1), so none of them is NaN.
+conformance::RepeatedScalars SynthesizeRepeatedScalars(std::mt19937_64& rng, int count) {
+  conformance::RepeatedScalars message;
+  for (int i = 0; i < count; i++) {
+    uint64_t bits = rng();
+    bits >>= RandomBelow(rng, 64);
+    uint32_t bits32 = static_cast<uint32_t>(bits);
+    message.add_val_int32(static_cast<int32_t>(bits32));
+    message.add_val_int64(static_cast<int64_t>(bits));
+    message.add_val_uint32(bits32);
+    message.add_val_uint64(bits);
+    message.add_val_sint32(static_cast<int32_t>(bits32));
+    message.add_val_sint64(static_cast<int64_t>(bits));
+    message.add_val_bool(rng() & 1);
+    message.add_val_fixed32(static_cast<uint32_t>(rng()));
+    message.add_val_sfixed32(static_cast<int32_t>(rng()));
+    message.add_val_fixed64(rng());
+    message.add_val_sfixed64(static_cast<int64_t>(rng()));
+    message.add_val_float(static_cast<float>(rng() >> 40) * 0x1.0p-24f);
+    message.add_val_double(static_cast<double>(rng() >> 11) * 0x1.0p-53);
+  }
+  return message;
+}
+
+// `chunks` RepeatedScalars of `count / chunks` values each, serialized back
+// to back. That parses as their merge, so every packed field arrives as
+// `chunks` separate length-delimited records, as from a writer that emits a
+// message in parts.
+std::string SynthesizeChunkedScalars(std::mt19937_64& rng, int count, int chunks) {
+  std::string binary;
+  for (int i = 0; i < chunks; i++) {
+    SynthesizeRepeatedScalars(rng, count / chunks).AppendToString(&binary);
+  }
+  return binary;
+}
+
+// Fills `node` with a complete tree of `depth` levels below it, numbering
+// nodes in pre-order from `*next_id`.
+void SynthesizeTree(conformance::Node* node, int depth, int fanout, int32_t* next_id) {
+  node->set_id((*next_id)++);
+  node->set_label(absl::StrCat("node-", node->id()));
+  if (depth == 0) return;
+  for (int i = 0; i < fanout; i++) {
+    SynthesizeTree(node->add_children(), depth - 1, fanout, next_id);
+  }
+}
+
+// Fills `node` with a spine `depth` messages deep below it: each node on the
+// spine has `fanout` children, the first of which continues the spine and
+// the rest are leaves. Deep like real nested payloads, without a complete
+// tree's exponential size. Nodes are numbered in pre-order from `*next_id`.
+void SynthesizeSpine(conformance::Node* node, int depth, int fanout, int32_t* next_id) {
+  node->set_id((*next_id)++);
+  node->set_label(absl::StrCat("spine-", node->id()));
+  if (depth == 0) return;
+  SynthesizeSpine(node->add_children(), depth - 1, fanout, next_id);
+  for (int i = 1; i < fanout; i++) {
+    conformance::Node* leaf = node->add_children();
+    leaf->set_id((*next_id)++);
+    leaf->set_label(absl::StrCat("leaf-", leaf->id()));
+  }
+}
+
+// An Outer with `count` items, each a random value and a label of up to
+// `max_label` characters: a wide message where readers typically want a few
+// of the items, not all of them.
+conformance::Outer SynthesizeOuterItems(std::mt19937_64& rng, int count, int max_label) {
+  conformance::Outer message;
+  message.set_id(count);
+  message.mutable_inner()->set_value(-1);
+  message.mutable_inner()->set_name("header");
+  message.mutable_items()->Reserve(count);
+  for (int i = 0; i < count; i++) {
+    conformance::Outer::Inner* item = message.add_items();
+    item->set_value(static_cast<int32_t>(rng() >> RandomBelow(rng, 64)));
+    std::string* name = item->mutable_name();
+    name->resize(RandomBelow(rng, max_label + 1));
+    for (char& c : *name) c = static_cast<char>('a' + RandomBelow(rng, 26));
+  }
+  return message;
+}
+
+// `count` WideRecords, each with every extra field set: what a newer writer
+// sends a reader still on NarrowRecord. Strings and bytes are up to
+// `max_length` long.
+conformance::WideRecords SynthesizeWideRecords(std::mt19937_64& rng, int count, int max_length) {
+  auto random_string = [&rng, max_length](std::string* value) {
+    value->resize(RandomBelow(rng, max_length + 1));
+    for (char& c : *value) c = static_cast<char>('a' + RandomBelow(rng, 26));
+  };
+
+  conformance::WideRecords message;
+  message.mutable_records()->Reserve(count);
+  for (int i = 0; i < count; i++) {
+    conformance::WideRecord* record = message.add_records();
+    record->set_id(i);
+    random_string(record->mutable_name());
+    record->set_extra_int64(static_cast<int64_t>(rng() >> RandomBelow(rng, 64)));
+    record->set_extra_sint64(static_cast<int64_t>(rng()) >> RandomBelow(rng, 64));
+    record->set_extra_bool(true);
+    record->set_extra_fixed64(rng());
+    record->set_extra_double(static_cast<double>(rng() >> 11) * 0x1.0p-53);
+    record->set_extra_fixed32(static_cast<uint32_t>(rng()));
+    record->set_extra_float(static_cast<float>(rng() >> 40) * 0x1.0p-24f);
+    random_string(record->mutable_extra_string());
+    random_string(record->mutable_extra_bytes());
+    record->mutable_extra_message()->set_value(static_cast<int32_t>(rng()));
+    for (int j = 0, n = RandomBelow(rng, 9); j < n; j++) {
+      record->add_extra_packed(static_cast<int64_t>(rng() >> RandomBelow(rng, 64)));
+    }
+    for (int j = 0, n = RandomBelow(rng, 4); j < n; j++) {
+      random_string(record->add_extra_strings());
+    }
+    record->set_extra_high_tag(rng());
+  }
+  return message;
+}
+
+// A map of `count` config-style string keys ("<section>.<name>_<i>") to
+// varint values of random length. The index keeps the keys distinct.
+conformance::StringKeyMap SynthesizeStringKeyMap(std::mt19937_64& rng, int count) {
+  static constexpr const char* kSections[] = {"server", "client", "cache", "log", "feature"};
+  conformance::StringKeyMap message;
+  auto& entries = *message.mutable_entries();
+  for (int i = 0; i < count; i++) {
+    std::string name(1 + RandomBelow(rng, 12), ' ');
+    for (char& c : name) c = static_cast<char>('a' + RandomBelow(rng, 26));
+    entries[absl::StrCat(kSections[RandomBelow(rng, std::size(kSections))], ".", name, "_", i)] =
+        static_cast<int64_t>(rng() >> RandomBelow(rng, 64));
+  }
+  return message;
+}
+
+// A map of `count` distinct int64 keys of random magnitude to short strings.
+conformance::Int64KeyMap SynthesizeInt64KeyMap(std::mt19937_64& rng, int count) {
+  conformance::Int64KeyMap message;
+  auto& entries = *message.mutable_entries();
+  while (static_cast<int>(entries.size()) < count) {
+    std::string value(RandomBelow(rng, 17), ' ');
+    for (char& c : value) c = static_cast<char>('a' + RandomBelow(rng, 26));
+    entries[static_cast<int64_t>(rng() >> RandomBelow(rng, 64))] = std::move(value);
+  }
+  return message;
+}
+
+// Writes one synthetic payload of `message_type` and records it in the
+// manifest.
+bool WriteSyntheticBinary(const std::string& output_dir, const std::string& test_name,
+                          const std::string& message_type, const std::string& binary,
+                          std::ostream& manifest) {
+  std::string bin_path = JoinPath(output_dir, test_name + ".bin");
+  if (!WriteFile(bin_path, binary)) {
+    return false;
+  }
+
+  manifest << test_name << " " << message_type << "\n";
+  std::cout << "Synthesized: " << bin_path << " (" << binary.size() << " bytes)" << std::endl;
+  return true;
+}
+
+bool WriteSynthetic(const std::string& output_dir, const std::string& test_name,
+                    const google::protobuf::Message& message, std::ostream& manifest,
+                    std::string* binary_out = nullptr) {
+  std::string binary;
+  if (!message.SerializeToString(&binary)) {
+    std::cerr << "Failed to serialize: " << test_name << std::endl;
+    return false;
+  }
+  bool ok = WriteSyntheticBinary(output_dir, test_name, message.GetDescriptor()->name(), binary,
+                                 manifest);
+  if (binary_out != nullptr) *binary_out = std::move(binary);
+  return ok;
+}
+
+// Decodes `packed` as varints with CodedInputStream::ReadVarint64, `passes`
+// times after one untimed pass, and appends "<test_name> <values> <sum>
+// <ns_per_pass>" to `reference`. The sum (mod 2^64) lets another decoder
+// check it read the same values.
+bool AppendVarintReference(const std::string& test_name, absl::string_view packed, int passes,
+                           std::ostream& reference) {
+  using Clock = std::chrono::steady_clock;
+
+  uint64_t values = 0;
+  uint64_t sum = 0;
+  auto decode_pass = [&] {
+    google::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const uint8_t*>(packed.data()), static_cast<int>(packed.size()));
+    uint64_t pass_values = 0;
+    uint64_t pass_sum = 0;
+    uint64_t value;
+    while (input.ReadVarint64(&value)) {
+      pass_values++;
+      pass_sum += value;
     }
+    if (input.CurrentPosition() != static_cast<int>(packed.size())) return false;
+    values = pass_values;
+    sum = pass_sum;
+    return true;
+  };
+
+  if (!decode_pass()) {
+    std::cerr << "Malformed varints in " << test_name << std::endl;
+    return false;
   }
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < passes; i++) decode_pass();
+  int64_t elapsed_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+  int64_t ns_per_pass = elapsed_ns / passes;
+  reference << test_name << " " << values << " " << sum << " " << ns_per_pass << "\n";
+  std::cout << "ReadVarint64: " << test_name << " ("
+            << (values == 0 ? 0.0 : static_cast<double>(ns_per_pass) / values)
+            << " ns/varint)" << std::endl;
+  return true;
+}
 
-  std::cout << "Category " << category << ": " << success_count << " succeeded, "
-            << fail_count << " failed" << std::endl;
-  return fail_count == 0;
+// Writes a payload whose only field is packed varints, and its
+// ReadVarint64 timings.
+bool WriteVarintSynthetic(const std::string& output_dir, const std::string& test_name,
+                          const google::protobuf::Message& message, int passes,
+                          std::ostream& manifest, std::ostream& reference) {
+  std::string binary;
+  if (!WriteSynthetic(output_dir, test_name, message, manifest, &binary)) return false;
+
+  // Skip the field's tag and length; an empty field has neither.
+  absl::string_view packed;
+  if (!binary.empty()) {
+    google::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const uint8_t*>(binary.data()), static_cast<int>(binary.size()));
+    uint32_t length;
+    if (input.ReadTag() == 0 || !input.ReadVarint32(&length) ||
+        input.CurrentPosition() + uint64_t{length} != binary.size()) {
+      std::cerr << "Expected a single packed field in " << test_name << std::endl;
+      return false;
+    }
+    packed = absl::string_view(binary).substr(input.CurrentPosition());
+  }
+  return AppendVarintReference(test_name, packed, passes, reference);
+}
+
+// Generates the benchmark corpus into `output_dir`, with a tests.txt in the
+// same format as the testdata categories.
+bool SynthesizeCorpus(const std::string& output_dir) {
+  uint64_t seed = absl::GetFlag(FLAGS_seed);
+  int elements = absl::GetFlag(FLAGS_elements);
+  int depth = absl::GetFlag(FLAGS_tree_depth);
+  int fanout = absl::GetFlag(FLAGS_tree_fanout);
+  int chunks = absl::GetFlag(FLAGS_packed_chunks);
+  int passes = absl::GetFlag(FLAGS_varint_passes);
+  int spine_fanout = absl::GetFlag(FLAGS_spine_fanout);
+  std::vector<int> map_sizes;
+  for (const std::string& size : absl::GetFlag(FLAGS_map_sizes)) {
+    int value;
+    if (!absl::SimpleAtoi(size, &value) || value < 0) {
+      std::cerr << "Error: --map_sizes must be non-negative integers; got " << size << std::endl;
+      return false;
+    }
+    map_sizes.push_back(value);
+  }
+  std::vector<int> spine_depths;
+  for (const std::string& depth : absl::GetFlag(FLAGS_spine_depths)) {
+    // C++ rejects messages nested deeper than this; a benchmark payload that
+    // only protomon can parse compares nothing.
+    int limit = google::protobuf::io::CodedInputStream::GetDefaultRecursionLimit();
+    int value;
+    if (!absl::SimpleAtoi(depth, &value) || value < 0 || value > limit) {
+      std::cerr << "Error: --spine_depths must be integers from 0 to " << limit
+                << ", C++'s default recursion limit; got " << depth << std::endl;
+      return false;
+    }
+    spine_depths.push_back(value);
+  }
+  if (elements < 0 || depth < 0 || fanout < 0) {
+    std::cerr << "Error: --elements, --tree_depth and --tree_fanout must be non-negative"
+              << std::endl;
+    return false;
+  }
+  if (chunks <= 0 || passes <= 0 || spine_fanout <= 0) {
+    std::cerr << "Error: --packed_chunks, --varint_passes and --spine_fanout must be positive"
+              << std::endl;
+    return false;
+  }
+
+  MkdirP(output_dir);
+  std::mt19937_64 rng(seed);
+  std::ostringstream manifest;
+  manifest << "# Synthetic benchmark corpus (generate_binaries --synthesize --seed=" << seed
+           << " --elements=" << elements << " --tree_depth=" << depth
+           << " --tree_fanout=" << fanout << " --packed_chunks=" << chunks
+           << " --spine_depths=" << absl::StrJoin(spine_depths, ",")
+           << " --spine_fanout=" << spine_fanout
+           << " --map_sizes=" << absl::StrJoin(map_sizes, ",") << ")\n";
+  manifest << "# Format: test_name message_type\n";
+  std::ostringstream reference;
+  reference << "# CodedInputStream::ReadVarint64 over each varint payload's packed values\n";
+  reference << "# Format: test_name values sum ns_per_pass\n";
+
+  bool ok = true;
+  for (int length : {1, 2, 5, 10}) {
+    ok &= WriteVarintSynthetic(output_dir, absl::StrCat("int64_varint", length, "byte"),
+                               SynthesizeVarints(rng, elements, length), passes, manifest,
+                               reference);
+  }
+  ok &= WriteVarintSynthetic(output_dir, "int64_varint_mixed",
+                             SynthesizeVarints(rng, elements, 0), passes, manifest, reference);
+  ok &= WriteSynthetic(output_dir, "bytes_small", SynthesizeSmallBytes(rng, elements / 10, 32),
+                       manifest);
+  ok &= WriteSynthetic(output_dir, "repeated_scalars",
+                       SynthesizeRepeatedScalars(rng, elements / 10), manifest);
+  ok &= WriteSyntheticBinary(output_dir, "repeated_scalars_chunked", "RepeatedScalars",
+                             SynthesizeChunkedScalars(rng, elements / 10, chunks), manifest);
+  ok &= WriteVarintSynthetic(output_dir, "varint_shaped_int32",
+                             SynthesizeShapedInt32s(rng, elements), passes, manifest, reference);
+  ok &= WriteVarintSynthetic(output_dir, "varint_shaped_uint64",
+                             SynthesizeShapedUint64s(rng, elements), passes, manifest, reference);
+
+  conformance::Node tree;
+  int32_t next_id = 0;
+  SynthesizeTree(&tree, depth, fanout, &next_id);
+  ok &= WriteSynthetic(output_dir, absl::StrCat("node_tree_d", depth, "_f", fanout), tree,
+                       manifest);
+
+  for (int spine_depth : spine_depths) {
+    conformance::Node spine;
+    next_id = 0;
+    SynthesizeSpine(&spine, spine_depth, spine_fanout, &next_id);
+    ok &= WriteSynthetic(output_dir, absl::StrCat("node_spine_d", spine_depth, "_f", spine_fanout),
+                         spine, manifest);
+  }
+  ok &= WriteSynthetic(output_dir, "outer_items", SynthesizeOuterItems(rng, elements / 10, 32),
+                       manifest);
+  // Listed as NarrowRecords: readers decode it with the older schema, so
+  // everything but id and name is an unknown field.
+  ok &= WriteSyntheticBinary(output_dir, "unknown_wide_records", "NarrowRecords",
+                             SynthesizeWideRecords(rng, elements / 100, 16).SerializeAsString(),
+                             manifest);
+  for (int size : map_sizes) {
+    ok &= WriteSynthetic(output_dir, absl::StrCat("map_string_", size),
+                         SynthesizeStringKeyMap(rng, size), manifest);
+    ok &= WriteSynthetic(output_dir, absl::StrCat("map_int64_", size),
+                         SynthesizeInt64KeyMap(rng, size), manifest);
+  }
+
+  ok &= WriteFile(JoinPath(output_dir, "tests.txt"), manifest.str());
+  ok &= WriteFile(JoinPath(output_dir, "varint_reference.txt"), reference.str());
+  return ok;
 }
 
 int main(int argc, char* argv[]) {
@@ -233,6 +892,16 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  if (absl::GetFlag(FLAGS_synthesize)) {
+    std::cout << "Output directory: " << output_dir << std::endl;
+    if (!SynthesizeCorpus(output_dir)) {
+      std::cerr << "\nSome benchmark payloads failed to generate." << std::endl;
+      return 1;
+    }
+    std::cout << "\nBenchmark corpus generated successfully!" << std::endl;
+    return 0;
+  }
+
   if (input_dir.empty()) {
     // Default to the same as output_dir
     input_dir = output_dir;
@@ -241,11 +910,60 @@ int main(int argc, char* argv[]) {
   std::cout << "Input directory: " << input_dir << std::endl;
   std::cout << "Output directory: " << output_dir << std::endl;
 
+  const std::vector<std::string> categories = {"scalars", "repeated", "nested", "edge_cases",
+                                               "maps"};
   bool all_ok = true;
-  all_ok &= ProcessCategory(input_dir, output_dir, "scalars");
-  all_ok &= ProcessCategory(input_dir, output_dir, "repeated");
-  all_ok &= ProcessCategory(input_dir, output_dir, "nested");
-  all_ok &= ProcessCategory(input_dir, output_dir, "edge_cases");
+  std::vector<TestCase> test_cases;
+  for (const std::string& category : categories) {
+    all_ok &= CollectCategory(input_dir, output_dir, category, &test_cases);
+  }
+
+  // Create each output directory once, up front.
+  std::set<std::string> created;
+  for (const TestCase& test_case : test_cases) {
+    if (created.insert(test_case.category).second) {
+      MkdirP(JoinPath(output_dir, test_case.category));
+    }
+  }
+
+  int jobs = absl::GetFlag(FLAGS_jobs);
+  if (jobs <= 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+
+  Manifest manifest = LoadManifest(output_dir);
+  std::vector<TestResult> results =
+      RunTestCases(test_cases, manifest, absl::GetFlag(FLAGS_force), jobs);
+
+  // Report in tests.txt order, and record what each .bin was built from. A
+  // failed test case is left out of the manifest so the next run retries it.
+  Manifest updated;
+  std::map<std::string, std::array<int, 3>> counts;
+  for (size_t i = 0; i < test_cases.size(); i++) {
+    const TestCase& test_case = test_cases[i];
+    const TestResult& result = results[i];
+    counts[test_case.category][static_cast<int>(result.outcome)]++;
+
+    if (result.outcome == Outcome::kFailed) {
+      std::cerr << result.log << std::endl;
+      all_ok = false;
+      continue;
+    }
+    if (result.outcome == Outcome::kGenerated) {
+      std::cout << result.log << std::endl;
+    }
+    updated[test_case.id] = result.entry;
+  }
+
+  for (const std::string& category : categories) {
+    const std::array<int, 3>& count = counts[category];
+    std::cout << "Category " << category << ": "
+              << count[static_cast<int>(Outcome::kGenerated)] << " generated, "
+              << count[static_cast<int>(Outcome::kUpToDate)] << " up to date, "
+              << count[static_cast<int>(Outcome::kFailed)] << " failed" << std::endl;
+  }
+
+  if (!SaveManifest(output_dir, updated)) {
+    all_ok = false;
+  }
 
   if (all_ok) {
     std::cout << "\nAll test cases generated successfully!" << std::endl;
@@ -3,6 +3,9 @@
 //! This crate reads binary protobuf files generated by the C++ protobuf library
 //! and verifies that protomon decodes them correctly.
 
+// Generated map fields default to `alloc::collections::BTreeMap`.
+extern crate alloc;
+
 // Include the generated protobuf code
 pub mod protos {
     include!(concat!(env!("OUT_DIR"), "/mod.rs"));
@@ -1148,3 +1148,89 @@ mod edge_cases {
         assert!(msg.opt_bool.is_none());
     }
 }
+
+// =============================================================================
+// Map Tests
+// =============================================================================
+
+mod maps {
+    use super::*;
+
+    #[test]
+    fn maps_empty() {
+        let data = read_bin("maps", "maps_empty");
+        let msg = Maps::decode_message(data).unwrap();
+        assert!(msg.string_to_string.is_empty());
+        assert!(msg.string_to_message.is_empty());
+    }
+
+    #[test]
+    fn maps_all() {
+        let data = read_bin("maps", "maps_all");
+        let msg = Maps::decode_message(data).unwrap();
+
+        assert_eq!(msg.string_to_string.len(), 2);
+        assert_eq!(msg.string_to_string["host"].as_str(), "localhost");
+        assert_eq!(msg.string_to_string["mode"].as_str(), "fast");
+        assert_eq!(msg.string_to_int32["retries"], 3);
+        assert_eq!(msg.string_to_int32["offset"], -7);
+        assert_eq!(msg.int32_to_string[&1].as_str(), "one");
+        assert_eq!(msg.int32_to_string[&-1].as_str(), "minus one");
+        assert_eq!(msg.int64_to_int64[&i64::MAX], i64::MIN);
+        assert_eq!(msg.int64_to_int64[&42], 4242);
+        assert!(msg.uint32_to_bool[&u32::MAX]);
+        assert!(!msg.uint32_to_bool[&7]);
+        assert_eq!(msg.sint64_to_double[&Sint64(-100)], 3.5);
+        assert_eq!(msg.sint64_to_double[&Sint64(100)], -0.25);
+        assert_eq!(&msg.bool_to_bytes[&true][..], b"\x00\x01\x02");
+        assert_eq!(&msg.bool_to_bytes[&false][..], b"\xff");
+
+        let first = &msg.string_to_message["first"];
+        assert_eq!(first.id, 1);
+        assert_eq!(first.label.as_str(), "a");
+        let second = &msg.string_to_message["second"];
+        assert_eq!(second.id, 2);
+        assert_eq!(second.label.as_str(), "b");
+    }
+
+    #[test]
+    fn maps_default_entries() {
+        let data = read_bin("maps", "maps_default_entries");
+        let msg = Maps::decode_message(data).unwrap();
+        assert_eq!(msg.string_to_string[""].as_str(), "empty key");
+        assert_eq!(msg.string_to_int32["zero"], 0);
+        assert_eq!(msg.int32_to_string[&0].as_str(), "");
+        assert_eq!(msg.string_to_message["empty"].id, 0);
+    }
+
+    #[test]
+    fn string_key_map() {
+        let data = read_bin("maps", "string_key_map");
+        let msg = StringKeyMap::decode_message(data).unwrap();
+        assert_eq!(msg.entries.len(), 3);
+        assert_eq!(msg.entries["server.port"], 8080);
+        assert_eq!(msg.entries["server.threads"], 16);
+        assert_eq!(msg.entries["cache.bytes"], 1 << 30);
+    }
+
+    #[test]
+    fn int64_key_map() {
+        let data = read_bin("maps", "int64_key_map");
+        let msg = Int64KeyMap::decode_message(data).unwrap();
+        assert_eq!(msg.entries.len(), 3);
+        assert_eq!(msg.entries[&-1].as_str(), "negative");
+        assert_eq!(msg.entries[&1].as_str(), "positive");
+        assert_eq!(msg.entries[&(1 << 40)].as_str(), "large");
+    }
+
+    #[test]
+    fn single_map_roundtrip() {
+        // C++ writes map entries in hash order, so compare decoded maps
+        // rather than bytes.
+        let data = read_bin("maps", "string_key_map");
+        let msg = StringKeyMap::decode_message(data).unwrap();
+        let mut buf = Vec::new();
+        msg.encode_message(&mut buf);
+        assert_eq!(StringKeyMap::decode_message(Bytes::from(buf)).unwrap().entries, msg.entries);
+    }
+}
@@ -0,0 +1,29 @@
+//! Links the C++ reference oracle when the `cpp-oracle` feature is enabled.
+//!
+//! Build the self-contained static library first, then point
+//! `PROTOMON_ORACLE_LIB_DIR` at the directory holding it:
+//!
+//! ```text
+//! (cd harness && bazel build //cpp:oracle_static)
+//! PROTOMON_ORACLE_LIB_DIR=$(pwd)/harness/bazel-bin/cpp cargo build --features cpp-oracle
+//! ```
+
+use std::env;
+
+fn main() {
+    println!("cargo:rerun-if-env-changed=PROTOMON_ORACLE_LIB_DIR");
+    if env::var_os("CARGO_FEATURE_CPP_ORACLE").is_none() {
+        return;
+    }
+
+    let lib_dir = env::var("PROTOMON_ORACLE_LIB_DIR")
+        .expect("the cpp-oracle feature needs PROTOMON_ORACLE_LIB_DIR (see build.rs)");
+    println!("cargo:rustc-link-search=native={}", lib_dir);
+    println!("cargo:rustc-link-lib=static=oracle_static");
+
+    let cxx_runtime = match env::var("CARGO_CFG_TARGET_OS").as_deref() {
+        Ok("macos") | Ok("ios") => "c++",
+        _ => "stdc++",
+    };
+    println!("cargo:rustc-link-lib=dylib={}", cxx_runtime);
+}
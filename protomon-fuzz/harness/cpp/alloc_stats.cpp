@@ -0,0 +1,60 @@
+#include "cpp/alloc_stats.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace harness {
+namespace {
+
+// The harnesses are single-threaded, so plain counters are enough.
+uint64_t g_allocations = 0;
+uint64_t g_bytes = 0;
+
+void* CountedAlloc(std::size_t size, std::size_t alignment) {
+  g_allocations++;
+  g_bytes += size;
+
+  if (size == 0) size = 1;
+  void* ptr;
+  if (alignment <= alignof(std::max_align_t)) {
+    ptr = std::malloc(size);
+  } else {
+    // aligned_alloc requires the size to be a multiple of the alignment.
+    ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+  }
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+}  // namespace
+
+AllocStats CurrentAllocStats() { return {g_allocations, g_bytes}; }
+
+void ReportAllocStats(const AllocStats& delta, const google::protobuf::Arena* arena) {
+  std::cerr << "Allocations: " << delta.allocations << " (" << delta.bytes << " bytes)";
+  if (arena != nullptr) {
+    std::cerr << ", arena: " << arena->SpaceUsed() << " bytes used of "
+              << arena->SpaceAllocated() << " allocated";
+  }
+  std::cerr << std::endl;
+}
+
+}  // namespace harness
+
+// The default operator delete calls free(), which matches both paths above.
+void* operator new(std::size_t size) {
+  return harness::CountedAlloc(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size) {
+  return harness::CountedAlloc(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return harness::CountedAlloc(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return harness::CountedAlloc(size, static_cast<std::size_t>(alignment));
+}
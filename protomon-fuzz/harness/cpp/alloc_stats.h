@@ -0,0 +1,35 @@
+// Heap allocation accounting for the protomon-fuzz harnesses.
+//
+// Linking this library replaces the global operator new with a counting
+// version, so every heap allocation in the process is tallied, including the
+// blocks an Arena allocates. Take a snapshot before and after a request and
+// subtract them to get that request's cost.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_ALLOC_STATS_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_ALLOC_STATS_H_
+
+#include <cstdint>
+
+#include "google/protobuf/arena.h"
+
+namespace harness {
+
+struct AllocStats {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+
+  AllocStats operator-(const AllocStats& other) const {
+    return {allocations - other.allocations, bytes - other.bytes};
+  }
+};
+
+// Returns the heap allocation totals since process start.
+AllocStats CurrentAllocStats();
+
+// Prints `delta` as one line to stderr, along with the space used on `arena`
+// if it is non-null.
+void ReportAllocStats(const AllocStats& delta, const google::protobuf::Arena* arena);
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_ALLOC_STATS_H_
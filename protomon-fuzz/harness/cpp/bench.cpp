@@ -0,0 +1,111 @@
+#include "cpp/bench.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "cpp/fd_input.h"
+#include "google/protobuf/io/coded_stream.h"
+
+namespace harness {
+namespace {
+
+// The sample at quantile `q` of sorted `samples`.
+int64_t Percentile(const std::vector<int64_t>& samples, double q) {
+  if (samples.empty()) return 0;
+  size_t index = std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()));
+  return samples[index];
+}
+
+}  // namespace
+
+bool LoadDelimitedCorpus(google::protobuf::io::ZeroCopyInputStream* input,
+                         std::vector<std::string>* corpus, std::string* error) {
+  // A CodedInputStream tracks its position in an int and stops at INT_MAX
+  // bytes, so each record gets a fresh one, as ParseDelimitedFromZeroCopyStream
+  // does. Its destructor backs unread input up into `input` for the next.
+  int64_t offset = 0;
+  while (true) {
+    google::protobuf::io::CodedInputStream coded(input);
+    uint32_t size;
+    std::string record;
+    if (!coded.ReadVarint32(&size)) {
+      // Nothing consumed means a clean end of input between records.
+      if (coded.CurrentPosition() == 0) return true;
+    } else if (coded.ReadString(&record, size)) {
+      offset += coded.CurrentPosition();
+      corpus->push_back(std::move(record));
+      continue;
+    }
+    *error = "Truncated or malformed record " + std::to_string(corpus->size()) + " at offset " +
+             std::to_string(offset);
+    return false;
+  }
+}
+
+bool LoadCorpus(const std::string& path, std::vector<std::string>* corpus, std::string* error) {
+  std::error_code ec;
+  if (std::filesystem::is_directory(path, ec)) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+      if (entry.is_regular_file() && entry.path().extension() == ".bin") {
+        files.push_back(entry.path());
+      }
+    }
+    if (ec) {
+      *error = "Failed to list " + path + ": " + ec.message();
+      return false;
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& file : files) {
+      std::ifstream in(file, std::ios::binary);
+      if (!in) {
+        *error = "Failed to open " + file.string();
+        return false;
+      }
+      corpus->emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    return true;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "Failed to open " + path + ": " + strerror(errno);
+    return false;
+  }
+  bool ok;
+  {
+    FdInput input(fd);
+    ok = LoadDelimitedCorpus(input.stream(), corpus, error);
+    if (input.read_errno() != 0) {
+      *error = "Failed to read " + path + ": " + strerror(input.read_errno());
+      ok = false;
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+void PrintBenchResult(absl::string_view message, absl::string_view op, BenchResult* result) {
+  std::sort(result->latencies_ns.begin(), result->latencies_ns.end());
+  double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+
+  std::cout << "{\"message\":\"" << message << "\",\"op\":\"" << op
+            << "\",\"messages\":" << result->messages << ",\"bytes\":" << result->bytes
+            << ",\"seconds\":" << result->seconds
+            << ",\"messages_per_sec\":" << result->messages / seconds
+            << ",\"mb_per_sec\":" << result->bytes / seconds / 1e6
+            << ",\"p50_ns\":" << Percentile(result->latencies_ns, 0.5)
+            << ",\"p99_ns\":" << Percentile(result->latencies_ns, 0.99)
+            << ",\"p999_ns\":" << Percentile(result->latencies_ns, 0.999) << "}" << std::endl;
+}
+
+}  // namespace harness
@@ -0,0 +1,76 @@
+// Throughput and latency measurement for the harnesses' --mode=bench.
+//
+// A corpus is loaded into memory once, either from a directory of .bin files
+// (one message each) or from varint-length-delimited records, and an
+// operation is then timed once per message over repeated passes. Results are
+// printed as one JSON object per line so they can be collected by scripts and
+// compared against protomon's criterion benches.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_BENCH_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_BENCH_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+namespace harness {
+
+// Reads varint-length-delimited records from `input` until it ends. Returns
+// false, with `error` set, on a truncated or malformed record.
+bool LoadDelimitedCorpus(google::protobuf::io::ZeroCopyInputStream* input,
+                         std::vector<std::string>* corpus, std::string* error);
+
+// Loads `path`: every .bin file under it, in name order, if it is a
+// directory, and its delimited records otherwise.
+bool LoadCorpus(const std::string& path, std::vector<std::string>* corpus, std::string* error);
+
+struct BenchResult {
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  // One sample per timed call of the operation.
+  std::vector<int64_t> latencies_ns;
+};
+
+// Calls `op(i)` for every corpus index `i`, first `warmup` untimed passes and
+// then `iterations` timed ones. `bytes_per_pass` is the payload size one pass
+// processes, for the MB/s figure. Each latency sample includes the cost of
+// two clock reads, so treat sub-100ns percentiles as upper bounds.
+template <typename Op>
+BenchResult RunBench(size_t corpus_size, uint64_t bytes_per_pass, int warmup, int iterations,
+                     Op op) {
+  using Clock = std::chrono::steady_clock;
+
+  for (int pass = 0; pass < warmup; pass++) {
+    for (size_t i = 0; i < corpus_size; i++) op(i);
+  }
+
+  BenchResult result;
+  result.latencies_ns.reserve(corpus_size * iterations);
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < iterations; pass++) {
+    for (size_t i = 0; i < corpus_size; i++) {
+      Clock::time_point before = Clock::now();
+      op(i);
+      Clock::time_point after = Clock::now();
+      result.latencies_ns.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count());
+    }
+  }
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  result.messages = static_cast<uint64_t>(corpus_size) * iterations;
+  result.bytes = bytes_per_pass * iterations;
+  return result;
+}
+
+// Prints `result` as one JSON object on stdout: messages/s, MB/s and the
+// p50/p99/p99.9 per-message latency. Sorts the latency samples.
+void PrintBenchResult(absl::string_view message, absl::string_view op, BenchResult* result);
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_BENCH_H_
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Builds a harness_compiled binary specialized for one .proto file.
+#
+# Usage: build_specialized.sh SCHEMA.proto OUTPUT
+#
+# protomon-fuzz's SpecializedHarnesses (harness_test --specialize) runs this
+# for schemas that keep recurring in a campaign. It generates C++ for
+# SCHEMA.proto with protoc, writes its message registry with registry_gen,
+# and compiles both with main_compiled.cpp and the harness libraries, outside
+# Bazel. Imports resolve relative to the schema's directory.
+#
+# Environment:
+#   PROTOC            protoc matching the linked libprotobuf (default: protoc)
+#   REGISTRY_GEN      registry_gen binary (default: bazel-bin/cpp/registry_gen,
+#                     from `bazel build //cpp:registry_gen`)
+#   CXX               C++ compiler (default: c++)
+#   HARNESS_CXXFLAGS  protobuf and abseil compile flags (default: pkg-config
+#                     --cflags protobuf absl_flags absl_flags_parse absl_status
+#                     absl_strings)
+#   HARNESS_LIBS      protobuf and abseil link flags (default: pkg-config
+#                     --libs with the same packages)
+set -eu
+
+if [ "$#" -ne 2 ]; then
+  echo "Usage: $0 SCHEMA.proto OUTPUT" >&2
+  exit 1
+fi
+
+cpp_dir=$(cd "$(dirname "$0")" && pwd)
+harness_dir=$(dirname "$cpp_dir")
+schema_dir=$(cd "$(dirname "$1")" && pwd)
+schema_file=$(basename "$1")
+output=$2
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+"${PROTOC:-protoc}" -I"$schema_dir" --cpp_out="$work" \
+  --descriptor_set_out="$work/schema.pb" "$schema_dir/$schema_file"
+"${REGISTRY_GEN:-$harness_dir/bazel-bin/cpp/registry_gen}" \
+  --descriptor_sets="$work/schema.pb" --out="$work/registry.cc"
+
+# The abseil libraries the harness uses directly, as in its Bazel deps; the
+# flags ones in particular are not among protobuf.pc's dependencies.
+pkgs="protobuf absl_flags absl_flags_parse absl_status absl_strings"
+cxxflags=${HARNESS_CXXFLAGS-$(pkg-config --cflags $pkgs)}
+libs=${HARNESS_LIBS-$(pkg-config --libs $pkgs)}
+# shellcheck disable=SC2086  # the flag lists are meant to be split
+"${CXX:-c++}" -std=c++17 -O2 -I"$work" -I"$harness_dir" $cxxflags \
+  "$cpp_dir/main_compiled.cpp" "$cpp_dir/alloc_stats.cpp" "$cpp_dir/bench.cpp" \
+  "$cpp_dir/compare.cpp" "$cpp_dir/fd_input.cpp" "$cpp_dir/fd_output.cpp" \
+  "$cpp_dir/phase_stats.cpp" "$work/registry.cc" "$work"/*.pb.cc \
+  -o "$output" $libs
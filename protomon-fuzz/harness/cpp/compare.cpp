@@ -0,0 +1,84 @@
+#include "cpp/compare.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/util/message_differencer.h"
+
+namespace harness {
+namespace {
+
+using google::protobuf::util::MessageDifferencer;
+
+// Forwards the first `limit` differences to a StreamReporter and counts the
+// rest.
+class BoundedReporter : public MessageDifferencer::Reporter {
+ public:
+  BoundedReporter(MessageDifferencer::StreamReporter* stream, int limit)
+      : stream_(stream), limit_(limit) {}
+
+  void ReportAdded(const google::protobuf::Message& message1,
+                   const google::protobuf::Message& message2,
+                   const std::vector<MessageDifferencer::SpecificField>& field_path) override {
+    if (Take()) stream_->ReportAdded(message1, message2, field_path);
+  }
+
+  void ReportDeleted(const google::protobuf::Message& message1,
+                     const google::protobuf::Message& message2,
+                     const std::vector<MessageDifferencer::SpecificField>& field_path) override {
+    if (Take()) stream_->ReportDeleted(message1, message2, field_path);
+  }
+
+  void ReportModified(const google::protobuf::Message& message1,
+                      const google::protobuf::Message& message2,
+                      const std::vector<MessageDifferencer::SpecificField>& field_path) override {
+    if (Take()) stream_->ReportModified(message1, message2, field_path);
+  }
+
+  int total() const { return total_; }
+
+ private:
+  bool Take() { return total_++ < limit_; }
+
+  MessageDifferencer::StreamReporter* stream_;
+  int limit_;
+  int total_ = 0;
+};
+
+}  // namespace
+
+absl::Status CheckRoundtrip(const google::protobuf::Message& original,
+                            const google::protobuf::Message& reparsed, absl::string_view serialized,
+                            int max_differences) {
+  // Fast path: reparsing lost nothing if it reserializes to the same bytes.
+  std::string reserialized;
+  if (reparsed.SerializeToString(&reserialized) && reserialized == serialized) {
+    return absl::OkStatus();
+  }
+
+  std::string report;
+  bool equal;
+  int total;
+  {
+    google::protobuf::io::StringOutputStream output(&report);
+    MessageDifferencer::StreamReporter stream(&output);
+    stream.SetMessages(original, reparsed);
+    BoundedReporter reporter(&stream, max_differences);
+
+    MessageDifferencer differencer;
+    differencer.ReportDifferencesTo(&reporter);
+    equal = differencer.Compare(original, reparsed);
+    total = reporter.total();
+  }
+  if (equal) return absl::OkStatus();
+
+  if (total > max_differences) {
+    absl::StrAppend(&report, "... and ", total - max_differences, " more\n");
+  }
+  return absl::InternalError(
+      absl::StrCat("Roundtrip mismatch (", total, " differences):\n", report));
+}
+
+}  // namespace harness
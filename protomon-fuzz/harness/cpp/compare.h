@@ -0,0 +1,31 @@
+// Roundtrip equality checking shared by the C++ harnesses.
+//
+// The common case is that a reparsed message reserializes to exactly the
+// bytes it was parsed from, so that is checked first with a plain byte
+// comparison. Only when the bytes differ (map ordering, for instance) does
+// the reflection-based MessageDifferencer run, and a mismatch report lists
+// just the first few differing field paths, so huge inputs don't produce
+// huge logs.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_COMPARE_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_COMPARE_H_
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/message.h"
+
+namespace harness {
+
+// Differing field paths listed in a mismatch report.
+constexpr int kMaxReportedDifferences = 10;
+
+// Checks that `reparsed`, parsed from `serialized`, equals `original`.
+// Returns an InternalError naming at most `max_differences` differing field
+// paths if it does not.
+absl::Status CheckRoundtrip(const google::protobuf::Message& original,
+                            const google::protobuf::Message& reparsed, absl::string_view serialized,
+                            int max_differences = kMaxReportedDifferences);
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_COMPARE_H_
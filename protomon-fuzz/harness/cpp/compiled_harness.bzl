@@ -0,0 +1,65 @@
+"""Compiled harnesses for arbitrary proto_library targets.
+
+compiled_harness builds main_compiled.cpp against a generated registry of
+every message type in `protos`, so benchmarking or fuzzing a fixed schema
+uses generated-code parsing instead of DynamicMessage reflection:
+
+    compiled_harness(
+        name = "harness_compiled_conformance",
+        protos = ["@protomon_conformance//:scalars_proto"],
+        cc_protos = ["@protomon_conformance//:scalars_cc_proto"],
+    )
+"""
+
+load("@protobuf//bazel/common:proto_info.bzl", "ProtoInfo")
+
+def _compiled_registry_impl(ctx):
+    # Only the targets' own files are registered, not their imports.
+    descriptor_sets = [proto[ProtoInfo].direct_descriptor_set for proto in ctx.attr.protos]
+    out = ctx.actions.declare_file(ctx.label.name + ".cc")
+
+    args = ctx.actions.args()
+    args.add_joined("--descriptor_sets", descriptor_sets, join_with = ",")
+    args.add("--out", out)
+    ctx.actions.run(
+        executable = ctx.executable._generator,
+        arguments = [args],
+        inputs = descriptor_sets,
+        outputs = [out],
+        mnemonic = "CompiledRegistry",
+        progress_message = "Generating compiled harness registry %{label}",
+    )
+    return [DefaultInfo(files = depset([out]))]
+
+compiled_registry = rule(
+    implementation = _compiled_registry_impl,
+    doc = "Generates the kCompiledMessages table (compiled_registry.h) for `protos`.",
+    attrs = {
+        "protos": attr.label_list(mandatory = True, providers = [ProtoInfo]),
+        "_generator": attr.label(
+            default = Label("//cpp:registry_gen"),
+            executable = True,
+            cfg = "exec",
+        ),
+    },
+)
+
+def compiled_harness(name, protos, cc_protos, **kwargs):
+    """A harness_compiled binary covering every message in `protos`.
+
+    Args:
+      name: Name of the cc_binary.
+      protos: proto_library targets whose messages are registered.
+      cc_protos: The matching cc_proto_library targets.
+      **kwargs: Passed to the cc_binary.
+    """
+    compiled_registry(
+        name = name + "_registry",
+        protos = protos,
+    )
+    native.cc_binary(
+        name = name,
+        srcs = [":" + name + "_registry"],
+        deps = [Label("//cpp:compiled_main")] + cc_protos,
+        **kwargs
+    )
@@ -0,0 +1,452 @@
+// Harness modes over a generated message class T, shared by every compiled
+// harness.
+//
+// RunWithMessage<T> runs one --mode against stdin and stdout the way
+// main_compiled.cpp documents. A compiled harness instantiates it once per
+// message type in its generated registry (see compiled_registry.h and
+// compiled_harness.bzl), so each type gets generated-code parsing and
+// serialization instead of DynamicMessage reflection.
+//
+// The flags below are defined in main_compiled.cpp.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_COMPILED_MODES_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_COMPILED_MODES_H_
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "cpp/alloc_stats.h"
+#include "cpp/bench.h"
+#include "cpp/compare.h"
+#include "cpp/fd_input.h"
+#include "cpp/fd_output.h"
+#include "cpp/phase_stats.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/util/delimited_message_util.h"
+
+ABSL_DECLARE_FLAG(bool, arena);
+ABSL_DECLARE_FLAG(size_t, arena_block_size);
+ABSL_DECLARE_FLAG(bool, alloc_stats);
+ABSL_DECLARE_FLAG(std::string, corpus);
+ABSL_DECLARE_FLAG(int, warmup_iterations);
+ABSL_DECLARE_FLAG(int, iterations);
+
+namespace harness {
+namespace compiled {
+
+// A new T, allocated on `arena` if one is given and otherwise owned on the heap.
+template <typename T>
+class ScopedMessage {
+ public:
+  explicit ScopedMessage(google::protobuf::Arena* arena)
+      : message_(google::protobuf::Arena::Create<T>(arena)),
+        owned_(arena == nullptr ? message_ : nullptr) {}
+
+  T* get() const { return message_; }
+  T* operator->() const { return message_; }
+  T& operator*() const { return *message_; }
+
+ private:
+  T* message_;
+  std::unique_ptr<T> owned_;
+};
+
+// Writes a request's result to stdout in one write(2), timed as the write
+// phase. Reports the error and returns false on failure.
+inline bool WriteOutput(absl::string_view output) {
+  ScopedPhase phase(Phase::kWrite);
+  if (WriteAll(STDOUT_FILENO, output.data(), output.size())) return true;
+  std::cerr << "Error writing output: " << strerror(errno) << std::endl;
+  return false;
+}
+
+template <typename T>
+int Encode(google::protobuf::io::ZeroCopyInputStream* text_input, google::protobuf::Arena* arena) {
+  ScopedMessage<T> message(arena);
+  if (!ParseText(text_input, message.get())) {
+    std::cerr << "Failed to parse text format input" << std::endl;
+    return 1;
+  }
+  RecordFieldSizes(*message);
+
+  std::string binary_output;
+  if (!Serialize(*message, /*deterministic=*/false, &binary_output)) {
+    std::cerr << "Failed to serialize message" << std::endl;
+    return 1;
+  }
+
+  if (!WriteOutput(binary_output)) return 1;
+  return 0;
+}
+
+template <typename T>
+int Decode(google::protobuf::io::ZeroCopyInputStream* binary_input,
+           google::protobuf::Arena* arena) {
+  ScopedMessage<T> message(arena);
+  if (!ParseBinary(binary_input, message.get())) {
+    std::cerr << "Failed to parse binary input" << std::endl;
+    return 1;
+  }
+  RecordFieldSizes(*message);
+
+  std::string text_output;
+  if (!PrintText(*message, &text_output)) {
+    std::cerr << "Failed to print text format" << std::endl;
+    return 1;
+  }
+
+  if (!WriteOutput(text_output)) return 1;
+  return 0;
+}
+
+template <typename T>
+int Roundtrip(google::protobuf::io::ZeroCopyInputStream* text_input,
+              google::protobuf::Arena* arena) {
+  ScopedMessage<T> message1(arena);
+  if (!ParseText(text_input, message1.get())) {
+    std::cerr << "Failed to parse text format input" << std::endl;
+    return 1;
+  }
+  RecordFieldSizes(*message1);
+
+  std::string binary;
+  if (!Serialize(*message1, /*deterministic=*/false, &binary)) {
+    std::cerr << "Failed to serialize message" << std::endl;
+    return 1;
+  }
+
+  ScopedMessage<T> message2(arena);
+  if (!ParseBinary(binary, message2.get())) {
+    std::cerr << "Failed to parse binary" << std::endl;
+    return 1;
+  }
+
+  absl::Status equal;
+  {
+    ScopedPhase phase(Phase::kCompare);
+    equal = CheckRoundtrip(*message1, *message2, binary);
+  }
+  if (!equal.ok()) {
+    std::cerr << equal.message() << std::endl;
+    return 1;
+  }
+
+  if (!WriteOutput(binary)) return 1;
+  std::cerr << "Roundtrip OK (" << binary.size() << " bytes)" << std::endl;
+  return 0;
+}
+
+template <typename T>
+int BinaryRoundtrip(google::protobuf::io::ZeroCopyInputStream* binary_input,
+                    google::protobuf::Arena* arena) {
+  std::string buffer;
+  absl::string_view input = ReadAll(binary_input, &buffer);
+
+  ScopedMessage<T> message(arena);
+  if (!ParseBinary(input, message.get())) {
+    std::cerr << "Failed to parse binary input" << std::endl;
+    return 1;
+  }
+  RecordFieldSizes(*message);
+
+  std::string canonical;
+  if (!Serialize(*message, /*deterministic=*/true, &canonical)) {
+    std::cerr << "Failed to serialize message" << std::endl;
+    return 1;
+  }
+
+  bool matches;
+  {
+    ScopedPhase phase(Phase::kCompare);
+    matches = canonical == input;
+  }
+  if (!WriteOutput(canonical)) return 1;
+  std::cerr << "Binary roundtrip: canonical encoding (" << canonical.size() << " bytes) "
+            << (matches ? "matches" : "differs from") << " input" << std::endl;
+  return 0;
+}
+
+// Decodes varint-length-delimited binary records, printing each one as a line
+// of single-line text format. Only one record is held in memory at a time.
+template <typename T>
+int DecodeStream(google::protobuf::io::ZeroCopyInputStream* binary_input,
+                 google::protobuf::Arena* arena) {
+  google::protobuf::TextFormat::Printer printer;
+  printer.SetSingleLineMode(true);
+
+  std::string line;
+  uint64_t records = 0;
+  while (true) {
+    ScopedMessage<T> message(arena);
+    bool clean_eof = false;
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(message.get(), binary_input,
+                                                                  &clean_eof)) {
+      if (clean_eof) break;
+      std::cerr << "Failed to parse record " << records << std::endl;
+      return 1;
+    }
+
+    line.clear();
+    if (!printer.PrintToString(*message, &line)) {
+      std::cerr << "Failed to print record " << records << std::endl;
+      return 1;
+    }
+    // Single-line mode leaves a space after the last field.
+    if (!line.empty() && line.back() == ' ') line.pop_back();
+    line.push_back('\n');
+    if (!WriteAll(STDOUT_FILENO, line.data(), line.size())) {
+      std::cerr << "Failed to write record " << records << ": " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    records++;
+    if (arena != nullptr) arena->Reset();
+  }
+
+  std::cerr << "Decoded " << records << " records" << std::endl;
+  return 0;
+}
+
+// Encodes one text format message per input line as a varint-length-delimited
+// binary record. The inverse of DecodeStream.
+template <typename T>
+int EncodeStream(google::protobuf::io::ZeroCopyInputStream* text_input,
+                 google::protobuf::Arena* arena) {
+  std::string line;
+  std::string record;
+  uint64_t records = 0;
+  while (ReadLine(text_input, &line)) {
+    ScopedMessage<T> message(arena);
+    if (!google::protobuf::TextFormat::ParseFromString(line, message.get())) {
+      std::cerr << "Failed to parse record " << records << std::endl;
+      return 1;
+    }
+
+    record.clear();
+    {
+      google::protobuf::io::StringOutputStream output(&record);
+      if (!google::protobuf::util::SerializeDelimitedToZeroCopyStream(*message, &output)) {
+        std::cerr << "Failed to serialize record " << records << std::endl;
+        return 1;
+      }
+    }
+    if (!WriteAll(STDOUT_FILENO, record.data(), record.size())) {
+      std::cerr << "Failed to write record " << records << ": " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    records++;
+    if (arena != nullptr) arena->Reset();
+  }
+
+  std::cerr << "Encoded " << records << " records" << std::endl;
+  return 0;
+}
+
+// Loads a corpus of serialized T and times parsing, serializing, and both,
+// once per message, printing one JSON result line per operation.
+template <typename T>
+int Bench(google::protobuf::io::ZeroCopyInputStream* input, google::protobuf::Arena* arena) {
+  std::vector<std::string> corpus;
+  std::string error;
+  std::string corpus_path = absl::GetFlag(FLAGS_corpus);
+  bool loaded = corpus_path.empty() ? LoadDelimitedCorpus(input, &corpus, &error)
+                                    : LoadCorpus(corpus_path, &corpus, &error);
+  if (!loaded) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  if (corpus.empty()) {
+    std::cerr << "Benchmark corpus is empty" << std::endl;
+    return 1;
+  }
+
+  // Messages kept parsed for the serialize benchmark, on the heap so that
+  // resetting the arena doesn't free them.
+  std::vector<std::unique_ptr<T>> parsed;
+  uint64_t input_bytes = 0;
+  uint64_t output_bytes = 0;
+  for (size_t i = 0; i < corpus.size(); i++) {
+    auto message = std::make_unique<T>();
+    if (!message->ParseFromString(corpus[i])) {
+      std::cerr << "Failed to parse corpus message " << i << std::endl;
+      return 1;
+    }
+    input_bytes += corpus[i].size();
+    output_bytes += message->ByteSizeLong();
+    parsed.push_back(std::move(message));
+  }
+
+  int warmup = absl::GetFlag(FLAGS_warmup_iterations);
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  const std::string& name = T::descriptor()->full_name();
+  std::string buffer;
+
+  BenchResult parse =
+      RunBench(corpus.size(), input_bytes, warmup, iterations, [&](size_t i) {
+        {
+          ScopedMessage<T> message(arena);
+          message->ParseFromString(corpus[i]);
+        }
+        if (arena != nullptr) arena->Reset();
+      });
+  PrintBenchResult(name, "parse", &parse);
+
+  BenchResult serialize = RunBench(corpus.size(), output_bytes, warmup, iterations,
+                                  [&](size_t i) { parsed[i]->SerializeToString(&buffer); });
+  PrintBenchResult(name, "serialize", &serialize);
+
+  BenchResult roundtrip =
+      RunBench(corpus.size(), input_bytes, warmup, iterations, [&](size_t i) {
+        {
+          ScopedMessage<T> message(arena);
+          message->ParseFromString(corpus[i]);
+          message->SerializeToString(&buffer);
+        }
+        if (arena != nullptr) arena->Reset();
+      });
+  PrintBenchResult(name, "parse_serialize", &roundtrip);
+
+  return 0;
+}
+
+// Loads a corpus of serialized T and parses each message once, printing one
+// JSON line per message with the bytes the parsed message holds
+// (SpaceUsedLong), the heap it allocated while parsing and, with --arena, the
+// arena space it used. A final line totals the corpus. Every parsed message
+// owns copies of its strings and repeated fields, so these are the numbers to
+// set against protomon's retained heap plus the input buffer it keeps alive.
+template <typename T>
+int Memprofile(google::protobuf::io::ZeroCopyInputStream* input,
+               google::protobuf::Arena* arena) {
+  std::vector<std::string> corpus;
+  std::string error;
+  std::string corpus_path = absl::GetFlag(FLAGS_corpus);
+  bool loaded = corpus_path.empty() ? LoadDelimitedCorpus(input, &corpus, &error)
+                                    : LoadCorpus(corpus_path, &corpus, &error);
+  if (!loaded) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  const std::string& name = T::descriptor()->full_name();
+  uint64_t total_wire = 0;
+  uint64_t total_space = 0;
+  AllocStats total_heap;
+  for (size_t i = 0; i < corpus.size(); i++) {
+    AllocStats before = CurrentAllocStats();
+    ScopedMessage<T> message(arena);
+    if (!message->ParseFromString(corpus[i])) {
+      std::cerr << "Failed to parse corpus message " << i << std::endl;
+      return 1;
+    }
+    AllocStats heap = CurrentAllocStats() - before;
+    uint64_t space = message->SpaceUsedLong();
+
+    std::cout << "{\"message\":\"" << name << "\",\"index\":" << i
+              << ",\"wire_bytes\":" << corpus[i].size() << ",\"space_used\":" << space
+              << ",\"heap_allocations\":" << heap.allocations << ",\"heap_bytes\":" << heap.bytes;
+    if (arena != nullptr) std::cout << ",\"arena_space_used\":" << arena->SpaceUsed();
+    std::cout << "}\n";
+
+    total_wire += corpus[i].size();
+    total_space += space;
+    total_heap.allocations += heap.allocations;
+    total_heap.bytes += heap.bytes;
+    if (arena != nullptr) arena->Reset();
+  }
+
+  std::cout << "{\"message\":\"" << name << "\",\"op\":\"memprofile\",\"messages\":"
+            << corpus.size() << ",\"wire_bytes\":" << total_wire
+            << ",\"space_used\":" << total_space
+            << ",\"heap_allocations\":" << total_heap.allocations
+            << ",\"heap_bytes\":" << total_heap.bytes << "}" << std::endl;
+  return 0;
+}
+
+template <typename T>
+int RunWithArena(const std::string& mode, google::protobuf::io::ZeroCopyInputStream* input,
+                 google::protobuf::Arena* arena) {
+  if (mode == "encode") {
+    return Encode<T>(input, arena);
+  } else if (mode == "decode") {
+    return Decode<T>(input, arena);
+  } else if (mode == "roundtrip") {
+    return Roundtrip<T>(input, arena);
+  } else if (mode == "binary_roundtrip") {
+    return BinaryRoundtrip<T>(input, arena);
+  } else if (mode == "decode_stream") {
+    return DecodeStream<T>(input, arena);
+  } else if (mode == "encode_stream") {
+    return EncodeStream<T>(input, arena);
+  } else if (mode == "bench") {
+    return Bench<T>(input, arena);
+  } else if (mode == "memprofile") {
+    return Memprofile<T>(input, arena);
+  } else {
+    std::cerr << "Unknown mode: " << mode << std::endl;
+    return 1;
+  }
+}
+
+// Runs `mode` on stdin as a T, writing the result to stdout. Returns the
+// process exit code.
+template <typename T>
+int RunWithMessage(const std::string& mode) {
+  std::unique_ptr<char[]> initial_block;
+  std::unique_ptr<google::protobuf::Arena> arena;
+  if (absl::GetFlag(FLAGS_arena)) {
+    google::protobuf::ArenaOptions options;
+    options.start_block_size = absl::GetFlag(FLAGS_arena_block_size);
+    options.initial_block_size = options.start_block_size;
+    initial_block.reset(new char[options.initial_block_size]);
+    options.initial_block = initial_block.get();
+    arena = std::make_unique<google::protobuf::Arena>(options);
+  }
+
+  // Build the lazily-initialized descriptors and reflection up front so their
+  // one-time cost isn't attributed to the request.
+  {
+    ScopedPhase phase(Phase::kPrototype);
+    T::descriptor();
+    T::default_instance().GetReflection();
+  }
+
+  // Parse straight from stdin (mmapped when it is a file), without a copy.
+  FdInput input(STDIN_FILENO);
+
+  AllocStats before = CurrentAllocStats();
+  int result = RunWithArena<T>(mode, input.stream(), arena.get());
+  CurrentStats().requests++;
+  if (absl::GetFlag(FLAGS_alloc_stats)) {
+    ReportAllocStats(CurrentAllocStats() - before, arena.get());
+  }
+
+  if (input.read_errno() != 0) {
+    std::cerr << "Error reading from file descriptor: " << strerror(input.read_errno())
+              << std::endl;
+    return 1;
+  }
+  if (StatsEnabled()) {
+    std::cerr << StatsToJson(CurrentStats()) << std::endl;
+  }
+  return result;
+}
+
+}  // namespace compiled
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_COMPILED_MODES_H_
@@ -0,0 +1,28 @@
+// The message types a compiled harness was built with.
+//
+// main_compiled.cpp looks --message up here. The table itself is generated
+// by registry_gen for the proto_library targets given to the
+// compiled_harness macro (compiled_harness.bzl): one entry per message in
+// those files, nested messages included and map entries excluded, each
+// pointing at compiled::RunWithMessage<T> for its generated class.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_COMPILED_REGISTRY_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_COMPILED_REGISTRY_H_
+
+#include <cstddef>
+#include <string>
+
+namespace harness {
+
+struct CompiledMessage {
+  const char* full_name;  // e.g. "conformance.Outer.Inner"
+  int (*run)(const std::string& mode);
+};
+
+// Defined by the generated registry, sorted by full name.
+extern const CompiledMessage kCompiledMessages[];
+extern const size_t kNumCompiledMessages;
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_COMPILED_REGISTRY_H_
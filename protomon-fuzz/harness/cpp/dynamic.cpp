@@ -0,0 +1,208 @@
+#include "cpp/dynamic.h"
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "cpp/compare.h"
+#include "cpp/fd_input.h"
+#include "cpp/phase_stats.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+namespace harness {
+
+absl::StatusOr<std::string> Encode(const google::protobuf::Message& prototype,
+                                   google::protobuf::io::ZeroCopyInputStream* text_input,
+                                   google::protobuf::Arena* arena) {
+  ScopedMessage message(prototype, arena);
+
+  // Parse text format
+  if (!ParseText(text_input, message.get())) {
+    return absl::InvalidArgumentError("Failed to parse text format input");
+  }
+  RecordFieldSizes(*message);
+
+  // Serialize to binary
+  std::string binary_output;
+  if (!Serialize(*message, /*deterministic=*/false, &binary_output)) {
+    return absl::InternalError("Failed to serialize message");
+  }
+
+  return binary_output;
+}
+
+absl::StatusOr<std::string> Decode(const google::protobuf::Message& prototype,
+                                   google::protobuf::io::ZeroCopyInputStream* binary_input,
+                                   google::protobuf::Arena* arena) {
+  ScopedMessage message(prototype, arena);
+
+  // Parse binary format
+  if (!ParseBinary(binary_input, message.get())) {
+    return absl::InvalidArgumentError("Failed to parse binary input");
+  }
+  RecordFieldSizes(*message);
+
+  // Print as text format
+  std::string text_output;
+  if (!PrintText(*message, &text_output)) {
+    return absl::InternalError("Failed to print text format");
+  }
+
+  return text_output;
+}
+
+absl::StatusOr<std::string> Roundtrip(const google::protobuf::Message& prototype,
+                                      google::protobuf::io::ZeroCopyInputStream* text_input,
+                                      google::protobuf::Arena* arena) {
+  ScopedMessage message1(prototype, arena);
+  ScopedMessage message2(prototype, arena);
+
+  // Parse text format
+  if (!ParseText(text_input, message1.get())) {
+    return absl::InvalidArgumentError("Failed to parse text format input");
+  }
+  RecordFieldSizes(*message1);
+
+  // Serialize to binary
+  std::string binary;
+  if (!Serialize(*message1, /*deterministic=*/false, &binary)) {
+    return absl::InternalError("Failed to serialize message");
+  }
+
+  // Parse binary back
+  if (!ParseBinary(binary, message2.get())) {
+    return absl::InternalError("Failed to parse binary");
+  }
+
+  ScopedPhase phase(Phase::kCompare);
+  absl::Status equal = CheckRoundtrip(*message1, *message2, binary);
+  if (!equal.ok()) return equal;
+
+  return binary;
+}
+
+absl::StatusOr<std::string> Reencode(const google::protobuf::Message& prototype,
+                                     google::protobuf::io::ZeroCopyInputStream* binary_input,
+                                     google::protobuf::Arena* arena) {
+  ScopedMessage message(prototype, arena);
+
+  if (!ParseBinary(binary_input, message.get())) {
+    return absl::InvalidArgumentError("Failed to parse binary input");
+  }
+  RecordFieldSizes(*message);
+
+  std::string binary_output;
+  if (!Serialize(*message, /*deterministic=*/false, &binary_output)) {
+    return absl::InternalError("Failed to serialize message");
+  }
+
+  return binary_output;
+}
+
+absl::StatusOr<std::string> BinaryRoundtrip(
+    const google::protobuf::Message& prototype,
+    google::protobuf::io::ZeroCopyInputStream* binary_input, google::protobuf::Arena* arena) {
+  std::string buffer;
+  absl::string_view input = ReadAll(binary_input, &buffer);
+
+  ScopedMessage message(prototype, arena);
+  if (!ParseBinary(input, message.get())) {
+    return absl::InvalidArgumentError("Failed to parse binary input");
+  }
+  RecordFieldSizes(*message);
+
+  // Reserve the verdict byte; Serialize appends after it.
+  std::string output(1, kCanonicalDiffers);
+  if (!Serialize(*message, /*deterministic=*/true, &output)) {
+    return absl::InternalError("Failed to serialize message");
+  }
+
+  ScopedPhase phase(Phase::kCompare);
+  if (absl::string_view(output).substr(1) == input) output[0] = kCanonicalIdentical;
+  return output;
+}
+
+ModeFn FindMode(absl::string_view mode) {
+  if (mode == "encode") return Encode;
+  if (mode == "decode") return Decode;
+  if (mode == "roundtrip") return Roundtrip;
+  if (mode == "reencode") return Reencode;
+  if (mode == "binary_roundtrip") return BinaryRoundtrip;
+  return nullptr;
+}
+
+void StringErrorCollector::RecordError(absl::string_view filename, int line, int column,
+                                       absl::string_view message) {
+  absl::StrAppend(&errors_, filename, ":", line, ":", column, ": ", message, "\n");
+}
+
+RequestSourceTree::RequestSourceTree(std::string text, const std::string& proto_path)
+    : text_(std::move(text)) {
+  imports_.MapPath("", proto_path);
+}
+
+google::protobuf::io::ZeroCopyInputStream* RequestSourceTree::Open(absl::string_view filename) {
+  if (filename == kRequestSchemaFile) {
+    return new google::protobuf::io::ArrayInputStream(text_.data(),
+                                                      static_cast<int>(text_.size()));
+  }
+  return imports_.Open(filename);
+}
+
+absl::StatusOr<std::unique_ptr<Schema>> Schema::Import(
+    std::unique_ptr<google::protobuf::compiler::SourceTree> source_tree, const std::string& file) {
+  std::unique_ptr<Schema> schema(new Schema(std::move(source_tree)));
+  if (schema->importer_.Import(file) == nullptr) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Failed to import schema:\n", schema->errors_.errors()));
+  }
+  return schema;
+}
+
+absl::StatusOr<const google::protobuf::Message*> Schema::FindPrototype(
+    const std::string& message_name) {
+  auto it = prototypes_.find(message_name);
+  if (it != prototypes_.end()) return it->second;
+
+  ScopedPhase phase(Phase::kPrototype);
+  const google::protobuf::Descriptor* descriptor =
+      importer_.pool()->FindMessageTypeByName(message_name);
+  if (descriptor == nullptr) {
+    return absl::NotFoundError(absl::StrCat("Message not found: ", message_name));
+  }
+
+  const google::protobuf::Message* prototype = factory_.GetPrototype(descriptor);
+  if (prototype == nullptr) {
+    return absl::InternalError("Failed to get prototype for message type");
+  }
+
+  prototypes_.emplace(message_name, prototype);
+  return prototype;
+}
+
+absl::StatusOr<Schema*> SchemaCache::Get(const std::string& text) {
+  auto it = index_.find(text);
+  if (it != index_.end()) {
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second.get();
+  }
+
+  misses_++;
+  ScopedPhase phase(Phase::kImport);
+  absl::StatusOr<std::unique_ptr<Schema>> schema =
+      Schema::Import(std::make_unique<RequestSourceTree>(text, proto_path_),
+                     std::string(RequestSourceTree::kRequestSchemaFile));
+  if (!schema.ok()) return schema.status();
+
+  while (lru_.size() >= capacity_) {
+    index_.erase(lru_.back().first);
+    lru_.pop_back();
+    evictions_++;
+  }
+
+  lru_.emplace_front(text, *std::move(schema));
+  index_.emplace(text, lru_.begin());
+  return lru_.front().second.get();
+}
+
+}  // namespace harness
@@ -0,0 +1,164 @@
+// Dynamic-message core of the C++ harness: the encode/decode/roundtrip modes
+// and schemas imported at runtime.
+//
+// Shared by the `harness` binary and the in-process C ABI oracle (oracle.h),
+// so both check messages with exactly the same code.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_DYNAMIC_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_DYNAMIC_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/compiler/importer.h"
+#include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+
+namespace harness {
+
+// A new instance of a prototype, allocated on `arena` if one is given and
+// otherwise owned on the heap.
+class ScopedMessage {
+ public:
+  ScopedMessage(const google::protobuf::Message& prototype, google::protobuf::Arena* arena)
+      : message_(prototype.New(arena)), owned_(arena == nullptr ? message_ : nullptr) {}
+
+  google::protobuf::Message* get() const { return message_; }
+  google::protobuf::Message* operator->() const { return message_; }
+  google::protobuf::Message& operator*() const { return *message_; }
+
+ private:
+  google::protobuf::Message* message_;
+  std::unique_ptr<google::protobuf::Message> owned_;
+};
+
+// Parses text format input and returns the binary encoding.
+absl::StatusOr<std::string> Encode(const google::protobuf::Message& prototype,
+                                   google::protobuf::io::ZeroCopyInputStream* text_input,
+                                   google::protobuf::Arena* arena);
+
+// Parses binary input and returns it printed as text format.
+absl::StatusOr<std::string> Decode(const google::protobuf::Message& prototype,
+                                   google::protobuf::io::ZeroCopyInputStream* binary_input,
+                                   google::protobuf::Arena* arena);
+
+// Encodes text format input, decodes the result again, and checks that both
+// messages are equal. Returns the intermediate binary encoding.
+absl::StatusOr<std::string> Roundtrip(const google::protobuf::Message& prototype,
+                                      google::protobuf::io::ZeroCopyInputStream* text_input,
+                                      google::protobuf::Arena* arena);
+
+// Parses binary input and serializes it again, giving C++'s canonical
+// encoding of whatever it accepted. The binary-only mode for fuzz inputs.
+absl::StatusOr<std::string> Reencode(const google::protobuf::Message& prototype,
+                                     google::protobuf::io::ZeroCopyInputStream* binary_input,
+                                     google::protobuf::Arena* arena);
+
+// First byte of BinaryRoundtrip's output.
+constexpr char kCanonicalDiffers = 0;
+constexpr char kCanonicalIdentical = 1;
+
+// Parses binary input and reserializes it deterministically. The output is a
+// verdict byte, kCanonicalIdentical if the canonical bytes equal the input
+// and kCanonicalDiffers otherwise, followed by the canonical bytes. Never
+// touches text format.
+absl::StatusOr<std::string> BinaryRoundtrip(
+    const google::protobuf::Message& prototype,
+    google::protobuf::io::ZeroCopyInputStream* binary_input, google::protobuf::Arena* arena);
+
+// Runs one mode over one input. Messages are allocated on the arena if it is
+// non-null.
+using ModeFn = absl::StatusOr<std::string> (*)(const google::protobuf::Message&,
+                                               google::protobuf::io::ZeroCopyInputStream*,
+                                               google::protobuf::Arena*);
+
+// Returns the handler for a single-message mode, or nullptr if unknown.
+ModeFn FindMode(absl::string_view mode);
+
+// Error collector that records errors into a string, for serve responses.
+class StringErrorCollector : public google::protobuf::compiler::MultiFileErrorCollector {
+ public:
+  void RecordError(absl::string_view filename, int line, int column,
+                   absl::string_view message) override;
+
+  const std::string& errors() const { return errors_; }
+
+ private:
+  std::string errors_;
+};
+
+// Source tree that serves schema text received in a request as
+// `kRequestSchemaFile`, and resolves its imports from `proto_path`.
+class RequestSourceTree : public google::protobuf::compiler::SourceTree {
+ public:
+  static constexpr absl::string_view kRequestSchemaFile = "request.proto";
+
+  RequestSourceTree(std::string text, const std::string& proto_path);
+
+  google::protobuf::io::ZeroCopyInputStream* Open(absl::string_view filename) override;
+
+ private:
+  std::string text_;
+  google::protobuf::compiler::DiskSourceTree imports_;
+};
+
+// An imported schema with its own descriptor pool and message factory.
+class Schema {
+ public:
+  // Imports `file` from `source_tree`. Import errors are returned in the status.
+  static absl::StatusOr<std::unique_ptr<Schema>> Import(
+      std::unique_ptr<google::protobuf::compiler::SourceTree> source_tree,
+      const std::string& file);
+
+  // Returns the prototype for `message_name`, caching the lookup.
+  absl::StatusOr<const google::protobuf::Message*> FindPrototype(const std::string& message_name);
+
+ private:
+  explicit Schema(std::unique_ptr<google::protobuf::compiler::SourceTree> source_tree)
+      : source_tree_(std::move(source_tree)), importer_(source_tree_.get(), &errors_) {}
+
+  std::unique_ptr<google::protobuf::compiler::SourceTree> source_tree_;
+  StringErrorCollector errors_;
+  google::protobuf::compiler::Importer importer_;
+  google::protobuf::DynamicMessageFactory factory_;
+  absl::flat_hash_map<std::string, const google::protobuf::Message*> prototypes_;
+};
+
+// LRU cache of schemas compiled from request text, keyed by the text itself,
+// so a repeated schema skips the Importer entirely.
+class SchemaCache {
+ public:
+  // `capacity` must be at least 1.
+  SchemaCache(size_t capacity, std::string proto_path)
+      : capacity_(capacity), proto_path_(std::move(proto_path)) {}
+
+  // Returns the schema compiled from `text`, importing it on a miss.
+  absl::StatusOr<Schema*> Get(const std::string& text);
+
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+  uint64_t evictions() const { return evictions_; }
+
+ private:
+  using Entry = std::pair<std::string, std::unique_ptr<Schema>>;
+
+  size_t capacity_;
+  std::string proto_path_;
+  std::list<Entry> lru_;  // Most recently used first
+  absl::flat_hash_map<std::string, std::list<Entry>::iterator> index_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_DYNAMIC_H_
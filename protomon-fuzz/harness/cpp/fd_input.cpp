@@ -0,0 +1,95 @@
+#include "cpp/fd_input.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstring>
+
+namespace harness {
+namespace {
+
+// Larger than FileInputStream's 8 KiB default to cut read() calls on pipes.
+constexpr int kStreamBlockSize = 64 * 1024;
+
+}  // namespace
+
+FdInput::FdInput(int fd) {
+  struct stat st;
+  // The input starts at the descriptor's current offset, which is not 0 when
+  // the caller has already read or seeked into the file.
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  // ArrayInputStream takes an int size; larger files are streamed instead.
+  if (offset >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > offset &&
+      st.st_size - offset <= INT_MAX) {
+    // mmap offsets must be page aligned; map from the page holding `offset`.
+    off_t page = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+    off_t map_offset = offset - offset % page;
+    size_t size = static_cast<size_t>(st.st_size - map_offset);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, map_offset);
+    if (mapping != MAP_FAILED) {
+      madvise(mapping, size, MADV_SEQUENTIAL);
+      mapping_ = mapping;
+      mapping_size_ = size;
+      array_stream_ = std::make_unique<google::protobuf::io::ArrayInputStream>(
+          static_cast<const char*>(mapping_) + (offset - map_offset),
+          static_cast<int>(st.st_size - offset));
+      return;
+    }
+  }
+
+  file_stream_ = std::make_unique<google::protobuf::io::FileInputStream>(fd, kStreamBlockSize);
+}
+
+FdInput::~FdInput() {
+  array_stream_.reset();
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+}
+
+google::protobuf::io::ZeroCopyInputStream* FdInput::stream() {
+  if (array_stream_ != nullptr) return array_stream_.get();
+  return file_stream_.get();
+}
+
+int FdInput::read_errno() const {
+  return file_stream_ != nullptr ? file_stream_->GetErrno() : 0;
+}
+
+bool ReadLine(google::protobuf::io::ZeroCopyInputStream* input, std::string* line) {
+  line->clear();
+  bool found = false;
+  const void* data;
+  int size;
+  while (input->Next(&data, &size)) {
+    found = true;
+    const char* begin = static_cast<const char*>(data);
+    const char* newline = static_cast<const char*>(memchr(begin, '\n', size));
+    if (newline != nullptr) {
+      line->append(begin, newline);
+      input->BackUp(size - static_cast<int>(newline - begin) - 1);
+      return true;
+    }
+    line->append(begin, size);
+  }
+  return found;
+}
+
+absl::string_view ReadAll(google::protobuf::io::ZeroCopyInputStream* input, std::string* buffer) {
+  const void* data;
+  int size;
+  if (!input->Next(&data, &size)) return absl::string_view();
+  absl::string_view first(static_cast<const char*>(data), size);
+
+  const void* next;
+  int next_size;
+  if (!input->Next(&next, &next_size)) return first;
+
+  buffer->assign(first.data(), first.size());
+  do {
+    buffer->append(static_cast<const char*>(next), next_size);
+  } while (input->Next(&next, &next_size));
+  return *buffer;
+}
+
+}  // namespace harness
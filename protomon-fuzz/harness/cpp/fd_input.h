@@ -0,0 +1,60 @@
+// Zero-copy access to a harness's input file descriptor.
+//
+// Regular files (`harness < capture.bin`) are mmapped and exposed as a single
+// array; anything else (pipes, sockets) is read through a FileInputStream.
+// Neither path copies the input into an intermediate std::string, and neither
+// caps the input size.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_FD_INPUT_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_FD_INPUT_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+namespace harness {
+
+class FdInput {
+ public:
+  // Does not take ownership of `fd`. The input is the rest of `fd` from its
+  // current offset.
+  explicit FdInput(int fd);
+  ~FdInput();
+
+  FdInput(const FdInput&) = delete;
+  FdInput& operator=(const FdInput&) = delete;
+
+  // Stream over the whole input. Parse with ParseFromZeroCopyStream or
+  // TextFormat::Parse.
+  google::protobuf::io::ZeroCopyInputStream* stream();
+
+  // The errno of the first failed read, or 0. Check after a failed parse to
+  // tell I/O errors from malformed input.
+  int read_errno() const;
+
+ private:
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  std::unique_ptr<google::protobuf::io::ArrayInputStream> array_stream_;
+  std::unique_ptr<google::protobuf::io::FileInputStream> file_stream_;
+};
+
+// Reads the next '\n'-terminated line from `input` into `line`, without the
+// terminator. A final line without one is returned too. Unread data is backed
+// up into the stream, so it can be interleaved with other parsers. Returns
+// false at end of input.
+bool ReadLine(google::protobuf::io::ZeroCopyInputStream* input, std::string* line);
+
+// Returns the rest of `input`. An input that arrives in a single chunk (an
+// mmapped file or an array) is returned in place; otherwise its chunks are
+// copied into `buffer`, which backs the result.
+absl::string_view ReadAll(google::protobuf::io::ZeroCopyInputStream* input, std::string* buffer);
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_FD_INPUT_H_
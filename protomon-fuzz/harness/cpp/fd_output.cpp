@@ -0,0 +1,20 @@
+#include "cpp/fd_output.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace harness {
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  size_t offset = 0;
+  while (offset < size) {
+    ssize_t n = write(fd, data + offset, size - offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    offset += n;
+  }
+  return true;
+}
+
+}  // namespace harness
@@ -0,0 +1,21 @@
+// Unbuffered output to a harness's output file descriptor.
+//
+// A harness builds each result in memory (sized up front from ByteSizeLong,
+// see Serialize in phase_stats.h) and hands it to the kernel in one write(2),
+// bypassing iostreams entirely. WriteAll only loops to finish a partial write
+// on a pipe or socket.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_FD_OUTPUT_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_FD_OUTPUT_H_
+
+#include <cstddef>
+
+namespace harness {
+
+// Writes all `size` bytes of `data` to `fd`, retrying on EINTR. Returns false
+// with errno set on error.
+bool WriteAll(int fd, const char* data, size_t size);
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_FD_OUTPUT_H_
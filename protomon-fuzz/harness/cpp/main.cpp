@@ -12,14 +12,73 @@
 //
 //   # Roundtrip test (encode then decode, compare):
 //   ./harness --mode=roundtrip --proto=schema.proto --message=package.MessageName < input.textproto
+//
+//   # Re-serialize binary input in C++'s canonical encoding:
+//   ./harness --mode=reencode --proto=schema.proto --message=package.MessageName < input.bin > output.bin
+//
+//   # Binary-only roundtrip: reserialize deterministically, write the
+//   # canonical bytes, and report on stderr whether they equal the input:
+//   ./harness --mode=binary_roundtrip --proto=schema.proto --message=package.MessageName < input.bin > canonical.bin
+//
+//   # Stream many messages, one varint-length-delimited binary record per
+//   # single-line text format message, in constant memory:
+//   ./harness --mode=decode_stream --proto=schema.proto --message=package.MessageName < records.bin
+//   ./harness --mode=encode_stream --proto=schema.proto --message=package.MessageName < records.txt
+//
+//   # Any mode can allocate messages on a reusable arena and report the heap
+//   # allocations each request made:
+//   ./harness --mode=decode ... --arena --alloc_stats < input.bin
+//
+//   # Time each phase (import, prototype, parse, serialize, compare, print,
+//   # write) and print the totals as one JSON line on stderr at exit;
+//   # --stats_field_sizes adds the serialized bytes per field type:
+//   ./harness --mode=decode ... --stats=json [--stats_field_sizes] < input.bin
+//
+//   # Persistent server, reusing imported schemas across requests:
+//   ./harness --mode=serve [--proto=schema.proto] [--socket=/tmp/harness.sock]
+//
+// Serve protocol:
+//   Requests are read from stdin (or from each connection to --socket) and
+//   responses are written back in order. Every field is a 4-byte
+//   little-endian length followed by that many bytes.
+//
+//     request:  mode ("encode", "decode", "roundtrip", "reencode" or
+//               "binary_roundtrip"), schema, message name, payload
+//     response: 1-byte status (0 = OK, 1 = error), then the output bytes or
+//               the error message
+//
+//   A binary_roundtrip response body is a verdict byte (1 if the canonical
+//   encoding equals the payload, 0 if not) followed by the canonical bytes.
+//
+//   The schema field holds .proto source text; leave it empty to use the
+//   --proto schema. Compiled schemas are kept in an LRU cache keyed by their
+//   text (at most --schema_cache_entries), so resending a schema is cheap.
+//
+//   Batch modes ("encode_batch", "decode_batch", ...) run the base mode
+//   over many inputs in one exchange. Their payload is a sequence of items,
+//   each a message name field and an input field; an empty item message
+//   name means the request's message. The response body is one
+//   response per item, in order, so a bad input only fails its own item.
+//
+//   A "stats" request (schema, message and payload ignored) returns the
+//   --stats totals so far as JSON.
+//
+//   The server exits when the input reaches end-of-file between requests.
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <csignal>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -29,25 +88,58 @@
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "cpp/alloc_stats.h"
+#include "cpp/dynamic.h"
+#include "cpp/fd_input.h"
+#include "cpp/fd_output.h"
+#include "cpp/phase_stats.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/compiler/importer.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/dynamic_message.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/text_format.h"
-#include "google/protobuf/util/message_differencer.h"
+#include "google/protobuf/util/delimited_message_util.h"
 
 ABSL_FLAG(std::string, mode, "encode",
-          "Mode: 'encode' (text->binary), 'decode' (binary->text), or 'roundtrip'");
+          "Mode: 'encode' (text->binary), 'decode' (binary->text), 'roundtrip', "
+          "'reencode' (binary->binary), 'binary_roundtrip', 'encode_stream', 'decode_stream', "
+          "or 'serve'");
 ABSL_FLAG(std::string, proto, "", "Path to .proto file");
 ABSL_FLAG(std::string, message, "", "Fully qualified message name (e.g., package.MessageName)");
 ABSL_FLAG(std::string, proto_path, ".", "Proto import path");
+ABSL_FLAG(std::string, socket, "",
+          "Unix socket path to listen on in 'serve' mode (default: stdin/stdout)");
+ABSL_FLAG(int, schema_cache_entries, 64,
+          "Maximum number of request schemas kept compiled in 'serve' mode");
+ABSL_FLAG(bool, arena, false,
+          "Allocate messages on a google::protobuf::Arena that is reset between requests");
+ABSL_FLAG(size_t, arena_block_size, 1 << 20,
+          "Size of the arena block that is kept and reused across requests");
+ABSL_FLAG(bool, alloc_stats, false,
+          "Print heap allocations and arena usage for each request to stderr");
+ABSL_FLAG(std::string, stats, "",
+          "Set to 'json' to time each request phase and print the totals to stderr at exit");
+ABSL_FLAG(bool, stats_field_sizes, false,
+          "With --stats, also break serialized bytes down by field type");
 
 namespace {
 
-constexpr size_t kReadBufferSize = 4096;
+// Cap on a single serve request field. One-shot modes stream stdin instead
+// and have no limit.
 constexpr size_t kMaxInputSize = 100 * 1024 * 1024;  // 100MB
 
+constexpr char kStatusOk = 0;
+constexpr char kStatusError = 1;
+
+// A serve mode with this suffix runs the base mode over a batch of items.
+constexpr absl::string_view kBatchSuffix = "_batch";
+
 // Simple error collector that prints to stderr
 class ErrorCollector : public google::protobuf::compiler::MultiFileErrorCollector {
  public:
@@ -63,139 +155,445 @@ class ErrorCollector : public google::protobuf::compiler::MultiFileErrorCollecto
   }
 };
 
-std::string ReadAllFromFd(int fd) {
-  std::string result;
-  result.reserve(8192);  // Pre-allocate reasonable size
+// Creates the request arena if --arena is set. Its first block is kept across
+// Reset(), so requests that fit in it never touch the heap for messages.
+std::unique_ptr<google::protobuf::Arena> MaybeCreateArena(std::unique_ptr<char[]>* initial_block) {
+  if (!absl::GetFlag(FLAGS_arena)) return nullptr;
+
+  google::protobuf::ArenaOptions options;
+  options.start_block_size = absl::GetFlag(FLAGS_arena_block_size);
+  options.initial_block_size = options.start_block_size;
+  initial_block->reset(new char[options.initial_block_size]);
+  options.initial_block = initial_block->get();
+  return std::make_unique<google::protobuf::Arena>(options);
+}
 
-  char buffer[kReadBufferSize];
-  ssize_t bytes_read;
+// Runs one mode over all of stdin, writing the result to stdout. The input is
+// parsed straight from stdin (mmapped when it is a file), without a copy.
+int RunOnce(absl::string_view mode, harness::ModeFn fn,
+            const google::protobuf::Message& prototype) {
+  harness::FdInput input(STDIN_FILENO);
 
-  while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
-    result.append(buffer, bytes_read);
+  std::unique_ptr<char[]> initial_block;
+  std::unique_ptr<google::protobuf::Arena> arena = MaybeCreateArena(&initial_block);
 
-    if (result.size() > kMaxInputSize) {
-      std::cerr << "Error: input exceeds maximum size of "
-                << kMaxInputSize << " bytes" << std::endl;
-      exit(1);
+  harness::AllocStats before = harness::CurrentAllocStats();
+  absl::StatusOr<std::string> output = fn(prototype, input.stream(), arena.get());
+  harness::CurrentStats().requests++;
+  if (absl::GetFlag(FLAGS_alloc_stats)) {
+    harness::ReportAllocStats(harness::CurrentAllocStats() - before, arena.get());
+  }
+
+  if (input.read_errno() != 0) {
+    std::cerr << "Error reading from file descriptor: " << strerror(input.read_errno())
+              << std::endl;
+    return 1;
+  }
+  if (!output.ok()) {
+    std::cerr << output.status().message() << std::endl;
+    return 1;
+  }
+
+  // binary_roundtrip's verdict byte goes to stderr, not stdout.
+  absl::string_view result = *output;
+  if (mode == "binary_roundtrip") result.remove_prefix(1);
+
+  bool written;
+  {
+    harness::ScopedPhase phase(harness::Phase::kWrite);
+    written = harness::WriteAll(STDOUT_FILENO, result.data(), result.size());
+  }
+  if (!written) {
+    std::cerr << "Error writing output: " << strerror(errno) << std::endl;
+    return 1;
+  }
+
+  if (mode == "binary_roundtrip") {
+    std::cerr << "Binary roundtrip: canonical encoding (" << result.size() << " bytes) "
+              << ((*output)[0] == harness::kCanonicalIdentical ? "matches" : "differs from")
+              << " input" << std::endl;
+  } else if (mode == "roundtrip") {
+    std::cerr << "Roundtrip OK (" << output->size() << " bytes)" << std::endl;
+  }
+  return 0;
+}
+
+// Reads exactly `size` bytes. Returns false on EOF or error; `errno` is left
+// at 0 for a clean EOF before the first byte.
+bool ReadExact(int fd, char* data, size_t size) {
+  size_t offset = 0;
+  while (offset < size) {
+    ssize_t n = read(fd, data + offset, size - offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n == 0) errno = offset == 0 ? 0 : EPIPE;
+    if (n <= 0) return false;
+    offset += n;
+  }
+  return true;
+}
+
+// Decodes varint-length-delimited binary records from `input`, printing each
+// one as a line of single-line text format. Each line is written out as soon
+// as its record is decoded, and only one record is held in memory at a time.
+int DecodeStream(const google::protobuf::Message& prototype,
+                 google::protobuf::io::ZeroCopyInputStream* input, google::protobuf::Arena* arena) {
+  google::protobuf::TextFormat::Printer printer;
+  printer.SetSingleLineMode(true);
+
+  std::string line;
+  uint64_t records = 0;
+  while (true) {
+    harness::ScopedMessage message(prototype, arena);
+    bool clean_eof = false;
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(message.get(), input,
+                                                                  &clean_eof)) {
+      if (clean_eof) break;
+      std::cerr << "Failed to parse record " << records << std::endl;
+      return 1;
+    }
+
+    line.clear();
+    if (!printer.PrintToString(*message, &line)) {
+      std::cerr << "Failed to print record " << records << std::endl;
+      return 1;
     }
+    // Single-line mode leaves a space after the last field.
+    if (!line.empty() && line.back() == ' ') line.pop_back();
+    line.push_back('\n');
+    if (!harness::WriteAll(STDOUT_FILENO, line.data(), line.size())) {
+      std::cerr << "Failed to write record " << records << ": " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    records++;
+    if (arena != nullptr) arena->Reset();
   }
 
-  if (bytes_read < 0) {
-    std::cerr << "Error reading from file descriptor: "
-              << strerror(errno) << std::endl;
-    exit(1);
+  std::cerr << "Decoded " << records << " records" << std::endl;
+  return 0;
+}
+
+// Encodes one text format message per input line, writing each as a
+// varint-length-delimited binary record. The inverse of DecodeStream.
+int EncodeStream(const google::protobuf::Message& prototype,
+                 google::protobuf::io::ZeroCopyInputStream* input, google::protobuf::Arena* arena) {
+  std::string line;
+  std::string record;
+  uint64_t records = 0;
+  while (harness::ReadLine(input, &line)) {
+    harness::ScopedMessage message(prototype, arena);
+    if (!google::protobuf::TextFormat::ParseFromString(line, message.get())) {
+      std::cerr << "Failed to parse record " << records << std::endl;
+      return 1;
+    }
+
+    record.clear();
+    {
+      google::protobuf::io::StringOutputStream output(&record);
+      if (!google::protobuf::util::SerializeDelimitedToZeroCopyStream(*message, &output)) {
+        std::cerr << "Failed to serialize record " << records << std::endl;
+        return 1;
+      }
+    }
+    if (!harness::WriteAll(STDOUT_FILENO, record.data(), record.size())) {
+      std::cerr << "Failed to write record " << records << ": " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    records++;
+    if (arena != nullptr) arena->Reset();
   }
 
-  return result;
+  std::cerr << "Encoded " << records << " records" << std::endl;
+  return 0;
 }
 
-int Encode(const google::protobuf::Descriptor* descriptor,
-           google::protobuf::DynamicMessageFactory* factory) {
-  // Read text format from stdin
-  std::string text_input = ReadAllFromFd(STDIN_FILENO);
+// Runs a stream mode over all of stdin.
+int RunStream(absl::string_view mode, const google::protobuf::Message& prototype) {
+  harness::FdInput input(STDIN_FILENO);
 
-  // Create a message instance
-  const google::protobuf::Message* prototype = factory->GetPrototype(descriptor);
-  if (prototype == nullptr) {
-    std::cerr << "Failed to get prototype for message type" << std::endl;
+  std::unique_ptr<char[]> initial_block;
+  std::unique_ptr<google::protobuf::Arena> arena = MaybeCreateArena(&initial_block);
+
+  int result = mode == "decode_stream" ? DecodeStream(prototype, input.stream(), arena.get())
+                                       : EncodeStream(prototype, input.stream(), arena.get());
+  if (input.read_errno() != 0) {
+    std::cerr << "Error reading from file descriptor: " << strerror(input.read_errno())
+              << std::endl;
     return 1;
   }
-  std::unique_ptr<google::protobuf::Message> message(prototype->New());
+  return result;
+}
 
-  // Parse text format
-  if (!google::protobuf::TextFormat::ParseFromString(text_input, message.get())) {
-    std::cerr << "Failed to parse text format input" << std::endl;
-    return 1;
+uint32_t DecodeFieldSize(const unsigned char header[4]) {
+  return static_cast<uint32_t>(header[0]) | (static_cast<uint32_t>(header[1]) << 8) |
+         (static_cast<uint32_t>(header[2]) << 16) | (static_cast<uint32_t>(header[3]) << 24);
+}
+
+// Writes the 5-byte response header: status, then the little-endian body size.
+void EncodeResponseHeader(char status, uint32_t size, char header[5]) {
+  header[0] = status;
+  for (int i = 0; i < 4; i++) header[i + 1] = static_cast<char>((size >> (8 * i)) & 0xff);
+}
+
+// Reads one length-prefixed field of a serve request into `out`.
+bool ReadField(int fd, std::string* out) {
+  unsigned char header[4];
+  if (!ReadExact(fd, reinterpret_cast<char*>(header), sizeof(header))) return false;
+
+  uint32_t size = DecodeFieldSize(header);
+  if (size > kMaxInputSize) {
+    std::cerr << "Error: request field exceeds maximum size of " << kMaxInputSize << " bytes"
+              << std::endl;
+    errno = EMSGSIZE;
+    return false;
   }
 
-  // Serialize to binary and write to stdout
-  std::string binary_output;
-  if (!message->SerializeToString(&binary_output)) {
-    std::cerr << "Failed to serialize message" << std::endl;
-    return 1;
+  out->resize(size);
+  if (size == 0) return true;
+  if (!ReadExact(fd, out->data(), size)) {
+    if (errno == 0) errno = EPIPE;
+    return false;
   }
+  return true;
+}
 
-  // Write binary to stdout
-  std::cout.write(binary_output.data(), binary_output.size());
-  return 0;
+// Writes one serve response: a status byte followed by a length-prefixed body.
+bool WriteResponse(int fd, char status, absl::string_view body) {
+  char header[5];
+  EncodeResponseHeader(status, static_cast<uint32_t>(body.size()), header);
+
+  // Issue header and body as a single syscall; finish any partial write.
+  iovec iov[2] = {{header, sizeof(header)},
+                  {const_cast<char*>(body.data()), body.size()}};
+  ssize_t n;
+  do {
+    n = writev(fd, iov, 2);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) return false;
+
+  size_t written = static_cast<size_t>(n);
+  if (written < sizeof(header)) {
+    return harness::WriteAll(fd, header + written, sizeof(header) - written) &&
+           harness::WriteAll(fd, body.data(), body.size());
+  }
+  written -= sizeof(header);
+  return harness::WriteAll(fd, body.data() + written, body.size() - written);
 }
 
-int Decode(const google::protobuf::Descriptor* descriptor,
-           google::protobuf::DynamicMessageFactory* factory) {
-  // Read binary from stdin
-  std::string binary_input = ReadAllFromFd(STDIN_FILENO);
+// State shared by every serve connection.
+struct ServeContext {
+  harness::Schema* default_schema;  // From --proto, or nullptr
+  harness::SchemaCache* cache;
+  google::protobuf::Arena* arena;  // Reset after every request, or nullptr
+};
 
-  // Create a message instance
-  const google::protobuf::Message* prototype = factory->GetPrototype(descriptor);
-  if (prototype == nullptr) {
-    std::cerr << "Failed to get prototype for message type" << std::endl;
-    return 1;
+// Returns the request's schema: compiled from `schema_text`, or the --proto
+// schema if the text is empty.
+absl::StatusOr<harness::Schema*> FindSchema(const std::string& schema_text,
+                                            ServeContext* context) {
+  if (!schema_text.empty()) return context->cache->Get(schema_text);
+  if (context->default_schema == nullptr) {
+    return absl::InvalidArgumentError("Request has no schema and --proto was not given");
   }
-  std::unique_ptr<google::protobuf::Message> message(prototype->New());
+  return context->default_schema;
+}
 
-  // Parse binary format
-  if (!message->ParseFromString(binary_input)) {
-    std::cerr << "Failed to parse binary input" << std::endl;
-    return 1;
+// Runs `fn` over one input of a request.
+absl::StatusOr<std::string> RunRequest(harness::ModeFn fn,
+                                       const google::protobuf::Message& prototype,
+                                       absl::string_view payload, ServeContext* context) {
+  google::protobuf::io::ArrayInputStream input(payload.data(), static_cast<int>(payload.size()));
+  harness::AllocStats before = harness::CurrentAllocStats();
+  absl::StatusOr<std::string> output = fn(prototype, &input, context->arena);
+  if (absl::GetFlag(FLAGS_alloc_stats)) {
+    harness::ReportAllocStats(harness::CurrentAllocStats() - before, context->arena);
   }
+  return output;
+}
 
-  // Print as text format
-  std::string text_output;
-  if (!google::protobuf::TextFormat::PrintToString(*message, &text_output)) {
-    std::cerr << "Failed to print text format" << std::endl;
-    return 1;
+// Splits one length-prefixed field off the front of `data`.
+bool ConsumeField(absl::string_view* data, absl::string_view* field) {
+  if (data->size() < 4) return false;
+  uint32_t size = DecodeFieldSize(reinterpret_cast<const unsigned char*>(data->data()));
+  if (data->size() - 4 < size) return false;
+  *field = data->substr(4, size);
+  data->remove_prefix(4 + size);
+  return true;
+}
+
+// Runs `fn` over every item of a batch payload, appending one response per
+// item to the returned body. The arena is reset after each item.
+absl::StatusOr<std::string> HandleBatch(harness::ModeFn fn, harness::Schema* schema,
+                                        const std::string& message_name,
+                                        absl::string_view payload, ServeContext* context) {
+  std::string body;
+  std::string item_message;
+  for (size_t item = 0; !payload.empty(); item++) {
+    absl::string_view name;
+    absl::string_view input;
+    if (!ConsumeField(&payload, &name) || !ConsumeField(&payload, &input)) {
+      return absl::InvalidArgumentError(absl::StrCat("Malformed batch item ", item));
+    }
+    if (name.empty()) {
+      item_message = message_name;
+    } else {
+      item_message.assign(name.data(), name.size());
+    }
+
+    absl::StatusOr<const google::protobuf::Message*> prototype =
+        schema->FindPrototype(item_message);
+    absl::StatusOr<std::string> output =
+        prototype.ok() ? RunRequest(fn, **prototype, input, context) : prototype.status();
+    if (context->arena != nullptr) context->arena->Reset();
+
+    absl::string_view result = output.ok() ? *output : output.status().message();
+    char header[5];
+    EncodeResponseHeader(output.ok() ? kStatusOk : kStatusError,
+                         static_cast<uint32_t>(result.size()), header);
+    body.append(header, sizeof(header));
+    body.append(result.data(), result.size());
   }
+  return body;
+}
 
-  std::cout << text_output;
-  return 0;
+// Handles one serve request.
+absl::StatusOr<std::string> HandleRequest(const std::string& mode, const std::string& schema_text,
+                                          const std::string& message_name,
+                                          const std::string& payload, ServeContext* context) {
+  if (mode == "stats") return harness::StatsToJson(harness::CurrentStats());
+
+  absl::string_view base_mode = mode;
+  bool batch = absl::ConsumeSuffix(&base_mode, kBatchSuffix);
+  harness::ModeFn fn = harness::FindMode(base_mode);
+  if (fn == nullptr) {
+    return absl::InvalidArgumentError(absl::StrCat("Unknown mode: ", mode));
+  }
+
+  absl::StatusOr<harness::Schema*> schema = FindSchema(schema_text, context);
+  if (!schema.ok()) return schema.status();
+
+  if (batch) return HandleBatch(fn, *schema, message_name, payload, context);
+
+  absl::StatusOr<const google::protobuf::Message*> prototype =
+      (*schema)->FindPrototype(message_name);
+  if (!prototype.ok()) return prototype.status();
+  return RunRequest(fn, **prototype, payload, context);
 }
 
-int Roundtrip(const google::protobuf::Descriptor* descriptor,
-              google::protobuf::DynamicMessageFactory* factory) {
-  // Read text format from stdin
-  std::string text_input = ReadAllFromFd(STDIN_FILENO);
+// Serves requests from `in_fd` until EOF, writing responses to `out_fd`.
+// Returns false if the connection failed mid-request.
+bool ServeConnection(int in_fd, int out_fd, ServeContext* context) {
+  // Reused across requests to avoid reallocating for every payload.
+  std::string mode;
+  std::string schema_text;
+  std::string message_name;
+  std::string payload;
+
+  while (true) {
+    if (!ReadField(in_fd, &mode)) {
+      if (errno == 0) return true;  // Clean EOF between requests
+      std::cerr << "Error reading request: " << strerror(errno) << std::endl;
+      return false;
+    }
+    if (!ReadField(in_fd, &schema_text) || !ReadField(in_fd, &message_name) ||
+        !ReadField(in_fd, &payload)) {
+      std::cerr << "Error reading request: " << strerror(errno == 0 ? EPIPE : errno)
+                << std::endl;
+      return false;
+    }
 
-  // Create message instances
-  const google::protobuf::Message* prototype = factory->GetPrototype(descriptor);
-  if (prototype == nullptr) {
-    std::cerr << "Failed to get prototype for message type" << std::endl;
-    return 1;
+    absl::StatusOr<std::string> output =
+        HandleRequest(mode, schema_text, message_name, payload, context);
+    if (mode != "stats") harness::CurrentStats().requests++;
+    bool written;
+    {
+      harness::ScopedPhase phase(harness::Phase::kWrite);
+      written = output.ok() ? WriteResponse(out_fd, kStatusOk, *output)
+                            : WriteResponse(out_fd, kStatusError, output.status().message());
+    }
+    if (context->arena != nullptr) context->arena->Reset();
+    if (!written) {
+      std::cerr << "Error writing response: " << strerror(errno) << std::endl;
+      return false;
+    }
   }
-  std::unique_ptr<google::protobuf::Message> message1(prototype->New());
-  std::unique_ptr<google::protobuf::Message> message2(prototype->New());
+}
 
-  // Parse text format
-  if (!google::protobuf::TextFormat::ParseFromString(text_input, message1.get())) {
-    std::cerr << "Failed to parse text format input" << std::endl;
+// Listens on a Unix socket and serves each connection in turn.
+int ServeSocket(const std::string& path, ServeContext* context) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Error: socket path too long: " << path << std::endl;
     return 1;
   }
+  memcpy(addr.sun_path, path.data(), path.size());
 
-  // Serialize to binary
-  std::string binary;
-  if (!message1->SerializeToString(&binary)) {
-    std::cerr << "Failed to serialize message" << std::endl;
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
     return 1;
   }
 
-  // Parse binary back
-  if (!message2->ParseFromString(binary)) {
-    std::cerr << "Failed to parse binary" << std::endl;
+  unlink(path.c_str());
+  if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(listen_fd, 16) < 0) {
+    std::cerr << "Failed to listen on " << path << ": " << strerror(errno) << std::endl;
+    close(listen_fd);
     return 1;
   }
 
-  // Compare using MessageDifferencer for canonical equality
-  if (!google::protobuf::util::MessageDifferencer::Equals(*message1, *message2)) {
-    std::cerr << "Roundtrip mismatch!" << std::endl;
-    std::cerr << "Original:\n" << message1->DebugString() << std::endl;
-    std::cerr << "After roundtrip:\n" << message2->DebugString() << std::endl;
-    return 1;
+  while (true) {
+    int conn_fd = accept(listen_fd, nullptr, nullptr);
+    if (conn_fd < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "Failed to accept connection: " << strerror(errno) << std::endl;
+      close(listen_fd);
+      return 1;
+    }
+    // A failed connection only affects that client; keep serving others.
+    ServeConnection(conn_fd, conn_fd, context);
+    close(conn_fd);
   }
+}
 
-  // Output the binary (for use by other tools)
-  std::cout.write(binary.data(), binary.size());
+int Serve(const std::string& proto_file, const std::string& proto_path) {
+  // A client hanging up must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  std::unique_ptr<harness::Schema> default_schema;
+  if (!proto_file.empty()) {
+    auto source_tree = std::make_unique<google::protobuf::compiler::DiskSourceTree>();
+    source_tree->MapPath("", proto_path);
+    harness::ScopedPhase phase(harness::Phase::kImport);
+    absl::StatusOr<std::unique_ptr<harness::Schema>> schema =
+        harness::Schema::Import(std::move(source_tree), proto_file);
+    if (!schema.ok()) {
+      std::cerr << schema.status().message() << std::endl;
+      return 1;
+    }
+    default_schema = *std::move(schema);
+  }
 
-  std::cerr << "Roundtrip OK (" << binary.size() << " bytes)" << std::endl;
-  return 0;
+  harness::SchemaCache cache(std::max(absl::GetFlag(FLAGS_schema_cache_entries), 1),
+                             proto_path);
+  std::unique_ptr<char[]> initial_block;
+  std::unique_ptr<google::protobuf::Arena> arena = MaybeCreateArena(&initial_block);
+  ServeContext context{default_schema.get(), &cache, arena.get()};
+
+  std::string socket_path = absl::GetFlag(FLAGS_socket);
+  if (!socket_path.empty()) {
+    return ServeSocket(socket_path, &context);
+  }
+  bool ok = ServeConnection(STDIN_FILENO, STDOUT_FILENO, &context);
+  std::cerr << "Schema cache: " << cache.hits() << " hits, " << cache.misses() << " misses, "
+            << cache.evictions() << " evictions" << std::endl;
+  if (harness::StatsEnabled()) {
+    std::cerr << harness::StatsToJson(harness::CurrentStats()) << std::endl;
+  }
+  return ok ? 0 : 1;
 }
 
 }  // namespace
@@ -208,12 +606,35 @@ int main(int argc, char* argv[]) {
 #endif
 
   absl::ParseCommandLine(argc, argv);
+  // Output goes straight to fd 1 with write(2); stderr doesn't need to stay
+  // in step with C stdio.
+  std::ios::sync_with_stdio(false);
 
   std::string mode = absl::GetFlag(FLAGS_mode);
   std::string proto_file = absl::GetFlag(FLAGS_proto);
   std::string message_name = absl::GetFlag(FLAGS_message);
   std::string proto_path = absl::GetFlag(FLAGS_proto_path);
 
+  std::string stats = absl::GetFlag(FLAGS_stats);
+  if (stats == "json") {
+    harness::EnableStats(absl::GetFlag(FLAGS_stats_field_sizes));
+  } else if (!stats.empty()) {
+    std::cerr << "Unknown --stats format: " << stats << " (expected 'json')" << std::endl;
+    return 1;
+  }
+
+  bool serve = mode == "serve";
+  bool stream = mode == "decode_stream" || mode == "encode_stream";
+  harness::ModeFn mode_fn = harness::FindMode(mode);
+  if (!serve && !stream && mode_fn == nullptr) {
+    std::cerr << "Unknown mode: " << mode << std::endl;
+    return 1;
+  }
+
+  if (serve) {
+    return Serve(proto_file, proto_path);
+  }
+
   if (proto_file.empty()) {
     std::cerr << "Error: --proto is required" << std::endl;
     return 1;
@@ -231,7 +652,11 @@ int main(int argc, char* argv[]) {
   google::protobuf::compiler::Importer importer(&source_tree, &error_collector);
 
   // Import the proto file
-  const google::protobuf::FileDescriptor* file_desc = importer.Import(proto_file);
+  const google::protobuf::FileDescriptor* file_desc;
+  {
+    harness::ScopedPhase phase(harness::Phase::kImport);
+    file_desc = importer.Import(proto_file);
+  }
   if (file_desc == nullptr) {
     std::cerr << "Failed to import proto file: " << proto_file << std::endl;
     return 1;
@@ -252,14 +677,19 @@ int main(int argc, char* argv[]) {
   // Create a dynamic message factory
   google::protobuf::DynamicMessageFactory factory;
 
-  if (mode == "encode") {
-    return Encode(descriptor, &factory);
-  } else if (mode == "decode") {
-    return Decode(descriptor, &factory);
-  } else if (mode == "roundtrip") {
-    return Roundtrip(descriptor, &factory);
-  } else {
-    std::cerr << "Unknown mode: " << mode << std::endl;
+  const google::protobuf::Message* prototype;
+  {
+    harness::ScopedPhase phase(harness::Phase::kPrototype);
+    prototype = factory.GetPrototype(descriptor);
+  }
+  if (prototype == nullptr) {
+    std::cerr << "Failed to get prototype for message type" << std::endl;
     return 1;
   }
+
+  int result = stream ? RunStream(mode, *prototype) : RunOnce(mode, mode_fn, *prototype);
+  if (harness::StatsEnabled()) {
+    std::cerr << harness::StatsToJson(harness::CurrentStats()) << std::endl;
+  }
+  return result;
 }
@@ -3,16 +3,47 @@
 // This is a simpler harness that works with compile-time generated proto code.
 // Use this when you have a fixed schema and want faster performance.
 //
+// The message types come from a generated registry (compiled_registry.h).
+// Build a harness for any set of proto_library targets with the
+// compiled_harness macro in compiled_harness.bzl; //cpp:harness_compiled
+// covers proto/test.proto and //cpp:harness_compiled_conformance the
+// protomon-conformance protos. The modes themselves live in compiled_modes.h.
+//
 // Usage:
 //   ./harness_compiled --mode=encode < input.textproto > output.bin
 //   ./harness_compiled --mode=decode < input.bin > output.textproto
 //   ./harness_compiled --mode=roundtrip < input.textproto > output.bin
+//
+//   # List the registered message types, by full name:
+//   ./harness_compiled --mode=list
+//   ./harness_compiled_conformance --message=conformance.Scalars --mode=decode < in.bin
+//
+//   # Reserialize binary input deterministically, without text format, and
+//   # report on stderr whether the canonical bytes equal the input:
+//   ./harness_compiled --mode=binary_roundtrip < input.bin > canonical.bin
+//
+//   # Varint-length-delimited binary records <-> one text message per line:
+//   ./harness_compiled --mode=decode_stream < records.bin > records.txt
+//   ./harness_compiled --mode=encode_stream < records.txt > records.bin
+//
+//   # Benchmark parse, serialize, and parse+serialize over a corpus, printing
+//   # one JSON line per operation with messages/s, MB/s and p50/p99/p999:
+//   ./harness_compiled --mode=bench --corpus=testdata/ [--iterations=10] [--arena]
+//   ./harness_compiled --mode=bench < records.bin
+//
+//   # Parse each corpus message once and print its SpaceUsedLong() and the
+//   # heap (or, with --arena, arena space) it took, one JSON line per message:
+//   ./harness_compiled --mode=memprofile --corpus=testdata/ [--arena]
+//   ./harness_compiled --mode=memprofile < records.bin
+//
+//   # Allocate messages on an arena and report heap allocations:
+//   ./harness_compiled --mode=decode --arena --alloc_stats < input.bin
+//
+//   # Print per-phase timings (and bytes per field type) as JSON on stderr:
+//   ./harness_compiled --mode=decode --stats=json [--stats_field_sizes] < input.bin
 
 #include <fcntl.h>
-#include <unistd.h>
 
-#include <cerrno>
-#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -22,133 +53,47 @@
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
-#include "google/protobuf/text_format.h"
-#include "google/protobuf/util/message_differencer.h"
-#include "proto/test.pb.h"
+#include "absl/strings/string_view.h"
+#include "cpp/compiled_registry.h"
+#include "cpp/phase_stats.h"
 
 ABSL_FLAG(std::string, mode, "encode",
-          "Mode: 'encode' (text->binary), 'decode' (binary->text), or 'roundtrip'");
+          "Mode: 'encode' (text->binary), 'decode' (binary->text), 'roundtrip', "
+          "'binary_roundtrip', 'encode_stream', 'decode_stream', 'bench', 'memprofile', "
+          "or 'list' (print the registered message types)");
 ABSL_FLAG(std::string, message, "TestMessage",
-          "Message type: 'TestMessage' or 'NestedExample'");
+          "Message type: a registered full name, or a short name only one of them has");
+ABSL_FLAG(bool, arena, false, "Allocate messages on a google::protobuf::Arena");
+ABSL_FLAG(size_t, arena_block_size, 1 << 20, "Size of the arena's initial block");
+ABSL_FLAG(bool, alloc_stats, false, "Print heap allocations and arena usage to stderr");
+ABSL_FLAG(std::string, corpus, "",
+          "Corpus for 'bench' and 'memprofile' modes: a directory of .bin files or a file of "
+          "delimited records (default: delimited records on stdin)");
+ABSL_FLAG(int, warmup_iterations, 3, "Untimed passes over the corpus in 'bench' mode");
+ABSL_FLAG(int, iterations, 10, "Timed passes over the corpus in 'bench' mode");
+ABSL_FLAG(std::string, stats, "",
+          "Set to 'json' to time each request phase and print the totals to stderr at exit");
+ABSL_FLAG(bool, stats_field_sizes, false,
+          "With --stats, also break serialized bytes down by field type");
 
 namespace {
 
-constexpr size_t kReadBufferSize = 4096;
-constexpr size_t kMaxInputSize = 100 * 1024 * 1024;  // 100MB
-
-std::string ReadAllFromFd(int fd) {
-  std::string result;
-  result.reserve(8192);  // Pre-allocate reasonable size
-
-  char buffer[kReadBufferSize];
-  ssize_t bytes_read;
-
-  while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
-    result.append(buffer, bytes_read);
-
-    if (result.size() > kMaxInputSize) {
-      std::cerr << "Error: input exceeds maximum size of "
-                << kMaxInputSize << " bytes" << std::endl;
-      exit(1);
+// Finds `name` in the registry: a full name, or a short name that only one
+// registered message has (e.g. "TestMessage" for "fuzztest.TestMessage").
+const harness::CompiledMessage* FindMessage(absl::string_view name) {
+  const harness::CompiledMessage* short_match = nullptr;
+  int short_matches = 0;
+  for (size_t i = 0; i < harness::kNumCompiledMessages; i++) {
+    const harness::CompiledMessage& entry = harness::kCompiledMessages[i];
+    absl::string_view full_name = entry.full_name;
+    if (full_name == name) return &entry;
+    size_t dot = full_name.rfind('.');
+    if (dot != absl::string_view::npos && full_name.substr(dot + 1) == name) {
+      short_match = &entry;
+      short_matches++;
     }
   }
-
-  if (bytes_read < 0) {
-    std::cerr << "Error reading from file descriptor: "
-              << strerror(errno) << std::endl;
-    exit(1);
-  }
-
-  return result;
-}
-
-template <typename T>
-int Encode() {
-  std::string text_input = ReadAllFromFd(STDIN_FILENO);
-
-  T message;
-  if (!google::protobuf::TextFormat::ParseFromString(text_input, &message)) {
-    std::cerr << "Failed to parse text format input" << std::endl;
-    return 1;
-  }
-
-  std::string binary_output;
-  if (!message.SerializeToString(&binary_output)) {
-    std::cerr << "Failed to serialize message" << std::endl;
-    return 1;
-  }
-
-  std::cout.write(binary_output.data(), binary_output.size());
-  return 0;
-}
-
-template <typename T>
-int Decode() {
-  std::string binary_input = ReadAllFromFd(STDIN_FILENO);
-
-  T message;
-  if (!message.ParseFromString(binary_input)) {
-    std::cerr << "Failed to parse binary input" << std::endl;
-    return 1;
-  }
-
-  std::string text_output;
-  if (!google::protobuf::TextFormat::PrintToString(message, &text_output)) {
-    std::cerr << "Failed to print text format" << std::endl;
-    return 1;
-  }
-
-  std::cout << text_output;
-  return 0;
-}
-
-template <typename T>
-int Roundtrip() {
-  std::string text_input = ReadAllFromFd(STDIN_FILENO);
-
-  T message1;
-  if (!google::protobuf::TextFormat::ParseFromString(text_input, &message1)) {
-    std::cerr << "Failed to parse text format input" << std::endl;
-    return 1;
-  }
-
-  std::string binary;
-  if (!message1.SerializeToString(&binary)) {
-    std::cerr << "Failed to serialize message" << std::endl;
-    return 1;
-  }
-
-  T message2;
-  if (!message2.ParseFromString(binary)) {
-    std::cerr << "Failed to parse binary" << std::endl;
-    return 1;
-  }
-
-  // Compare using MessageDifferencer for canonical equality
-  if (!google::protobuf::util::MessageDifferencer::Equals(message1, message2)) {
-    std::cerr << "Roundtrip mismatch!" << std::endl;
-    std::cerr << "Original:\n" << message1.DebugString() << std::endl;
-    std::cerr << "After roundtrip:\n" << message2.DebugString() << std::endl;
-    return 1;
-  }
-
-  std::cout.write(binary.data(), binary.size());
-  std::cerr << "Roundtrip OK (" << binary.size() << " bytes)" << std::endl;
-  return 0;
-}
-
-template <typename T>
-int RunWithMessage(const std::string& mode) {
-  if (mode == "encode") {
-    return Encode<T>();
-  } else if (mode == "decode") {
-    return Decode<T>();
-  } else if (mode == "roundtrip") {
-    return Roundtrip<T>();
-  } else {
-    std::cerr << "Unknown mode: " << mode << std::endl;
-    return 1;
-  }
+  return short_matches == 1 ? short_match : nullptr;
 }
 
 }  // namespace
@@ -161,17 +106,33 @@ int main(int argc, char* argv[]) {
 #endif
 
   absl::ParseCommandLine(argc, argv);
+  // Output goes straight to fd 1 with write(2); stderr doesn't need to stay
+  // in step with C stdio.
+  std::ios::sync_with_stdio(false);
 
   std::string mode = absl::GetFlag(FLAGS_mode);
   std::string message = absl::GetFlag(FLAGS_message);
 
-  if (message == "TestMessage") {
-    return RunWithMessage<fuzztest::TestMessage>(mode);
-  } else if (message == "NestedExample") {
-    return RunWithMessage<fuzztest::NestedExample>(mode);
-  } else {
-    std::cerr << "Unknown message type: " << message << std::endl;
-    std::cerr << "Available: TestMessage, NestedExample" << std::endl;
+  std::string stats = absl::GetFlag(FLAGS_stats);
+  if (stats == "json") {
+    harness::EnableStats(absl::GetFlag(FLAGS_stats_field_sizes));
+  } else if (!stats.empty()) {
+    std::cerr << "Unknown --stats format: " << stats << " (expected 'json')" << std::endl;
+    return 1;
+  }
+
+  if (mode == "list") {
+    for (size_t i = 0; i < harness::kNumCompiledMessages; i++) {
+      std::cout << harness::kCompiledMessages[i].full_name << "\n";
+    }
+    return 0;
+  }
+
+  const harness::CompiledMessage* entry = FindMessage(message);
+  if (entry == nullptr) {
+    std::cerr << "Unknown or ambiguous message type: " << message << std::endl;
+    std::cerr << "Run with --mode=list for the messages this harness was built with" << std::endl;
     return 1;
   }
+  return entry->run(mode);
 }
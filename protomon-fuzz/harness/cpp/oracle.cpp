@@ -0,0 +1,78 @@
+#include "cpp/oracle.h"
+
+#include <algorithm>
+#include <new>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "cpp/dynamic.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+struct protomon_oracle {
+  protomon_oracle(const char* proto_path, size_t schema_cache_entries)
+      : cache(std::max<size_t>(schema_cache_entries, 1),
+              proto_path != nullptr ? proto_path : ".") {}
+
+  harness::SchemaCache cache;
+  google::protobuf::Arena arena;
+  // The last call's result or error message, returned to the caller.
+  std::string output;
+};
+
+namespace {
+
+absl::StatusOr<std::string> Call(protomon_oracle* oracle, const char* mode,
+                                 const std::string& schema_text, const std::string& message_name,
+                                 const uint8_t* input, size_t input_len) {
+  harness::ModeFn fn = harness::FindMode(mode);
+  if (fn == nullptr) {
+    return absl::InvalidArgumentError(absl::StrCat("Unknown mode: ", mode));
+  }
+
+  absl::StatusOr<harness::Schema*> schema = oracle->cache.Get(schema_text);
+  if (!schema.ok()) return schema.status();
+
+  absl::StatusOr<const google::protobuf::Message*> prototype =
+      (*schema)->FindPrototype(message_name);
+  if (!prototype.ok()) return prototype.status();
+
+  google::protobuf::io::ArrayInputStream stream(input, static_cast<int>(input_len));
+  return fn(**prototype, &stream, &oracle->arena);
+}
+
+}  // namespace
+
+extern "C" {
+
+protomon_oracle* protomon_oracle_new(const char* proto_path, size_t schema_cache_entries) {
+  return new (std::nothrow) protomon_oracle(proto_path, schema_cache_entries);
+}
+
+void protomon_oracle_free(protomon_oracle* oracle) { delete oracle; }
+
+int protomon_oracle_call(protomon_oracle* oracle, const char* mode, const char* schema,
+                         size_t schema_len, const char* message, size_t message_len,
+                         const uint8_t* input, size_t input_len, const uint8_t** output,
+                         size_t* output_len) {
+  // Messages from the previous call are no longer referenced.
+  oracle->arena.Reset();
+
+  absl::StatusOr<std::string> result =
+      Call(oracle, mode, std::string(schema, schema_len), std::string(message, message_len),
+           input, input_len);
+  int status = PROTOMON_ORACLE_OK;
+  if (result.ok()) {
+    oracle->output = *std::move(result);
+  } else {
+    status = PROTOMON_ORACLE_ERROR;
+    oracle->output.assign(result.status().message().data(), result.status().message().size());
+  }
+
+  *output = reinterpret_cast<const uint8_t*>(oracle->output.data());
+  *output_len = oracle->output.size();
+  return status;
+}
+
+}  // extern "C"
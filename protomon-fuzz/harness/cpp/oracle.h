@@ -0,0 +1,50 @@
+// In-process C++ protobuf reference oracle with a C ABI.
+//
+// Exposes the dynamic harness's modes (see dynamic.h) as plain C calls, so
+// protomon-fuzz can check messages against C++ protobuf from inside a
+// libFuzzer target instead of spawning the `harness` binary per case. Link
+// //cpp:oracle_static, which bundles protobuf and abseil, and declare these
+// functions on the Rust side (src/oracle.rs).
+//
+// An oracle caches compiled schemas by their text, like the serve mode, and
+// allocates messages on an arena that is reset at the start of every call.
+// An oracle is not thread-safe; give each thread its own.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_ORACLE_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_ORACLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct protomon_oracle protomon_oracle;
+
+// Status codes returned by protomon_oracle_call.
+#define PROTOMON_ORACLE_OK 0
+#define PROTOMON_ORACLE_ERROR 1
+
+// Creates an oracle whose schemas resolve imports from `proto_path` (NULL
+// means the current directory) and which keeps up to `schema_cache_entries`
+// compiled schemas. Returns NULL if allocation fails.
+protomon_oracle* protomon_oracle_new(const char* proto_path, size_t schema_cache_entries);
+
+void protomon_oracle_free(protomon_oracle* oracle);
+
+// Runs `mode` ("encode", "decode", "roundtrip", "reencode" or
+// "binary_roundtrip") on `input` as message `message` of the .proto source
+// `schema`. On PROTOMON_ORACLE_OK, `*output` points at the result; on
+// PROTOMON_ORACLE_ERROR, at the error message. Either way the bytes are
+// owned by the oracle and stay valid until its next call.
+int protomon_oracle_call(protomon_oracle* oracle, const char* mode, const char* schema,
+                         size_t schema_len, const char* message, size_t message_len,
+                         const uint8_t* input, size_t input_len, const uint8_t** output,
+                         size_t* output_len);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_ORACLE_H_
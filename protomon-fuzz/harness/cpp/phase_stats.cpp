@@ -0,0 +1,145 @@
+#include "cpp/phase_stats.h"
+
+#include <climits>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/wire_format.h"
+
+namespace harness {
+namespace {
+
+// The harnesses are single-threaded, so plain globals are enough.
+bool g_enabled = false;
+bool g_field_sizes = false;
+PhaseStats g_stats;
+
+constexpr const char* kPhaseNames[kNumPhases] = {
+    "import",    "prototype", "text_parse", "binary_parse",
+    "serialize", "compare",   "text_print", "write",
+};
+
+// Adds the bytes of every field of `message` to `field_bytes`, recursing into
+// submessages so each byte is counted once, under the leaf field's type.
+void AddFieldSizes(const google::protobuf::Message& message,
+                   std::map<std::string, uint64_t>* field_bytes) {
+  const google::protobuf::Reflection* reflection = message.GetReflection();
+  std::vector<const google::protobuf::FieldDescriptor*> fields;
+  reflection->ListFields(message, &fields);
+
+  for (const google::protobuf::FieldDescriptor* field : fields) {
+    uint64_t size = google::protobuf::internal::WireFormat::FieldByteSize(field, message);
+    if (field->cpp_type() != google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+      (*field_bytes)[field->type_name()] += size;
+      continue;
+    }
+
+    uint64_t nested = 0;
+    if (field->is_repeated()) {
+      for (int i = 0; i < reflection->FieldSize(message, field); i++) {
+        const google::protobuf::Message& item = reflection->GetRepeatedMessage(message, field, i);
+        nested += item.ByteSizeLong();
+        AddFieldSizes(item, field_bytes);
+      }
+    } else {
+      const google::protobuf::Message& item = reflection->GetMessage(message, field);
+      nested += item.ByteSizeLong();
+      AddFieldSizes(item, field_bytes);
+    }
+    (*field_bytes)["message"] += size - nested;
+  }
+
+  uint64_t unknown = google::protobuf::internal::WireFormat::ComputeUnknownFieldsSize(
+      reflection->GetUnknownFields(message));
+  if (unknown > 0) (*field_bytes)["unknown"] += unknown;
+}
+
+}  // namespace
+
+void EnableStats(bool field_sizes) {
+  g_enabled = true;
+  g_field_sizes = field_sizes;
+}
+
+bool StatsEnabled() { return g_enabled; }
+
+PhaseStats& CurrentStats() { return g_stats; }
+
+ScopedPhase::ScopedPhase(Phase phase) : phase_(phase), enabled_(g_enabled) {
+  if (enabled_) start_ = std::chrono::steady_clock::now();
+}
+
+ScopedPhase::~ScopedPhase() {
+  if (!enabled_) return;
+  g_stats.phase_ns[static_cast<int>(phase_)] +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                           start_)
+          .count();
+}
+
+void RecordFieldSizes(const google::protobuf::Message& message) {
+  if (g_enabled && g_field_sizes) AddFieldSizes(message, &g_stats.field_bytes);
+}
+
+bool ParseText(google::protobuf::io::ZeroCopyInputStream* input,
+               google::protobuf::Message* message) {
+  ScopedPhase phase(Phase::kTextParse);
+  return google::protobuf::TextFormat::Parse(input, message);
+}
+
+bool ParseBinary(google::protobuf::io::ZeroCopyInputStream* input,
+                 google::protobuf::Message* message) {
+  ScopedPhase phase(Phase::kBinaryParse);
+  return message->ParseFromZeroCopyStream(input);
+}
+
+bool ParseBinary(absl::string_view input, google::protobuf::Message* message) {
+  ScopedPhase phase(Phase::kBinaryParse);
+  return message->ParseFromArray(input.data(), static_cast<int>(input.size()));
+}
+
+bool Serialize(const google::protobuf::Message& message, bool deterministic,
+               std::string* output) {
+  ScopedPhase phase(Phase::kSerialize);
+  if (!message.IsInitialized()) return false;
+  size_t size = message.ByteSizeLong();
+  if (size > INT_MAX) return false;
+
+  // Size the output once and serialize in place with the cached sizes.
+  size_t offset = output->size();
+  output->resize(offset + size);
+  uint8_t* target = reinterpret_cast<uint8_t*>(&(*output)[offset]);
+  if (!deterministic) {
+    message.SerializeWithCachedSizesToArray(target);
+    return true;
+  }
+
+  google::protobuf::io::ArrayOutputStream array(target, static_cast<int>(size));
+  google::protobuf::io::CodedOutputStream coded(&array);
+  coded.SetSerializationDeterministic(true);
+  message.SerializeWithCachedSizes(&coded);
+  return !coded.HadError();
+}
+
+bool PrintText(const google::protobuf::Message& message, std::string* output) {
+  ScopedPhase phase(Phase::kTextPrint);
+  return google::protobuf::TextFormat::PrintToString(message, output);
+}
+
+std::string StatsToJson(const PhaseStats& stats) {
+  std::string json = absl::StrCat("{\"requests\":", stats.requests);
+  for (int i = 0; i < kNumPhases; i++) {
+    absl::StrAppend(&json, ",\"", kPhaseNames[i], "_ns\":", stats.phase_ns[i]);
+  }
+  for (const auto& [type, bytes] : stats.field_bytes) {
+    absl::StrAppend(&json, ",\"field_bytes.", type, "\":", bytes);
+  }
+  json.push_back('}');
+  return json;
+}
+
+}  // namespace harness
@@ -0,0 +1,94 @@
+// Hot-path phase timing for the harnesses' --stats flag.
+//
+// Each phase of a request (schema import, prototype creation, text and
+// binary parsing, serialization, comparison, text printing, output write) is
+// timed with a monotonic clock by a ScopedPhase around it, and the totals are
+// printed as one flat JSON object so a driver can sum them across a whole
+// campaign. Optionally, the serialized size of every parsed message is also
+// broken down by field type.
+//
+// Collection is off until EnableStats() is called, and a disabled ScopedPhase
+// never reads the clock. The counters are process-wide and not synchronized;
+// the harnesses are single-threaded.
+
+#ifndef PROTOMON_FUZZ_HARNESS_CPP_PHASE_STATS_H_
+#define PROTOMON_FUZZ_HARNESS_CPP_PHASE_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+
+namespace harness {
+
+enum class Phase {
+  kImport,
+  kPrototype,
+  kTextParse,
+  kBinaryParse,
+  kSerialize,
+  kCompare,
+  kTextPrint,
+  kWrite,
+};
+constexpr int kNumPhases = static_cast<int>(Phase::kWrite) + 1;
+
+struct PhaseStats {
+  uint64_t requests = 0;
+  int64_t phase_ns[kNumPhases] = {};
+  // Serialized bytes by field type name ("int32", "string", ...), including
+  // tags and length prefixes. Submessage framing counts as "message" and
+  // unknown fields as "unknown". Only filled with field sizes enabled.
+  std::map<std::string, uint64_t> field_bytes;
+};
+
+// Starts collecting, with the per-field-type breakdown if `field_sizes`.
+void EnableStats(bool field_sizes);
+bool StatsEnabled();
+
+// The totals collected so far.
+PhaseStats& CurrentStats();
+
+// Adds the time from construction to destruction to `phase`.
+class ScopedPhase {
+ public:
+  explicit ScopedPhase(Phase phase);
+  ~ScopedPhase();
+
+  ScopedPhase(const ScopedPhase&) = delete;
+  ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+ private:
+  Phase phase_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Adds `message`'s serialized size, by field type, to the current stats if
+// field sizes are enabled.
+void RecordFieldSizes(const google::protobuf::Message& message);
+
+// Protobuf operations timed as their phase, shared by both harnesses.
+bool ParseText(google::protobuf::io::ZeroCopyInputStream* input,
+               google::protobuf::Message* message);
+bool ParseBinary(google::protobuf::io::ZeroCopyInputStream* input,
+                 google::protobuf::Message* message);
+bool ParseBinary(absl::string_view input, google::protobuf::Message* message);
+// Appends the serialization of `message` to `output`, sized up front from
+// ByteSizeLong() and written in place. Fails for messages missing required
+// fields or over 2 GiB.
+bool Serialize(const google::protobuf::Message& message, bool deterministic,
+               std::string* output);
+bool PrintText(const google::protobuf::Message& message, std::string* output);
+
+// `stats` as one line of flat JSON: "requests", "<phase>_ns" for every
+// phase, and "field_bytes.<type>" for every field type seen.
+std::string StatsToJson(const PhaseStats& stats);
+
+}  // namespace harness
+
+#endif  // PROTOMON_FUZZ_HARNESS_CPP_PHASE_STATS_H_
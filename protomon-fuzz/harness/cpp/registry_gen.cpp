@@ -0,0 +1,146 @@
+// Generates a compiled harness's message registry (compiled_registry.h).
+//
+// Reads the descriptor sets of the proto_library targets a harness is built
+// for and writes a .cc file that includes each file's generated .pb.h and
+// lists every message in it, nested messages included and map entries
+// excluded, as a compiled::RunWithMessage<T> instantiation. The
+// compiled_harness macro in compiled_harness.bzl runs it; by hand:
+//
+//   protoc --descriptor_set_out=test.pb proto/test.proto
+//   ./registry_gen --descriptor_sets=test.pb --out=registry.cc
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/strip.h"
+#include "google/protobuf/descriptor.pb.h"
+
+ABSL_FLAG(std::vector<std::string>, descriptor_sets, {},
+          "FileDescriptorSets whose files' messages are registered");
+ABSL_FLAG(std::string, out, "", "Path of the generated registry .cc file");
+
+namespace {
+
+struct Entry {
+  std::string full_name;   // conformance.Outer.Inner
+  std::string class_name;  // ::conformance::Outer_Inner
+};
+
+// protoc's C++ generator appends "_" to a class name that is one of these
+// (its kKeywordList), so `message class` generates class `class_`.
+bool IsCppKeyword(const std::string& name) {
+  static const auto* keywords = new std::unordered_set<std::string>{
+      "NULL", "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool",
+      "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t", "class", "compl",
+      "concept", "const", "consteval", "constexpr", "constinit", "const_cast", "continue",
+      "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do", "double",
+      "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+      "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+      "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
+      "register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static",
+      "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+      "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+      "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+  };
+  return keywords->count(name) > 0;
+}
+
+// Adds `message` and its nested messages, named within `scope` (the package
+// or enclosing message's full name). `class_namespace` is the package's C++
+// namespace and `outer_class` the enclosing message's class name plus "_",
+// or empty at the top level. As in protoc, the keyword suffix applies to
+// each message's own class name, so nested classes inherit it ("class__Inner").
+void AddMessages(const google::protobuf::DescriptorProto& message, const std::string& scope,
+                 const std::string& class_namespace, const std::string& outer_class,
+                 std::vector<Entry>* entries) {
+  // Map entries have no generated class of their own.
+  if (message.options().map_entry()) return;
+
+  std::string full_name = scope.empty() ? message.name() : absl::StrCat(scope, ".", message.name());
+  std::string class_name = absl::StrCat(outer_class, message.name());
+  if (IsCppKeyword(class_name)) class_name += "_";
+  for (const google::protobuf::DescriptorProto& nested : message.nested_type()) {
+    AddMessages(nested, full_name, class_namespace, absl::StrCat(class_name, "_"), entries);
+  }
+  entries->push_back({std::move(full_name), absl::StrCat(class_namespace, class_name)});
+}
+
+bool ReadDescriptorSet(const std::string& path, google::protobuf::FileDescriptorSet* set) {
+  std::ifstream in(path, std::ios::binary);
+  return in && set->ParseFromIstream(&in);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  std::string out_path = absl::GetFlag(FLAGS_out);
+  if (out_path.empty()) {
+    std::cerr << "Error: --out is required" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> headers;
+  std::vector<Entry> entries;
+  for (const std::string& path : absl::GetFlag(FLAGS_descriptor_sets)) {
+    google::protobuf::FileDescriptorSet set;
+    if (!ReadDescriptorSet(path, &set)) {
+      std::cerr << "Failed to read descriptor set " << path << std::endl;
+      return 1;
+    }
+
+    for (const google::protobuf::FileDescriptorProto& file : set.file()) {
+      if (file.message_type_size() == 0) continue;
+      headers.push_back(
+          absl::StrCat(absl::StripSuffix(file.name(), ".proto"), ".pb.h"));
+      std::string class_namespace =
+          absl::StrCat("::", absl::StrReplaceAll(file.package(), {{".", "::"}}),
+                       file.package().empty() ? "" : "::");
+      for (const google::protobuf::DescriptorProto& message : file.message_type()) {
+        AddMessages(message, file.package(), class_namespace, "", &entries);
+      }
+    }
+  }
+  if (entries.empty()) {
+    std::cerr << "Error: the descriptor sets define no messages" << std::endl;
+    return 1;
+  }
+
+  // FindMessage scans linearly; sorting keeps --mode=list readable and the
+  // output stable across descriptor set orders.
+  std::sort(headers.begin(), headers.end());
+  headers.erase(std::unique(headers.begin(), headers.end()), headers.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.full_name < b.full_name; });
+
+  std::string code = "// Generated by registry_gen. Do not edit.\n\n";
+  absl::StrAppend(&code, "#include \"cpp/compiled_modes.h\"\n");
+  absl::StrAppend(&code, "#include \"cpp/compiled_registry.h\"\n");
+  for (const std::string& header : headers) {
+    absl::StrAppend(&code, "#include \"", header, "\"\n");
+  }
+  absl::StrAppend(&code, "\nnamespace harness {\n\nconst CompiledMessage kCompiledMessages[] = {\n");
+  for (const Entry& entry : entries) {
+    absl::StrAppend(&code, "    {\"", entry.full_name, "\", &compiled::RunWithMessage<",
+                    entry.class_name, ">},\n");
+  }
+  absl::StrAppend(&code, "};\n\nconst size_t kNumCompiledMessages = ", entries.size(),
+                  ";\n\n}  // namespace harness\n");
+
+  std::ofstream out(out_path, std::ios::binary);
+  out << code;
+  if (!out.flush()) {
+    std::cerr << "Failed to write " << out_path << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -13,9 +13,25 @@
 //
 //	# Roundtrip test:
 //	./harness_dynamic --mode=roundtrip --proto=schema.proto --message=package.MessageName < input.textproto > output.bin
+//
+//	# Persistent server, reusing compiled schemas across requests:
+//	./harness_dynamic --mode=serve [--proto=schema.proto]
+//
+// Serve mode speaks the same length-prefixed protocol on stdin/stdout as the
+// C++ harness's --mode=serve (see cpp/main.cpp): each request is a mode,
+// schema text (empty for the --proto schema), message name and payload, and
+// each response a status byte followed by the output or error message.
+// Schemas are compiled with protoc once and kept in an LRU cache keyed by
+// their text. The batch modes (encode_batch, decode_batch, roundtrip_batch)
+// take a payload of message name and input field pairs and answer with one
+// response per item, as in the C++ harness.
 package main
 
 import (
+	"bufio"
+	"container/list"
+	"encoding/binary"
+	"errors"
 	"flag"
 	"fmt"
 	"io"
@@ -28,27 +44,49 @@ import (
 	"google.golang.org/protobuf/proto"
 	"google.golang.org/protobuf/reflect/protodesc"
 	"google.golang.org/protobuf/reflect/protoreflect"
+	"google.golang.org/protobuf/reflect/protoregistry"
 	"google.golang.org/protobuf/types/descriptorpb"
 	"google.golang.org/protobuf/types/dynamicpb"
 )
 
 const maxInputSize = 100 * 1024 * 1024 // 100MB
 
+// Serve response status bytes.
+const (
+	statusOK    = 0
+	statusError = 1
+)
+
+// requestSchemaFile is the name a request's schema text is compiled under.
+const requestSchemaFile = "request.proto"
+
+// batchSuffix marks a serve mode that runs its base mode over a batch of items.
+const batchSuffix = "_batch"
+
 var prettyTextOptions = prototext.MarshalOptions{
 	Multiline: true,
 	Indent:    "  ",
 }
 
 var (
-	mode      = flag.String("mode", "encode", "Mode: 'encode' (text->binary), 'decode' (binary->text), or 'roundtrip'")
-	protoFile = flag.String("proto", "", "Path to .proto file")
-	message   = flag.String("message", "", "Fully qualified message name (e.g., package.MessageName)")
-	protoPath = flag.String("proto_path", "", "Proto import path (defaults to directory containing proto file)")
+	mode               = flag.String("mode", "encode", "Mode: 'encode' (text->binary), 'decode' (binary->text), 'roundtrip', or 'serve'")
+	protoFile          = flag.String("proto", "", "Path to .proto file")
+	message            = flag.String("message", "", "Fully qualified message name (e.g., package.MessageName)")
+	protoPath          = flag.String("proto_path", "", "Proto import path (defaults to directory containing proto file)")
+	schemaCacheEntries = flag.Int("schema_cache_entries", 64, "Maximum number of request schemas kept compiled in 'serve' mode")
 )
 
 func main() {
 	flag.Parse()
 
+	if *mode == "serve" {
+		if err := serve(os.Stdin, os.Stdout); err != nil {
+			fmt.Fprintf(os.Stderr, "Error: %v\n", err)
+			os.Exit(1)
+		}
+		return
+	}
+
 	if *protoFile == "" {
 		fmt.Fprintln(os.Stderr, "Error: --proto is required")
 		os.Exit(1)
@@ -66,22 +104,32 @@ func main() {
 	}
 
 	// Run the requested mode
-	switch *mode {
-	case "encode":
-		err = encode(msgDesc)
-	case "decode":
-		err = decode(msgDesc)
-	case "roundtrip":
-		err = roundtrip(msgDesc)
-	default:
+	modeFn, ok := modes[*mode]
+	if !ok {
 		fmt.Fprintf(os.Stderr, "Unknown mode: %s\n", *mode)
 		os.Exit(1)
 	}
 
+	input, err := readLimited(os.Stdin)
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "Error: failed to read stdin: %v\n", err)
+		os.Exit(1)
+	}
+
+	output, err := modeFn(msgDesc, input)
 	if err != nil {
 		fmt.Fprintf(os.Stderr, "Error: %v\n", err)
 		os.Exit(1)
 	}
+
+	if _, err := os.Stdout.Write(output); err != nil {
+		fmt.Fprintf(os.Stderr, "Error: failed to write output: %v\n", err)
+		os.Exit(1)
+	}
+
+	if *mode == "roundtrip" {
+		fmt.Fprintf(os.Stderr, "Roundtrip OK (%d bytes)\n", len(output))
+	}
 }
 
 // loadMessageDescriptor uses protoc to compile the proto file and returns the message descriptor.
@@ -97,6 +145,16 @@ func loadMessageDescriptor(protoFile, messageName, protoPath string) (protorefle
 		protoPath = filepath.Dir(absProto)
 	}
 
+	files, err := compileProto([]string{protoPath}, filepath.Base(absProto))
+	if err != nil {
+		return nil, err
+	}
+	return findMessage(files, messageName)
+}
+
+// compileProto runs protoc on file, found under the first of protoPaths, and
+// returns the resulting file descriptors.
+func compileProto(protoPaths []string, file string) (*protoregistry.Files, error) {
 	// Create a temp file for the descriptor set
 	tmpFile, err := os.CreateTemp("", "descriptor-*.pb")
 	if err != nil {
@@ -106,13 +164,13 @@ func loadMessageDescriptor(protoFile, messageName, protoPath string) (protorefle
 	defer os.Remove(tmpFile.Name())
 
 	// Run protoc to generate the descriptor set
-	cmd := exec.Command("protoc",
-		"--proto_path="+protoPath,
-		"--descriptor_set_out="+tmpFile.Name(),
-		"--include_imports",
-		filepath.Base(absProto),
-	)
-	cmd.Dir = protoPath
+	var args []string
+	for _, p := range protoPaths {
+		args = append(args, "--proto_path="+p)
+	}
+	args = append(args, "--descriptor_set_out="+tmpFile.Name(), "--include_imports", file)
+	cmd := exec.Command("protoc", args...)
+	cmd.Dir = protoPaths[0]
 	output, err := cmd.CombinedOutput()
 	if err != nil {
 		return nil, fmt.Errorf("protoc failed: %v\n%s", err, output)
@@ -135,8 +193,11 @@ func loadMessageDescriptor(protoFile, messageName, protoPath string) (protorefle
 	if err != nil {
 		return nil, fmt.Errorf("failed to create file descriptors: %w", err)
 	}
+	return files, nil
+}
 
-	// Find the message descriptor
+// findMessage looks up a message descriptor by its fully qualified name.
+func findMessage(files *protoregistry.Files, messageName string) (protoreflect.MessageDescriptor, error) {
 	fullName := protoreflect.FullName(messageName)
 	desc, err := files.FindDescriptorByName(fullName)
 	if err != nil {
@@ -178,68 +239,57 @@ func newMessage(desc protoreflect.MessageDescriptor) *dynamicpb.Message {
 	return dynamicpb.NewMessage(desc)
 }
 
-func encode(msgDesc protoreflect.MessageDescriptor) error {
-	textInput, err := readLimited(os.Stdin)
-	if err != nil {
-		return fmt.Errorf("failed to read stdin: %w", err)
-	}
+// modeFunc runs one mode on one input and returns its output.
+type modeFunc func(msgDesc protoreflect.MessageDescriptor, input []byte) ([]byte, error)
 
+var modes = map[string]modeFunc{
+	"encode":    encode,
+	"decode":    decode,
+	"roundtrip": roundtrip,
+}
+
+func encode(msgDesc protoreflect.MessageDescriptor, textInput []byte) ([]byte, error) {
 	msg := newMessage(msgDesc)
 	if err := prototext.Unmarshal(textInput, msg); err != nil {
-		return fmt.Errorf("failed to parse text format: %w", err)
+		return nil, fmt.Errorf("failed to parse text format: %w", err)
 	}
 
 	binaryOutput, err := proto.Marshal(msg)
 	if err != nil {
-		return fmt.Errorf("failed to serialize: %w", err)
-	}
-
-	if _, err := os.Stdout.Write(binaryOutput); err != nil {
-		return fmt.Errorf("failed to write output: %w", err)
+		return nil, fmt.Errorf("failed to serialize: %w", err)
 	}
 
-	return nil
+	return binaryOutput, nil
 }
 
-func decode(msgDesc protoreflect.MessageDescriptor) error {
-	binaryInput, err := readLimited(os.Stdin)
-	if err != nil {
-		return fmt.Errorf("failed to read stdin: %w", err)
-	}
-
+func decode(msgDesc protoreflect.MessageDescriptor, binaryInput []byte) ([]byte, error) {
 	msg := newMessage(msgDesc)
 	if err := proto.Unmarshal(binaryInput, msg); err != nil {
-		return fmt.Errorf("failed to parse binary: %w", err)
+		return nil, fmt.Errorf("failed to parse binary: %w", err)
 	}
 
 	textOutput, err := prettyTextOptions.Marshal(msg)
 	if err != nil {
-		return fmt.Errorf("failed to print text format: %w", err)
+		return nil, fmt.Errorf("failed to print text format: %w", err)
 	}
 
-	fmt.Print(string(textOutput))
-	return nil
+	return textOutput, nil
 }
 
-func roundtrip(msgDesc protoreflect.MessageDescriptor) error {
-	textInput, err := readLimited(os.Stdin)
-	if err != nil {
-		return fmt.Errorf("failed to read stdin: %w", err)
-	}
-
+func roundtrip(msgDesc protoreflect.MessageDescriptor, textInput []byte) ([]byte, error) {
 	msg1 := newMessage(msgDesc)
 	if err := prototext.Unmarshal(textInput, msg1); err != nil {
-		return fmt.Errorf("failed to parse text format: %w", err)
+		return nil, fmt.Errorf("failed to parse text format: %w", err)
 	}
 
 	binary, err := proto.Marshal(msg1)
 	if err != nil {
-		return fmt.Errorf("failed to serialize: %w", err)
+		return nil, fmt.Errorf("failed to serialize: %w", err)
 	}
 
 	msg2 := newMessage(msgDesc)
 	if err := proto.Unmarshal(binary, msg2); err != nil {
-		return fmt.Errorf("failed to parse binary: %w", err)
+		return nil, fmt.Errorf("failed to parse binary: %w", err)
 	}
 
 	if !proto.Equal(msg1, msg2) {
@@ -256,15 +306,234 @@ func roundtrip(msgDesc protoreflect.MessageDescriptor) error {
 			roundtripText = fmt.Sprintf("<marshal error: %v>", err2)
 		}
 
-		return fmt.Errorf("roundtrip mismatch!\nOriginal:\n%s\nAfter roundtrip:\n%s",
+		return nil, fmt.Errorf("roundtrip mismatch!\nOriginal:\n%s\nAfter roundtrip:\n%s",
 			originalText, roundtripText)
 	}
 
-	if _, err := os.Stdout.Write(binary); err != nil {
-		return fmt.Errorf("failed to write output: %w", err)
+	return binary, nil
+}
+
+// schemaCache is an LRU cache of schemas compiled from request text, keyed
+// by the text itself, so a repeated schema skips protoc entirely.
+type schemaCache struct {
+	capacity  int
+	protoPath string
+	order     *list.List // of *schemaEntry, most recently used first
+	entries   map[string]*list.Element
+}
+
+type schemaEntry struct {
+	text  string
+	files *protoregistry.Files
+}
+
+func newSchemaCache(capacity int, protoPath string) *schemaCache {
+	if capacity < 1 {
+		capacity = 1
+	}
+	return &schemaCache{
+		capacity:  capacity,
+		protoPath: protoPath,
+		order:     list.New(),
+		entries:   make(map[string]*list.Element),
+	}
+}
+
+// get returns the schema compiled from text, running protoc on a miss.
+func (c *schemaCache) get(text string) (*protoregistry.Files, error) {
+	if elem, ok := c.entries[text]; ok {
+		c.order.MoveToFront(elem)
+		return elem.Value.(*schemaEntry).files, nil
+	}
+
+	dir, err := os.MkdirTemp("", "harness-schema-*")
+	if err != nil {
+		return nil, fmt.Errorf("failed to create temp dir: %w", err)
+	}
+	defer os.RemoveAll(dir)
+	if err := os.WriteFile(filepath.Join(dir, requestSchemaFile), []byte(text), 0o644); err != nil {
+		return nil, fmt.Errorf("failed to write schema: %w", err)
+	}
+
+	protoPaths := []string{dir}
+	if c.protoPath != "" {
+		protoPaths = append(protoPaths, c.protoPath)
+	}
+	files, err := compileProto(protoPaths, requestSchemaFile)
+	if err != nil {
+		return nil, err
+	}
+
+	for c.order.Len() >= c.capacity {
+		oldest := c.order.Back()
+		delete(c.entries, oldest.Value.(*schemaEntry).text)
+		c.order.Remove(oldest)
+	}
+	c.entries[text] = c.order.PushFront(&schemaEntry{text: text, files: files})
+	return files, nil
+}
+
+// readField reads one length-prefixed request field. It returns io.EOF only
+// for a clean end of input before the field starts.
+func readField(r io.Reader) ([]byte, error) {
+	var header [4]byte
+	if _, err := io.ReadFull(r, header[:]); err != nil {
+		return nil, err
+	}
+	size := binary.LittleEndian.Uint32(header[:])
+	if size > maxInputSize {
+		return nil, fmt.Errorf("request field exceeds maximum size of %d bytes", maxInputSize)
+	}
+	field := make([]byte, size)
+	if _, err := io.ReadFull(r, field); err != nil {
+		return nil, io.ErrUnexpectedEOF
+	}
+	return field, nil
+}
+
+// readRequest reads the mode, schema, message name and payload fields.
+func readRequest(r io.Reader) ([4][]byte, error) {
+	var fields [4][]byte
+	for i := range fields {
+		field, err := readField(r)
+		if err == io.EOF && i > 0 {
+			err = io.ErrUnexpectedEOF
+		}
+		if err != nil {
+			return fields, err
+		}
+		fields[i] = field
+	}
+	return fields, nil
+}
+
+// appendResponse appends one response, a status byte and a length-prefixed
+// body, to buf.
+func appendResponse(buf []byte, status byte, body []byte) []byte {
+	buf = append(buf, status)
+	buf = binary.LittleEndian.AppendUint32(buf, uint32(len(body)))
+	return append(buf, body...)
+}
+
+func writeResponse(w *bufio.Writer, status byte, body []byte) error {
+	if _, err := w.Write(appendResponse(nil, status, nil)); err != nil {
+		return err
+	}
+	if _, err := w.Write(body); err != nil {
+		return err
+	}
+	return w.Flush()
+}
+
+// consumeField splits one length-prefixed field off the front of data.
+func consumeField(data []byte) (field, rest []byte, ok bool) {
+	if len(data) < 4 {
+		return nil, data, false
+	}
+	size := binary.LittleEndian.Uint32(data)
+	if uint64(len(data)-4) < uint64(size) {
+		return nil, data, false
+	}
+	return data[4 : 4+size], data[4+size:], true
+}
+
+// handleBatch runs modeFn over every message name and input pair in payload
+// and returns one response per item. An empty item name means messageName.
+func handleBatch(modeFn modeFunc, files *protoregistry.Files, messageName string, payload []byte) ([]byte, error) {
+	var body []byte
+	for item := 0; len(payload) > 0; item++ {
+		name, rest, ok := consumeField(payload)
+		var input []byte
+		if ok {
+			input, rest, ok = consumeField(rest)
+		}
+		if !ok {
+			return nil, fmt.Errorf("malformed batch item %d", item)
+		}
+		payload = rest
+
+		if len(name) == 0 {
+			name = []byte(messageName)
+		}
+		msgDesc, err := findMessage(files, string(name))
+		var output []byte
+		if err == nil {
+			output, err = modeFn(msgDesc, input)
+		}
+		if err != nil {
+			body = appendResponse(body, statusError, []byte(err.Error()))
+		} else {
+			body = appendResponse(body, statusOK, output)
+		}
+	}
+	return body, nil
+}
+
+// serve answers requests from r until end of input, writing responses to w.
+func serve(r io.Reader, w io.Writer) error {
+	var defaultFiles *protoregistry.Files
+	if *protoFile != "" {
+		absProto, err := filepath.Abs(*protoFile)
+		if err != nil {
+			return fmt.Errorf("failed to get absolute path: %w", err)
+		}
+		dir := *protoPath
+		if dir == "" {
+			dir = filepath.Dir(absProto)
+		}
+		if defaultFiles, err = compileProto([]string{dir}, filepath.Base(absProto)); err != nil {
+			return err
+		}
 	}
 
-	fmt.Fprintf(os.Stderr, "Roundtrip OK (%d bytes)\n", len(binary))
-	return nil
+	cache := newSchemaCache(*schemaCacheEntries, *protoPath)
+	in := bufio.NewReaderSize(r, 64*1024)
+	out := bufio.NewWriterSize(w, 64*1024)
+	for {
+		fields, err := readRequest(in)
+		if err == io.EOF {
+			return nil
+		}
+		if err != nil {
+			return fmt.Errorf("failed to read request: %w", err)
+		}
+
+		status := byte(statusOK)
+		output, err := handleRequest(string(fields[0]), string(fields[1]), string(fields[2]), fields[3], defaultFiles, cache)
+		if err != nil {
+			status = statusError
+			output = []byte(err.Error())
+		}
+		if err := writeResponse(out, status, output); err != nil {
+			return fmt.Errorf("failed to write response: %w", err)
+		}
+	}
 }
 
+// handleRequest runs one serve request.
+func handleRequest(mode, schema, messageName string, payload []byte, defaultFiles *protoregistry.Files, cache *schemaCache) ([]byte, error) {
+	baseMode, batch := strings.CutSuffix(mode, batchSuffix)
+	modeFn, ok := modes[baseMode]
+	if !ok {
+		return nil, fmt.Errorf("unknown mode: %s", mode)
+	}
+
+	files := defaultFiles
+	if schema != "" {
+		var err error
+		if files, err = cache.get(schema); err != nil {
+			return nil, err
+		}
+	} else if files == nil {
+		return nil, errors.New("request has no schema and --proto was not given")
+	}
+
+	if batch {
+		return handleBatch(modeFn, files, messageName, payload)
+	}
+	msgDesc, err := findMessage(files, messageName)
+	if err != nil {
+		return nil, err
+	}
+	return modeFn(msgDesc, payload)
+}
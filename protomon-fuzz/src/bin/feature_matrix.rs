@@ -0,0 +1,453 @@
+//! CPU-feature matrix: protomon's varint and packed benches built once per
+//! target-feature set, with the C++ harness as the reference.
+//!
+//! protomon's architecture-specific paths are compile-time only: the BMI2
+//! `pext` path of `decode_u64_impl_a`, and whatever the compiler
+//! auto-vectorizes for the enabled SIMD level. This runner rebuilds the
+//! benches for every feature variant the host supports, each in its own
+//! target directory under `target/feature-matrix/` so rebuilds stay cached,
+//! and reports per benchmark which variant is fastest and whether it beats
+//! the runner-up significantly (Welch's t-test at 95% and more than
+//! `--noise`). The variant winning most benchmarks is what runtime dispatch
+//! should choose on this host; `pext` is microcoded on AMD Zen 1/2, so the
+//! answer differs between deployments.
+//!
+//! Every `--cpp-harness` is benched on the `--corpus` payloads as the
+//! reference. Give one harness per C++ build to compare their feature
+//! levels too, e.g. `--cpp-harness avx2=...` for one built with
+//! `bazel build -c opt --copt=-mavx2`.
+//!
+//! Usage:
+//!   cargo run --release -p protomon-fuzz --bin feature_matrix -- \
+//!     --corpus protomon-conformance/bench_corpus \
+//!     --cpp-harness protomon-fuzz/harness/bazel-bin/cpp/harness_compiled_conformance
+
+use std::collections::BTreeMap;
+use std::env;
+use std::ffi::OsStr;
+use std::fs;
+use std::io::Write as _;
+use std::path::{Path, PathBuf};
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use protomon_fuzz::{
+    bench_cpp_harness, cpu_model, git_describe, run_criterion_bench, split_list, workspace_dirs,
+    Change, PerfRun, Summary,
+};
+
+/// The protomon benches the matrix runs, in `protomon/benches`.
+const DEFAULT_BENCHES: &str = "leb128,packed";
+
+/// A set of target features to build the benches with.
+struct Variant {
+    name: &'static str,
+    /// `RUSTFLAGS` added for this variant.
+    rustflags: &'static str,
+    /// Features the host must have to run it.
+    requires: &'static [&'static str],
+}
+
+#[cfg(target_arch = "x86_64")]
+const VARIANTS: &[Variant] = &[
+    Variant {
+        name: "baseline",
+        rustflags: "",
+        requires: &[],
+    },
+    Variant {
+        name: "sse4.2",
+        rustflags: "-C target-feature=+sse4.2,+popcnt",
+        requires: &["sse4.2", "popcnt"],
+    },
+    Variant {
+        name: "avx2",
+        rustflags: "-C target-feature=+avx2,+fma",
+        requires: &["avx2", "fma"],
+    },
+    Variant {
+        name: "bmi2",
+        rustflags: "-C target-feature=+bmi1,+bmi2",
+        requires: &["bmi1", "bmi2"],
+    },
+    Variant {
+        name: "avx2+bmi2",
+        rustflags: "-C target-feature=+avx2,+fma,+bmi1,+bmi2",
+        requires: &["avx2", "fma", "bmi1", "bmi2"],
+    },
+    Variant {
+        name: "native",
+        rustflags: "-C target-cpu=native",
+        requires: &[],
+    },
+];
+
+// NEON is part of the aarch64 baseline, so the baseline variant is NEON.
+#[cfg(target_arch = "aarch64")]
+const VARIANTS: &[Variant] = &[
+    Variant {
+        name: "neon",
+        rustflags: "",
+        requires: &[],
+    },
+    Variant {
+        name: "sve",
+        rustflags: "-C target-feature=+sve",
+        requires: &["sve"],
+    },
+    Variant {
+        name: "native",
+        rustflags: "-C target-cpu=native",
+        requires: &[],
+    },
+];
+
+#[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+const VARIANTS: &[Variant] = &[
+    Variant {
+        name: "baseline",
+        rustflags: "",
+        requires: &[],
+    },
+    Variant {
+        name: "native",
+        rustflags: "-C target-cpu=native",
+        requires: &[],
+    },
+];
+
+/// Whether the host CPU has `feature`, one of the names in [`VARIANTS`].
+fn host_has(feature: &str) -> bool {
+    #[cfg(target_arch = "x86_64")]
+    {
+        match feature {
+            "sse4.2" => std::arch::is_x86_feature_detected!("sse4.2"),
+            "popcnt" => std::arch::is_x86_feature_detected!("popcnt"),
+            "avx2" => std::arch::is_x86_feature_detected!("avx2"),
+            "fma" => std::arch::is_x86_feature_detected!("fma"),
+            "bmi1" => std::arch::is_x86_feature_detected!("bmi1"),
+            "bmi2" => std::arch::is_x86_feature_detected!("bmi2"),
+            _ => false,
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        match feature {
+            "sve" => std::arch::is_aarch64_feature_detected!("sve"),
+            _ => false,
+        }
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        let _ = feature;
+        false
+    }
+}
+
+struct Config {
+    benches: Vec<String>,
+    variants: Option<Vec<String>>,
+    corpus: Option<PathBuf>,
+    /// `(label, harness)` pairs.
+    cpp_harnesses: Vec<(String, PathBuf)>,
+    cpp_runs: usize,
+    noise: f64,
+    history: Option<PathBuf>,
+}
+
+fn main() {
+    let (workspace, target_dir) = workspace_dirs();
+    let config = parse_args();
+
+    let cpu = cpu_model();
+    let mut variants = Vec::new();
+    for variant in VARIANTS {
+        if let Some(names) = &config.variants {
+            if !names.iter().any(|name| name == variant.name) {
+                continue;
+            }
+        }
+        let missing: Vec<&str> = variant
+            .requires
+            .iter()
+            .copied()
+            .filter(|f| !host_has(f))
+            .collect();
+        if missing.is_empty() {
+            variants.push(variant);
+        } else {
+            eprintln!(
+                "Skipping {}: {} lacks {}",
+                variant.name,
+                cpu,
+                missing.join(", ")
+            );
+        }
+    }
+    if variants.is_empty() {
+        eprintln!("No runnable variants; this host supports:");
+        for variant in VARIANTS
+            .iter()
+            .filter(|v| v.requires.iter().all(|f| host_has(f)))
+        {
+            eprintln!("  {}", variant.name);
+        }
+        std::process::exit(1);
+    }
+
+    // Benchmark id -> variant name -> summary.
+    let mut rust: BTreeMap<String, BTreeMap<&str, Summary>> = BTreeMap::new();
+    for variant in &variants {
+        let variant_dir = target_dir.join("feature-matrix").join(variant.name);
+        for (id, summary) in bench_variant(&config, &workspace, &variant_dir, variant) {
+            rust.entry(id).or_default().insert(variant.name, summary);
+        }
+    }
+    let mut cpp: BTreeMap<String, BTreeMap<&str, Summary>> = BTreeMap::new();
+    if let Some(corpus) = &config.corpus {
+        for (label, harness) in &config.cpp_harnesses {
+            for (id, summary) in bench_cpp_harness(harness, corpus, config.cpp_runs) {
+                cpp.entry(id).or_default().insert(label.as_str(), summary);
+            }
+        }
+    }
+
+    let names: Vec<&str> = variants.iter().map(|v| v.name).collect();
+    println!(
+        "{}: {} variants, {} benchmarks",
+        cpu,
+        names.len(),
+        rust.len()
+    );
+    let wins = print_table(&names, &rust, config.noise);
+    if !cpp.is_empty() {
+        println!();
+        let labels: Vec<&str> = config
+            .cpp_harnesses
+            .iter()
+            .map(|(l, _)| l.as_str())
+            .collect();
+        println!("C++ reference ({}):", labels.join(", "));
+        print_table(&labels, &cpp, config.noise);
+    }
+
+    println!();
+    println!("Significant wins per variant:");
+    for name in &names {
+        println!("  {:<12} {}", name, wins.get(name).copied().unwrap_or(0));
+    }
+    // `native` isn't a feature set dispatch can select, only the ceiling.
+    // Ties go to the earlier, smaller feature set.
+    let win_count = |name: &str| wins.get(name).copied().unwrap_or(0);
+    let mut dispatchable = names.iter().copied().filter(|&name| name != "native");
+    let first = dispatchable.next();
+    if let Some(best) = first.map(|first| {
+        dispatchable.fold(first, |best, name| {
+            if win_count(name) > win_count(best) {
+                name
+            } else {
+                best
+            }
+        })
+    }) {
+        println!("Runtime dispatch on {} should choose: {}", cpu, best);
+    }
+
+    if let Some(history) = &config.history {
+        let timestamp = SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .unwrap()
+            .as_secs();
+        // Each variant is recorded as a run of the tree that was measured,
+        // tagged with the variant so perf_history never takes it as a
+        // baseline.
+        let commit = git_describe(&workspace);
+        let mut lines = String::new();
+        for name in &names {
+            let run = PerfRun {
+                commit: commit.clone(),
+                variant: Some(name.to_string()),
+                cpu: cpu.clone(),
+                timestamp,
+                results: rust
+                    .iter()
+                    .filter_map(|(id, by_variant)| {
+                        Some((format!("rust/{}", id), *by_variant.get(name)?))
+                    })
+                    .collect(),
+            };
+            lines.push_str(&run.to_json());
+            lines.push('\n');
+        }
+        let written = fs::OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(history)
+            .and_then(|mut file| file.write_all(lines.as_bytes()));
+        if let Err(e) = written {
+            eprintln!("Failed to write {}: {}", history.display(), e);
+            std::process::exit(1);
+        }
+    }
+}
+
+fn parse_args() -> Config {
+    let args: Vec<String> = env::args().collect();
+    let mut config = Config {
+        benches: split_list(DEFAULT_BENCHES),
+        variants: None,
+        corpus: None,
+        cpp_harnesses: Vec::new(),
+        cpp_runs: 5,
+        noise: 0.02,
+        history: None,
+    };
+
+    let mut i = 1;
+    while i < args.len() {
+        match args[i].as_str() {
+            "--benches" => {
+                i += 1;
+                config.benches = split_list(&args[i]);
+            }
+            "--variants" => {
+                i += 1;
+                config.variants = Some(split_list(&args[i]));
+            }
+            "--corpus" => {
+                i += 1;
+                config.corpus = Some(PathBuf::from(&args[i]));
+            }
+            "--cpp-harness" => {
+                i += 1;
+                let harness = match args[i].split_once('=') {
+                    Some((label, path)) => (label.to_string(), PathBuf::from(path)),
+                    None => ("cpp".to_string(), PathBuf::from(&args[i])),
+                };
+                config.cpp_harnesses.push(harness);
+            }
+            "--cpp-runs" => {
+                i += 1;
+                config.cpp_runs = args[i].parse().expect("Invalid run count");
+            }
+            "--noise" => {
+                i += 1;
+                config.noise = args[i].parse().expect("Invalid noise threshold");
+            }
+            "--history" => {
+                i += 1;
+                config.history = Some(PathBuf::from(&args[i]));
+            }
+            "--help" | "-h" => {
+                let names: Vec<&str> = VARIANTS.iter().map(|v| v.name).collect();
+                eprintln!("Usage: feature_matrix [OPTIONS]");
+                eprintln!();
+                eprintln!("Options:");
+                eprintln!(
+                    "  --benches LIST          protomon benches to run (default: {})",
+                    DEFAULT_BENCHES
+                );
+                eprintln!(
+                    "  --variants LIST         Variants to build (default: all the host supports)"
+                );
+                eprintln!("                          of {}", names.join(", "));
+                eprintln!("  --corpus DIR            generate_binaries --synthesize corpus");
+                eprintln!(
+                    "  --cpp-harness [L=]PATH  harness_compiled_conformance labelled L, benched"
+                );
+                eprintln!("                          on the corpus; repeat for each C++ build");
+                eprintln!("  --cpp-runs N            Harness runs per payload (default: 5)");
+                eprintln!(
+                    "  --noise F               Smallest relative lead that wins (default: 0.02)"
+                );
+                eprintln!(
+                    "  --history PATH          Also append each variant as a perf_history run"
+                );
+                eprintln!("  --help                  Show this help");
+                std::process::exit(0);
+            }
+            _ => {
+                eprintln!("Unknown argument: {}", args[i]);
+                std::process::exit(1);
+            }
+        }
+        i += 1;
+    }
+
+    if !config.cpp_harnesses.is_empty() && config.corpus.is_none() {
+        eprintln!("--cpp-harness needs a --corpus to bench");
+        std::process::exit(1);
+    }
+    config
+}
+
+/// Build and run every configured bench with `variant`'s target features in
+/// `target_dir`, returning each criterion benchmark it measured.
+fn bench_variant(
+    config: &Config,
+    workspace: &Path,
+    target_dir: &Path,
+    variant: &Variant,
+) -> BTreeMap<String, Summary> {
+    let mut rustflags = env::var("RUSTFLAGS").unwrap_or_default();
+    if !variant.rustflags.is_empty() {
+        if !rustflags.is_empty() {
+            rustflags.push(' ');
+        }
+        rustflags.push_str(variant.rustflags);
+    }
+
+    let mut envs = vec![("RUSTFLAGS", OsStr::new(&rustflags))];
+    if let Some(corpus) = &config.corpus {
+        envs.push(("PROTOMON_VARINT_CORPUS", corpus.as_os_str()));
+    }
+    let mut results = BTreeMap::new();
+    for bench in &config.benches {
+        eprintln!("Running protomon bench {} [{}]", bench, variant.name);
+        results.extend(run_criterion_bench(workspace, target_dir, bench, &envs));
+    }
+    results
+}
+
+/// Print one row per benchmark with each column's mean and the fastest
+/// column, marked `~` when its lead over the runner-up isn't significant.
+/// Returns the number of significant wins per column.
+fn print_table<'a>(
+    columns: &[&'a str],
+    rows: &BTreeMap<String, BTreeMap<&str, Summary>>,
+    noise: f64,
+) -> BTreeMap<&'a str, usize> {
+    let mut header = format!("  {:<56}", "benchmark (ns)");
+    for column in columns {
+        header.push_str(&format!(" {:>12}", column));
+    }
+    println!("{}  fastest", header);
+
+    let mut wins = BTreeMap::new();
+    for (id, by_column) in rows {
+        let mut line = format!("  {:<56}", id);
+        for column in columns {
+            match by_column.get(column) {
+                Some(summary) => line.push_str(&format!(" {:>12.1}", summary.mean_ns)),
+                None => line.push_str(&format!(" {:>12}", "-")),
+            }
+        }
+        let mut ranked: Vec<(&'a str, Summary)> = columns
+            .iter()
+            .filter_map(|&column| Some((column, *by_column.get(column)?)))
+            .collect();
+        ranked.sort_by(|a, b| a.1.mean_ns.total_cmp(&b.1.mean_ns));
+        if let Some(&(fastest, summary)) = ranked.first() {
+            let significant = ranked.get(1).map_or(false, |&(_, runner_up)| {
+                Change::new(id, runner_up, summary, noise).is_some_and(|c| c.is_improvement())
+            });
+            if significant {
+                *wins.entry(fastest).or_insert(0) += 1;
+                line.push_str(&format!("  {}", fastest));
+            } else {
+                line.push_str(&format!("  ~{}", fastest));
+            }
+        }
+        println!("{}", line);
+    }
+    wins
+}
@@ -10,15 +10,53 @@
 //!   cargo run --bin harness_test -- \
 //!     --cpp-harness harness/bazel-bin/cpp/harness \
 //!     --go-harness harness/bazel-bin/go/harness_dynamic_/harness_dynamic
+//!
+//! Iterations run on `--jobs` worker threads (one per core by default), each
+//! pulling the next iteration from a shared counter. Pass `--serve` to give
+//! every worker its own persistent C++ and Go harness in `--mode=serve`
+//! instead of spawning both harnesses for every encode and decode. A server
+//! encodes all of an iteration's message values in one batch request.
+//!
+//! Iteration `i` is always generated from seed `BASE + i`, whichever worker
+//! runs it, so any failure can be replayed on its own with
+//! `--seed BASE --start i --iterations 1`.
+//!
+//! With `--stats`, the C++ harness times each phase of every request
+//! (`--stats=json`) and the runner prints the totals over all workers at the
+//! end, to show whether import, parsing, comparison or pipe writes dominate.
+//!
+//! With `--specialize harness/cpp/build_specialized.sh`, a schema seen
+//! `--specialize-after` times gets its own `harness_compiled` build, cached on
+//! disk by schema hash, and the C++ side of its later iterations runs on
+//! generated code instead of `DynamicMessage`. One-off schemas stay on
+//! `--cpp-harness`, as does a schema while its build runs in the background.
+//! A specialized harness is spawned per message, so it is not used with
+//! `--serve`, whose servers already keep each schema compiled.
+//!
+//! Every generated case is canonicalized (messages and fields renamed by
+//! position) and hashed, and a case seen before in the campaign is skipped
+//! instead of spending harness calls on it again. With `--corpus DIR` the
+//! distinct cases are also kept in `DIR` (see `CaseCorpus`), so later
+//! campaigns skip them too, and a failing case is minimized (down to one
+//! message and the fields it still fails with) and saved under
+//! `DIR/failing/`. `--replay DIR` runs every stored case under `DIR`, or a
+//! single case directory, through persistent harness servers instead of
+//! generating new ones.
 
 use std::env;
+use std::fmt::Write as _;
 use std::fs;
-use std::io::Write;
-use std::path::PathBuf;
+use std::io::Write as _;
+use std::path::{Path, PathBuf};
 use std::process::{Command, Stdio};
+use std::sync::atomic::{AtomicBool, AtomicU32, Ordering};
+use std::sync::{mpsc, Mutex};
+use std::thread;
 
 use arbitrary::Unstructured;
-use protomon_fuzz::TestCase;
+use protomon_fuzz::{
+    CaseCorpus, HarnessServer, HarnessStats, SpecializedHarnesses, StoredCase, TestCase,
+};
 
 fn main() {
     let args: Vec<String> = env::args().collect();
@@ -27,7 +65,16 @@ fn main() {
     let mut cpp_harness: Option<PathBuf> = None;
     let mut go_harness: Option<PathBuf> = None;
     let mut seed: Option<u64> = None;
+    let mut start: u32 = 0;
     let mut iterations: u32 = 1;
+    let mut jobs: Option<usize> = None;
+    let mut serve = false;
+    let mut stats = false;
+    let mut specialize: Option<PathBuf> = None;
+    let mut specialize_after = SpecializedHarnesses::DEFAULT_THRESHOLD;
+    let mut specialize_cache: Option<PathBuf> = None;
+    let mut corpus_dir: Option<PathBuf> = None;
+    let mut replay: Option<PathBuf> = None;
 
     let mut i = 1;
     while i < args.len() {
@@ -44,18 +91,71 @@ fn main() {
                 i += 1;
                 seed = Some(args[i].parse().expect("Invalid seed"));
             }
+            "--start" => {
+                i += 1;
+                start = args[i].parse().expect("Invalid start iteration");
+            }
             "--iterations" | "-n" => {
                 i += 1;
                 iterations = args[i].parse().expect("Invalid iteration count");
             }
+            "--jobs" | "-j" => {
+                i += 1;
+                jobs = Some(args[i].parse().expect("Invalid job count"));
+            }
+            "--serve" => {
+                serve = true;
+            }
+            "--stats" => {
+                stats = true;
+            }
+            "--specialize" => {
+                i += 1;
+                specialize = Some(PathBuf::from(&args[i]));
+            }
+            "--specialize-after" => {
+                i += 1;
+                specialize_after = args[i].parse().expect("Invalid specialize threshold");
+            }
+            "--specialize-cache" => {
+                i += 1;
+                specialize_cache = Some(PathBuf::from(&args[i]));
+            }
+            "--corpus" => {
+                i += 1;
+                corpus_dir = Some(PathBuf::from(&args[i]));
+            }
+            "--replay" => {
+                i += 1;
+                replay = Some(PathBuf::from(&args[i]));
+            }
             "--help" | "-h" => {
                 eprintln!("Usage: harness_test [OPTIONS]");
                 eprintln!();
                 eprintln!("Options:");
                 eprintln!("  --cpp-harness PATH    Path to C++ dynamic harness");
                 eprintln!("  --go-harness PATH     Path to Go dynamic harness");
-                eprintln!("  --seed N              Random seed (default: random)");
+                eprintln!("  --seed N              Base random seed (default: random)");
+                eprintln!("  --start N             First iteration to run (default: 0)");
                 eprintln!("  --iterations N        Number of test iterations (default: 1)");
+                eprintln!("  --jobs N              Worker threads (default: one per core)");
+                eprintln!("  --serve               Give each worker persistent harness servers");
+                eprintln!("  --stats               Print C++ harness time per phase at the end");
+                eprintln!("  --specialize SCRIPT   Build compiled harnesses for recurring schemas");
+                eprintln!("                        with SCRIPT (harness/cpp/build_specialized.sh)");
+                eprintln!("                        (not with --serve)");
+                eprintln!(
+                    "  --specialize-after N  Sightings before a schema is built (default: {})",
+                    SpecializedHarnesses::DEFAULT_THRESHOLD
+                );
+                eprintln!("  --specialize-cache DIR  Where built harnesses are kept");
+                eprintln!("                        (default: $TMPDIR/protomon-specialized)");
+                eprintln!(
+                    "  --corpus DIR          Keep distinct and minimized failing cases in DIR"
+                );
+                eprintln!("                        and skip the ones already there");
+                eprintln!("  --replay PATH         Run the stored cases under PATH on harness");
+                eprintln!("                        servers instead of generating cases");
                 eprintln!("  --help                Show this help");
                 return;
             }
@@ -80,22 +180,349 @@ fn main() {
         std::process::exit(1);
     }
 
-    // Create temp directory
-    let temp_dir = tempfile::tempdir().expect("Failed to create temp directory");
+    let corpus = match corpus_dir {
+        Some(dir) => CaseCorpus::open(dir.clone()).unwrap_or_else(|e| {
+            eprintln!("Failed to open corpus {}: {}", dir.display(), e);
+            std::process::exit(1);
+        }),
+        None => CaseCorpus::new(),
+    };
+    if !corpus.is_empty() {
+        eprintln!("Corpus has {} distinct case(s) to skip", corpus.len());
+    }
+    let replay = match &replay {
+        Some(path) => {
+            let cases = StoredCase::read_all(path).unwrap_or_else(|e| {
+                eprintln!("Failed to read cases from {}: {}", path.display(), e);
+                std::process::exit(1);
+            });
+            // Stored cases are replayed in batch on the harness servers.
+            serve = true;
+            start = 0;
+            iterations = cases.len() as u32;
+            eprintln!(
+                "Replaying {} stored case(s) from {}",
+                cases.len(),
+                path.display()
+            );
+            cases
+        }
+        None => Vec::new(),
+    };
+
+    let base_seed = seed.unwrap_or_else(|| {
+        use std::time::{SystemTime, UNIX_EPOCH};
+        SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .unwrap()
+            .as_nanos() as u64
+    });
+    let jobs = jobs
+        .unwrap_or_else(|| thread::available_parallelism().map_or(1, |n| n.get()))
+        .clamp(1, iterations.max(1) as usize);
+    if replay.is_empty() {
+        eprintln!(
+            "Base seed {}, iterations {}..{}, {} worker(s)",
+            base_seed,
+            start,
+            start as u64 + iterations as u64,
+            jobs
+        );
+    }
+
+    if serve && specialize.is_some() {
+        eprintln!(
+            "Ignoring --specialize: specialized harnesses are spawned per message, \
+             and harness servers already cache each schema"
+        );
+        specialize = None;
+    }
 
-    for iter in 0..iterations {
-        // Generate random bytes for the test case
-        let seed_value = seed.unwrap_or_else(|| {
-            use std::time::{SystemTime, UNIX_EPOCH};
-            SystemTime::now()
-                .duration_since(UNIX_EPOCH)
-                .unwrap()
-                .as_nanos() as u64
-                + iter as u64
-        });
+    let config = Config {
+        cpp_harness,
+        go_harness,
+        serve,
+        stats,
+        specialize: specialize.map(|script| {
+            let cache =
+                specialize_cache.unwrap_or_else(|| env::temp_dir().join("protomon-specialized"));
+            SpecializedHarnesses::new(script, cache, specialize_after)
+        }),
+        corpus: Mutex::new(corpus),
+        replay,
+    };
+    let next = AtomicU32::new(0);
+    let stop = AtomicBool::new(false);
+    let (tx, rx) = mpsc::channel::<Report>();
+
+    let mut passed = 0u32;
+    let mut skipped = 0u32;
+    let mut duplicates = 0u32;
+    let mut first_failure: Option<u32> = None;
+    let mut worker_failed = false;
+    let mut total_stats = HarnessStats::default();
+
+    thread::scope(|s| {
+        let (config, next, stop) = (&config, &next, &stop);
+        let mut handles = Vec::new();
+        for _ in 0..jobs {
+            let tx = tx.clone();
+            handles.push(s.spawn(move || {
+                let mut worker = match Worker::new(config) {
+                    Ok(worker) => worker,
+                    Err(e) => {
+                        stop.store(true, Ordering::Relaxed);
+                        let _ = tx.send(Report {
+                            iter: start,
+                            outcome: Outcome::WorkerFailed,
+                            log: format!("Failed to start worker: {}\n", e),
+                        });
+                        return None;
+                    }
+                };
+
+                while !stop.load(Ordering::Relaxed) {
+                    let offset = next.fetch_add(1, Ordering::Relaxed);
+                    if offset >= iterations {
+                        break;
+                    }
+                    let iter = start + offset;
+                    let mut log = String::new();
+                    let outcome = match config.replay.get(offset as usize) {
+                        Some((path, case)) => worker.run_stored(iter, path, case, &mut log),
+                        None => worker.run_iteration(
+                            iter,
+                            base_seed.wrapping_add(iter as u64),
+                            &mut log,
+                        ),
+                    };
+                    if outcome == Outcome::Failed {
+                        stop.store(true, Ordering::Relaxed);
+                    }
+                    if tx.send(Report { iter, outcome, log }).is_err() {
+                        break;
+                    }
+                }
+                worker.stats()
+            }));
+        }
+        drop(tx);
+
+        // Each iteration's log is printed as one block, in completion order.
+        for report in rx {
+            eprint!("{}", report.log);
+            match report.outcome {
+                Outcome::Passed => passed += 1,
+                Outcome::Skipped => skipped += 1,
+                Outcome::Duplicate => duplicates += 1,
+                Outcome::WorkerFailed => worker_failed = true,
+                Outcome::Failed => {
+                    if first_failure.map_or(true, |iter| report.iter < iter) {
+                        first_failure = Some(report.iter);
+                    }
+                }
+            }
+        }
+
+        for handle in handles {
+            if let Some(stats) = handle.join().expect("worker panicked") {
+                total_stats.merge(&stats);
+            }
+        }
+    });
+
+    if config.stats {
+        eprint!("\nC++ harness stats: {}", total_stats);
+    }
+    if let Some(specialized) = &config.specialize {
+        let building = specialized.building();
+        if building > 0 {
+            eprintln!(
+                "\nWaiting for {} specialized build(s) to be cached",
+                building
+            );
+            specialized.wait();
+        }
+        eprintln!(
+            "\n{} schema(s) have specialized compiled harnesses",
+            specialized.built()
+        );
+    }
+
+    if let Some(iter) = first_failure {
+        match config.replay.get(iter as usize) {
+            Some((path, _)) => eprintln!(
+                "\nCase {} failed. Replay with: --replay {}",
+                path.display(),
+                path.display()
+            ),
+            None => eprintln!(
+                "\nIteration {} failed. Reproduce with: --seed {} --start {} --iterations 1",
+                iter, base_seed, iter
+            ),
+        }
+        std::process::exit(1);
+    }
+    if worker_failed {
+        eprintln!("\nA worker's harnesses failed to start; no failing iteration to reproduce");
+        std::process::exit(1);
+    }
+
+    if duplicates > 0 {
+        eprintln!(
+            "\n{} iterations passed, {} skipped, {} duplicate(s) of earlier cases skipped",
+            passed, skipped, duplicates
+        );
+    } else if skipped > 0 {
+        eprintln!("\n{} iterations passed, {} skipped", passed, skipped);
+    } else {
+        eprintln!("\nAll {} iterations passed!", passed);
+    }
+}
+
+struct Config {
+    cpp_harness: PathBuf,
+    go_harness: PathBuf,
+    serve: bool,
+    /// Collect the C++ harness's `--stats=json` phase timings.
+    stats: bool,
+    /// Build and use specialized compiled harnesses for recurring schemas.
+    specialize: Option<SpecializedHarnesses>,
+    /// Every case seen so far, shared by the workers to skip repeats.
+    corpus: Mutex<CaseCorpus>,
+    /// Stored cases to run instead of generated ones, with their directories.
+    replay: Vec<(PathBuf, StoredCase)>,
+}
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Outcome {
+    Passed,
+    Skipped,
+    /// Skipped because an earlier case had the same canonical form.
+    Duplicate,
+    Failed,
+    /// A worker could not start its harnesses, before running any iteration.
+    WorkerFailed,
+}
 
+/// The result of one iteration, sent from a worker to the main thread.
+struct Report {
+    iter: u32,
+    outcome: Outcome,
+    log: String,
+}
+
+/// A harness, either spawned for every call or running as a persistent server.
+/// With `--stats`, a spawned harness sums the stats of every process here.
+enum Harness<'a> {
+    Spawn(&'a Path, Option<HarnessStats>),
+    /// A `harness_compiled` specialized for the current schema, spawned per call.
+    Compiled(PathBuf, Option<HarnessStats>),
+    Server(HarnessServer, bool),
+}
+
+impl<'a> Harness<'a> {
+    fn new(path: &'a Path, serve: bool, stats: bool) -> std::io::Result<Self> {
+        if serve {
+            // The server caches compiled schemas, so one process serves every iteration.
+            let args: &[&str] = if stats { &["--stats=json"] } else { &[] };
+            Ok(Harness::Server(
+                HarnessServer::spawn_with_args(path, args)?,
+                stats,
+            ))
+        } else {
+            Ok(Harness::Spawn(path, stats.then(HarnessStats::default)))
+        }
+    }
+
+    /// The stats collected so far, if this harness was created with them.
+    fn stats(&mut self) -> Option<HarnessStats> {
+        match self {
+            Harness::Spawn(_, stats) | Harness::Compiled(_, stats) => stats.clone(),
+            Harness::Server(server, true) => match server.stats() {
+                Ok(stats) => Some(stats),
+                Err(e) => {
+                    eprintln!("Failed to read harness stats: {}", e);
+                    None
+                }
+            },
+            Harness::Server(_, false) => None,
+        }
+    }
+
+    /// Run `mode` on `input` as `message` of the schema `proto`, which
+    /// spawned harnesses read from `proto_path`.
+    fn call(
+        &mut self,
+        mode: &str,
+        proto: &str,
+        proto_path: &Path,
+        message: &str,
+        input: &[u8],
+    ) -> Result<Vec<u8>, String> {
+        match self {
+            Harness::Spawn(path, stats) => {
+                run_harness(path, proto_path, message, input, mode, stats.as_mut())
+            }
+            Harness::Compiled(binary, stats) => {
+                run_compiled(binary, message, input, mode, stats.as_mut())
+            }
+            Harness::Server(server, _) => server.call(mode, proto, message, input),
+        }
+    }
+
+    /// Run `mode` on every `(message, input)` item, in one exchange for a
+    /// server and one process per item otherwise.
+    fn call_batch(
+        &mut self,
+        mode: &str,
+        proto: &str,
+        proto_path: &Path,
+        items: &[(&str, &[u8])],
+    ) -> Result<Vec<Result<Vec<u8>, String>>, String> {
+        match self {
+            Harness::Spawn(path, stats) => Ok(items
+                .iter()
+                .map(|(message, input)| {
+                    run_harness(path, proto_path, message, input, mode, stats.as_mut())
+                })
+                .collect()),
+            Harness::Compiled(binary, stats) => Ok(items
+                .iter()
+                .map(|(message, input)| run_compiled(binary, message, input, mode, stats.as_mut()))
+                .collect()),
+            Harness::Server(server, _) => server.call_batch(mode, proto, items),
+        }
+    }
+}
+
+/// Per-thread state: its own harnesses and a private directory for schemas.
+struct Worker<'a> {
+    config: &'a Config,
+    cpp: Harness<'a>,
+    go: Harness<'a>,
+    temp_dir: tempfile::TempDir,
+    /// `--stats` totals of the specialized harnesses this worker ran.
+    specialized_stats: Option<HarnessStats>,
+}
+
+impl<'a> Worker<'a> {
+    fn new(config: &'a Config) -> std::io::Result<Self> {
+        Ok(Self {
+            config,
+            cpp: Harness::new(&config.cpp_harness, config.serve, config.stats)?,
+            // Only the C++ harness implements --stats.
+            go: Harness::new(&config.go_harness, config.serve, false)?,
+            temp_dir: tempfile::tempdir()?,
+            specialized_stats: config.stats.then(HarnessStats::default),
+        })
+    }
+
+    /// Generate iteration `iter` from `seed` and cross-check every message
+    /// value in it, appending progress to `log`.
+    fn run_iteration(&mut self, iter: u32, seed: u64, log: &mut String) -> Outcome {
         // Use a simple PRNG to generate test data
-        let mut rng_state = seed_value;
+        let mut rng_state = seed;
         let mut random_bytes = vec![0u8; 256];
         for byte in &mut random_bytes {
             // Simple xorshift64
@@ -111,189 +538,348 @@ fn main() {
         let test_case = match TestCase::arbitrary(&mut u) {
             Ok(tc) => tc,
             Err(_) => {
-                eprintln!(
+                let _ = writeln!(
+                    log,
                     "Iteration {}: Failed to generate test case (not enough entropy), skipping",
                     iter
                 );
-                continue;
+                return Outcome::Skipped;
             }
         };
 
-        // Write proto file
-        let proto_path = temp_dir.path().join("test.proto");
-        fs::write(&proto_path, test_case.to_proto()).expect("Failed to write proto file");
+        if test_case.schema.messages.is_empty() {
+            let _ = writeln!(log, "Iteration {}: No messages in schema, skipping", iter);
+            return Outcome::Skipped;
+        }
+
+        let inserted = self
+            .config
+            .corpus
+            .lock()
+            .unwrap()
+            .insert(&StoredCase::from_test_case(&test_case));
+        match inserted {
+            Ok(true) => {}
+            Ok(false) => {
+                let _ = writeln!(
+                    log,
+                    "Iteration {}: Duplicate of an earlier case, skipping",
+                    iter
+                );
+                return Outcome::Duplicate;
+            }
+            Err(e) => {
+                let _ = writeln!(log, "Iteration {}: Failed to store case: {}", iter, e);
+            }
+        }
 
-        // Get the message names from the schema
-        let messages: Vec<_> = test_case
-            .schema
-            .messages
+        let names: Vec<String> = test_case
+            .values
             .iter()
-            .map(|m| m.name.clone())
+            .map(|(msg_name, _)| format!("{}.{}", test_case.schema.package, msg_name))
             .collect();
-
-        if messages.is_empty() {
-            eprintln!("Iteration {}: No messages in schema, skipping", iter);
-            continue;
+        let texts: Vec<String> = test_case
+            .values
+            .iter()
+            .map(|(_, msg_value)| msg_value.to_text_format())
+            .collect();
+        let outcome = self.run_case(iter, &test_case.to_proto(), &names, &texts, log);
+        if outcome == Outcome::Failed {
+            let minimized = self.minimize(iter, &test_case);
+            let saved = self
+                .config
+                .corpus
+                .lock()
+                .unwrap()
+                .record_failure(&minimized);
+            match saved {
+                Ok(Some(dir)) => {
+                    let _ = writeln!(log, "  Minimized case saved to {}", dir.display());
+                }
+                Ok(None) => {}
+                Err(e) => {
+                    let _ = writeln!(log, "  Failed to save the minimized case: {}", e);
+                }
+            }
         }
+        outcome
+    }
 
-        // Test each message type
-        for (msg_name, msg_value) in &test_case.values {
-            let full_name = format!("{}.{}", test_case.schema.package, msg_name);
-            let text_format = msg_value.to_text_format();
+    /// Cross-check a case stored in `path`.
+    fn run_stored(
+        &mut self,
+        iter: u32,
+        path: &Path,
+        case: &StoredCase,
+        log: &mut String,
+    ) -> Outcome {
+        let _ = writeln!(log, "Iteration {}: Replaying {}", iter, path.display());
+        self.run_case(iter, &case.proto, &case.names, &case.texts, log)
+    }
 
-            eprintln!(
-                "Iteration {}: Testing message {} ({} bytes text)",
-                iter,
-                full_name,
-                text_format.len()
-            );
+    /// Cross-check every message value (full name, text format) of the
+    /// schema `proto`.
+    fn run_case(
+        &mut self,
+        iter: u32,
+        proto: &str,
+        names: &[String],
+        texts: &[String],
+        log: &mut String,
+    ) -> Outcome {
+        let proto_path = self.temp_dir.path().join("test.proto");
+        fs::write(&proto_path, proto).expect("Failed to write proto file");
+
+        // Hot schemas run on a specialized compiled harness, if enabled.
+        let mut specialized = self.specialized_harness(proto, log);
+        let cpp = specialized.as_mut().unwrap_or(&mut self.cpp);
+        let outcome = cross_check(
+            cpp,
+            &mut self.go,
+            iter,
+            proto,
+            &proto_path,
+            names,
+            texts,
+            log,
+        );
+
+        if let (Some(mut harness), Some(total)) = (specialized, self.specialized_stats.as_mut()) {
+            if let Some(stats) = harness.stats() {
+                total.merge(&stats);
+            }
+        }
+        outcome
+    }
 
-            // Run C++ harness
-            let cpp_result = run_harness(
-                &cpp_harness,
+    /// Shrink the failing `test_case` to its canonical form with one failing
+    /// message value and only the fields it still fails with, greedily.
+    /// Each candidate runs on freshly spawned harnesses, so a server the
+    /// failure left broken can't make every candidate fail.
+    fn minimize(&self, iter: u32, test_case: &TestCase) -> StoredCase {
+        let proto_path = self.temp_dir.path().join("minimize.proto");
+        let mut cpp = Harness::Spawn(&self.config.cpp_harness, None);
+        let mut go = Harness::Spawn(&self.config.go_harness, None);
+        let mut fails = |case: &TestCase| {
+            let stored = StoredCase::from_test_case(case);
+            fs::write(&proto_path, &stored.proto).expect("Failed to write proto file");
+            let outcome = cross_check(
+                &mut cpp,
+                &mut go,
+                iter,
+                &stored.proto,
                 &proto_path,
-                &full_name,
-                &text_format,
-                "encode",
+                &stored.names,
+                &stored.texts,
+                &mut String::new(),
             );
+            outcome == Outcome::Failed
+        };
 
-            // Run Go harness
-            let go_result =
-                run_harness(&go_harness, &proto_path, &full_name, &text_format, "encode");
-
-            match (&cpp_result, &go_result) {
-                (Ok(cpp_bytes), Ok(go_bytes)) => {
-                    // Both succeeded - compare outputs
-                    // Note: Field ordering may differ, so we decode and re-compare
-                    if cpp_bytes != go_bytes {
-                        eprintln!(
-                            "  Binary outputs differ ({} vs {} bytes)",
-                            cpp_bytes.len(),
-                            go_bytes.len()
-                        );
-                        eprintln!("  C++: {:?}", cpp_bytes);
-                        eprintln!("  Go:  {:?}", go_bytes);
-
-                        // Try decoding each with the other harness to verify semantic equivalence
-                        let cpp_decoded =
-                            run_harness_decode(&go_harness, &proto_path, &full_name, cpp_bytes);
-                        let go_decoded =
-                            run_harness_decode(&cpp_harness, &proto_path, &full_name, go_bytes);
-
-                        match (cpp_decoded, go_decoded) {
-                            (Ok(_), Ok(_)) => {
-                                eprintln!("  But both decode successfully with opposite harness (field ordering difference)");
-                            }
-                            (Err(e1), _) => {
-                                eprintln!("  ERROR: C++ output not decodable by Go: {}", e1);
-                                std::process::exit(1);
-                            }
-                            (_, Err(e2)) => {
-                                eprintln!("  ERROR: Go output not decodable by C++: {}", e2);
-                                std::process::exit(1);
-                            }
-                        }
-                    } else {
-                        eprintln!(
-                            "  OK: Both harnesses produced identical output ({} bytes)",
-                            cpp_bytes.len()
-                        );
-                    }
-                }
-                (Err(e), Ok(_)) => {
-                    eprintln!("  C++ harness failed: {}", e);
-                    eprintln!("  Proto:\n{}", test_case.to_proto());
-                    eprintln!("  Text format:\n{}", text_format);
-                    std::process::exit(1);
-                }
-                (Ok(_), Err(e)) => {
-                    eprintln!("  Go harness failed: {}", e);
-                    eprintln!("  Proto:\n{}", test_case.to_proto());
-                    eprintln!("  Text format:\n{}", text_format);
-                    std::process::exit(1);
-                }
-                (Err(e1), Err(e2)) => {
-                    eprintln!("  Both harnesses failed:");
-                    eprintln!("    C++: {}", e1);
-                    eprintln!("    Go:  {}", e2);
-                    eprintln!("  Proto:\n{}", test_case.to_proto());
-                    eprintln!("  Text format:\n{}", text_format);
-                    std::process::exit(1);
+        let mut case = test_case.canonical();
+        if !fails(&case) {
+            // Only the generated names trigger it; keep the case whole,
+            // names included, so that replaying it still fails.
+            return StoredCase::from_test_case_raw(test_case);
+        }
+        if case.values.len() > 1 {
+            let single = case.values.iter().find_map(|value| {
+                let trial = TestCase {
+                    schema: case.schema.clone(),
+                    values: vec![value.clone()],
+                };
+                fails(&trial).then_some(trial)
+            });
+            if let Some(single) = single {
+                case = single;
+            }
+        }
+        for i in 0..case.values.len() {
+            let fields: Vec<String> = case.values[i].1.fields.keys().cloned().collect();
+            for field in fields {
+                let mut trial = case.clone();
+                trial.values[i].1.fields.remove(&field);
+                if fails(&trial) {
+                    case = trial;
                 }
             }
         }
+        StoredCase::from_test_case(&case)
+    }
+
+    /// The specialized harness for `proto`, when `--specialize` is on and
+    /// the schema has one.
+    fn specialized_harness(&self, proto: &str, log: &mut String) -> Option<Harness<'a>> {
+        let specialized = self.config.specialize.as_ref()?;
+        match specialized.lookup(proto) {
+            Ok(binary) => binary.map(|binary| {
+                Harness::Compiled(binary, self.config.stats.then(HarnessStats::default))
+            }),
+            Err(e) => {
+                let _ = writeln!(log, "{}", e);
+                None
+            }
+        }
     }
 
-    eprintln!("\nAll {} iterations passed!", iterations);
+    /// Everything the worker's C++ harnesses measured with `--stats`.
+    fn stats(&mut self) -> Option<HarnessStats> {
+        let mut stats = self.cpp.stats()?;
+        if let Some(specialized) = &self.specialized_stats {
+            stats.merge(specialized);
+        }
+        Some(stats)
+    }
+}
+
+/// Encode every value in `items` (message name, text format) with both
+/// harnesses and compare, cross-decoding outputs that differ.
+fn cross_check(
+    cpp: &mut Harness,
+    go: &mut Harness,
+    iter: u32,
+    proto: &str,
+    proto_path: &Path,
+    names: &[String],
+    texts: &[String],
+    log: &mut String,
+) -> Outcome {
+    let items: Vec<(&str, &[u8])> = names
+        .iter()
+        .zip(texts)
+        .map(|(name, text)| (name.as_str(), text.as_bytes()))
+        .collect();
+
+    // Encode every message type with each harness in one batch
+    let batches = cpp
+        .call_batch("encode", proto, proto_path, &items)
+        .map_err(|e| format!("  C++ harness batch failed: {}", e))
+        .and_then(|cpp| {
+            go.call_batch("encode", proto, proto_path, &items)
+                .map(|go| (cpp, go))
+                .map_err(|e| format!("  Go harness batch failed: {}", e))
+        });
+    let (cpp_results, go_results) = match batches {
+        Ok(results) => results,
+        Err(failure) => {
+            let _ = writeln!(log, "Iteration {}:\n{}", iter, failure);
+            let _ = writeln!(log, "  Proto:\n{}", proto);
+            return Outcome::Failed;
+        }
+    };
+
+    // Test each message type
+    for (i, (full_name, text_format)) in names.iter().zip(texts).enumerate() {
+        let _ = writeln!(
+            log,
+            "Iteration {}: Testing message {} ({} bytes text)",
+            iter,
+            full_name,
+            text_format.len()
+        );
+
+        let failure = match (&cpp_results[i], &go_results[i]) {
+            (Ok(cpp_bytes), Ok(go_bytes)) if cpp_bytes == go_bytes => {
+                let _ = writeln!(
+                    log,
+                    "  OK: Both harnesses produced identical output ({} bytes)",
+                    cpp_bytes.len()
+                );
+                continue;
+            }
+            (Ok(cpp_bytes), Ok(go_bytes)) => {
+                // Field ordering may differ, so decode each with the other
+                // harness to verify semantic equivalence
+                let _ = writeln!(
+                    log,
+                    "  Binary outputs differ ({} vs {} bytes)",
+                    cpp_bytes.len(),
+                    go_bytes.len()
+                );
+                let _ = writeln!(log, "  C++: {:?}", cpp_bytes);
+                let _ = writeln!(log, "  Go:  {:?}", go_bytes);
+
+                let cpp_decoded = go.call("decode", proto, proto_path, full_name, cpp_bytes);
+                let go_decoded = cpp.call("decode", proto, proto_path, full_name, go_bytes);
+
+                match (cpp_decoded, go_decoded) {
+                    (Ok(_), Ok(_)) => {
+                        let _ = writeln!(log, "  But both decode successfully with opposite harness (field ordering difference)");
+                        continue;
+                    }
+                    (Err(e1), _) => format!("  ERROR: C++ output not decodable by Go: {}", e1),
+                    (_, Err(e2)) => format!("  ERROR: Go output not decodable by C++: {}", e2),
+                }
+            }
+            (Err(e), Ok(_)) => format!("  C++ harness failed: {}", e),
+            (Ok(_), Err(e)) => format!("  Go harness failed: {}", e),
+            (Err(e1), Err(e2)) => {
+                format!("  Both harnesses failed:\n    C++: {}\n    Go:  {}", e1, e2)
+            }
+        };
+
+        let _ = writeln!(log, "{}", failure);
+        let _ = writeln!(log, "  Proto:\n{}", proto);
+        let _ = writeln!(log, "  Text format:\n{}", text_format);
+        return Outcome::Failed;
+    }
+
+    Outcome::Passed
 }
 
 fn run_harness(
-    harness_path: &PathBuf,
-    proto_path: &std::path::Path,
+    harness_path: &Path,
+    proto_path: &Path,
     message_name: &str,
-    text_input: &str,
+    input: &[u8],
     mode: &str,
+    stats: Option<&mut HarnessStats>,
 ) -> Result<Vec<u8>, String> {
     // Get the directory and filename for the proto file
-    let proto_dir = proto_path.parent().unwrap_or(std::path::Path::new("."));
+    let proto_dir = proto_path.parent().unwrap_or(Path::new("."));
     let proto_file = proto_path.file_name().unwrap().to_string_lossy();
 
     let mut cmd = Command::new(harness_path);
     cmd.arg(format!("--mode={}", mode))
         .arg(format!("--proto={}", proto_file))
         .arg(format!("--proto_path={}", proto_dir.display()))
-        .arg(format!("--message={}", message_name))
-        .stdin(Stdio::piped())
-        .stdout(Stdio::piped())
-        .stderr(Stdio::piped());
-
-    let mut child = cmd.spawn().map_err(|e| format!("Failed to spawn: {}", e))?;
-
-    // Write input
-    {
-        let stdin = child.stdin.as_mut().expect("Failed to get stdin");
-        stdin
-            .write_all(text_input.as_bytes())
-            .map_err(|e| format!("Failed to write: {}", e))?;
-    }
-
-    let output = child
-        .wait_with_output()
-        .map_err(|e| format!("Failed to wait: {}", e))?;
-
-    if !output.status.success() {
-        let stderr = String::from_utf8_lossy(&output.stderr);
-        return Err(format!("Exit {}: {}", output.status, stderr));
-    }
-
-    Ok(output.stdout)
+        .arg(format!("--message={}", message_name));
+    run_command(cmd, input, stats)
 }
 
-fn run_harness_decode(
-    harness_path: &PathBuf,
-    proto_path: &std::path::Path,
+/// Run a specialized `harness_compiled`, which has the schema built in.
+fn run_compiled(
+    binary: &Path,
     message_name: &str,
-    binary_input: &[u8],
-) -> Result<String, String> {
-    // Get the directory and filename for the proto file
-    let proto_dir = proto_path.parent().unwrap_or(std::path::Path::new("."));
-    let proto_file = proto_path.file_name().unwrap().to_string_lossy();
+    input: &[u8],
+    mode: &str,
+    stats: Option<&mut HarnessStats>,
+) -> Result<Vec<u8>, String> {
+    let mut cmd = Command::new(binary);
+    cmd.arg(format!("--mode={}", mode))
+        .arg(format!("--message={}", message_name));
+    run_command(cmd, input, stats)
+}
 
-    let mut cmd = Command::new(harness_path);
-    cmd.arg("--mode=decode")
-        .arg(format!("--proto={}", proto_file))
-        .arg(format!("--proto_path={}", proto_dir.display()))
-        .arg(format!("--message={}", message_name))
+/// Run a harness command on `input`, returning its stdout. With `stats`, the
+/// harness runs with `--stats=json` and its totals are added there.
+fn run_command(
+    mut cmd: Command,
+    input: &[u8],
+    stats: Option<&mut HarnessStats>,
+) -> Result<Vec<u8>, String> {
+    cmd.args(stats.is_some().then_some("--stats=json"))
         .stdin(Stdio::piped())
         .stdout(Stdio::piped())
         .stderr(Stdio::piped());
 
     let mut child = cmd.spawn().map_err(|e| format!("Failed to spawn: {}", e))?;
 
+    // Write input
     {
         let stdin = child.stdin.as_mut().expect("Failed to get stdin");
         stdin
-            .write_all(binary_input)
+            .write_all(input)
             .map_err(|e| format!("Failed to write: {}", e))?;
     }
 
@@ -306,5 +892,11 @@ fn run_harness_decode(
         return Err(format!("Exit {}: {}", output.status, stderr));
     }
 
-    Ok(String::from_utf8_lossy(&output.stdout).to_string())
+    if let Some(stats) = stats {
+        if let Some(process) = HarnessStats::from_stderr(&String::from_utf8_lossy(&output.stderr)) {
+            stats.merge(&process);
+        }
+    }
+
+    Ok(output.stdout)
 }
@@ -0,0 +1,269 @@
+//! Benchmark runner that records results per commit and CPU and flags
+//! regressions.
+//!
+//! Runs protomon's criterion benches (`cargo bench -p protomon`) and, given a
+//! harness and a corpus, the C++ compiled harness's `--mode=bench` on every
+//! payload of that corpus. It then appends the results to a JSON Lines
+//! history, one run per line keyed by `git describe --always --dirty` and CPU
+//! model. The run is compared with the latest earlier run of another commit
+//! on the same CPU, and every benchmark whose mean moved significantly
+//! (Welch's t-test at 95%) and by more than `--noise` is printed. The
+//! runner exits with status 1 if a protomon benchmark regressed.
+//!
+//! The C++ results are the reference: protomon changes don't move them, so
+//! their median change is reported as the machine's own drift between the
+//! two runs.
+//!
+//! Usage:
+//!   cargo run --release -p protomon-fuzz --bin perf_history -- \
+//!     --corpus protomon-conformance/bench_corpus \
+//!     --cpp-harness protomon-fuzz/harness/bazel-bin/cpp/harness_compiled_conformance
+//!
+//! The corpus is a `generate_binaries --synthesize` output. Its `tests.txt`
+//! names each payload's message type, and it is also passed to the benches
+//! that read one (`PROTOMON_VARINT_CORPUS` for `leb128`).
+
+use std::collections::BTreeMap;
+use std::env;
+use std::ffi::OsStr;
+use std::fs;
+use std::io::Write as _;
+use std::path::{Path, PathBuf};
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use protomon_fuzz::{
+    bench_cpp_harness, compare, cpu_model, git_describe, reference_drift, run_criterion_bench,
+    split_list, workspace_dirs, PerfRun,
+};
+
+/// protomon's criterion benches, in `protomon/benches`.
+const DEFAULT_BENCHES: &str = "codec,packed,leb128,key";
+
+struct Config {
+    history: PathBuf,
+    benches: Vec<String>,
+    corpus: Option<PathBuf>,
+    cpp_harness: Option<PathBuf>,
+    cpp_runs: usize,
+    baseline: Option<String>,
+    noise: f64,
+    compare_only: bool,
+    verbose: bool,
+}
+
+fn main() {
+    let (workspace, target_dir) = workspace_dirs();
+    let config = parse_args(&target_dir);
+
+    let history_text = fs::read_to_string(&config.history).unwrap_or_default();
+    let mut history = PerfRun::parse_history(&history_text).unwrap_or_else(|line| {
+        eprintln!("{}:{}: not a benchmark run", config.history.display(), line);
+        std::process::exit(1);
+    });
+
+    let current = if config.compare_only {
+        let latest = history.iter().rposition(|run| run.variant.is_none());
+        latest.map(|i| history.remove(i)).unwrap_or_else(|| {
+            eprintln!("No runs recorded in {}", config.history.display());
+            std::process::exit(1);
+        })
+    } else {
+        let run = measure(&config, &workspace, &target_dir);
+        if let Err(e) = append_run(&config.history, &run) {
+            eprintln!("Failed to write {}: {}", config.history.display(), e);
+            std::process::exit(1);
+        }
+        eprintln!(
+            "Recorded {} benchmarks for {} on {} in {}",
+            run.results.len(),
+            run.commit,
+            run.cpu,
+            config.history.display()
+        );
+        run
+    };
+
+    let Some(baseline) = PerfRun::find_baseline(
+        &history,
+        &current.cpu,
+        &current.commit,
+        config.baseline.as_deref(),
+    ) else {
+        eprintln!("No baseline run on this CPU to compare with");
+        return;
+    };
+
+    let changes = compare(baseline, &current, config.noise);
+    println!(
+        "{} vs {} on {}: {} benchmarks in common",
+        current.commit,
+        baseline.commit,
+        current.cpu,
+        changes.len()
+    );
+    if let Some(drift) = reference_drift(&changes) {
+        println!(
+            "C++ reference moved {:+.1}% (median); protomon changes of that size are the machine",
+            (drift - 1.0) * 100.0
+        );
+    }
+    for change in &changes {
+        if config.verbose || change.significant {
+            println!("  {}", change);
+        }
+    }
+
+    let regressions = changes
+        .iter()
+        .filter(|c| c.id.starts_with("rust/") && c.is_regression())
+        .count();
+    let improvements = changes
+        .iter()
+        .filter(|c| c.id.starts_with("rust/") && c.is_improvement())
+        .count();
+    println!(
+        "{} protomon regressions, {} improvements",
+        regressions, improvements
+    );
+    if regressions > 0 {
+        std::process::exit(1);
+    }
+}
+
+fn parse_args(target_dir: &Path) -> Config {
+    let args: Vec<String> = env::args().collect();
+    let mut config = Config {
+        history: target_dir.join("perf-history.jsonl"),
+        benches: split_list(DEFAULT_BENCHES),
+        corpus: None,
+        cpp_harness: None,
+        cpp_runs: 5,
+        baseline: None,
+        noise: 0.02,
+        compare_only: false,
+        verbose: false,
+    };
+
+    let mut i = 1;
+    while i < args.len() {
+        match args[i].as_str() {
+            "--history" => {
+                i += 1;
+                config.history = PathBuf::from(&args[i]);
+            }
+            "--benches" => {
+                i += 1;
+                config.benches = split_list(&args[i]);
+            }
+            "--corpus" => {
+                i += 1;
+                config.corpus = Some(PathBuf::from(&args[i]));
+            }
+            "--cpp-harness" => {
+                i += 1;
+                config.cpp_harness = Some(PathBuf::from(&args[i]));
+            }
+            "--cpp-runs" => {
+                i += 1;
+                config.cpp_runs = args[i].parse().expect("Invalid run count");
+            }
+            "--baseline" => {
+                i += 1;
+                config.baseline = Some(args[i].clone());
+            }
+            "--noise" => {
+                i += 1;
+                config.noise = args[i].parse().expect("Invalid noise threshold");
+            }
+            "--compare-only" => {
+                config.compare_only = true;
+            }
+            "--verbose" | "-v" => {
+                config.verbose = true;
+            }
+            "--help" | "-h" => {
+                eprintln!("Usage: perf_history [OPTIONS]");
+                eprintln!();
+                eprintln!("Options:");
+                eprintln!(
+                    "  --history PATH       Results file (default: target/perf-history.jsonl)"
+                );
+                eprintln!(
+                    "  --benches LIST       protomon benches to run (default: {})",
+                    DEFAULT_BENCHES
+                );
+                eprintln!("                       or \"\" for none");
+                eprintln!("  --corpus DIR         generate_binaries --synthesize corpus");
+                eprintln!(
+                    "  --cpp-harness PATH   harness_compiled_conformance, benched on the corpus"
+                );
+                eprintln!("  --cpp-runs N         Harness runs per payload (default: 5)");
+                eprintln!("  --baseline COMMIT    Compare with this commit's latest run");
+                eprintln!("                       (default: the latest run of another commit)");
+                eprintln!(
+                    "  --noise F            Smallest relative change to flag (default: 0.02)"
+                );
+                eprintln!("  --compare-only       Compare the latest recorded run without running");
+                eprintln!("  --verbose            Print every benchmark, not just changes");
+                eprintln!("  --help               Show this help");
+                std::process::exit(0);
+            }
+            _ => {
+                eprintln!("Unknown argument: {}", args[i]);
+                std::process::exit(1);
+            }
+        }
+        i += 1;
+    }
+
+    if config.cpp_harness.is_some() && config.corpus.is_none() {
+        eprintln!("--cpp-harness needs a --corpus to bench");
+        std::process::exit(1);
+    }
+    config
+}
+
+/// Run every configured benchmark and collect a new run.
+fn measure(config: &Config, workspace: &Path, target_dir: &Path) -> PerfRun {
+    let timestamp = SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .unwrap()
+        .as_secs();
+    let mut run = PerfRun {
+        commit: git_describe(workspace),
+        variant: None,
+        cpu: cpu_model(),
+        timestamp,
+        results: BTreeMap::new(),
+    };
+
+    let envs: Vec<(&str, &OsStr)> = config
+        .corpus
+        .iter()
+        .map(|corpus| ("PROTOMON_VARINT_CORPUS", corpus.as_os_str()))
+        .collect();
+    for bench in &config.benches {
+        eprintln!("Running protomon bench {}", bench);
+        for (id, summary) in run_criterion_bench(workspace, target_dir, bench, &envs) {
+            run.results.insert(format!("rust/{}", id), summary);
+        }
+    }
+
+    if let (Some(harness), Some(corpus)) = (&config.cpp_harness, &config.corpus) {
+        for (id, summary) in bench_cpp_harness(harness, corpus, config.cpp_runs) {
+            run.results.insert(format!("cpp/{}", id), summary);
+        }
+    }
+    run
+}
+
+fn append_run(history: &Path, run: &PerfRun) -> std::io::Result<()> {
+    if let Some(dir) = history.parent() {
+        fs::create_dir_all(dir)?;
+    }
+    let mut file = fs::OpenOptions::new()
+        .create(true)
+        .append(true)
+        .open(history)?;
+    writeln!(file, "{}", run.to_json())
+}
@@ -0,0 +1,275 @@
+//! Deduplicated on-disk corpus of differential test cases.
+//!
+//! `harness_test` draws test cases from a seeded PRNG with no coverage
+//! feedback, so the same schema and values come up again and again, each
+//! costing several C++ and Go harness calls. [`CaseCorpus`] hashes the
+//! schema and values of every case's [`TestCase::canonical`] form and
+//! reports repeats, so the runner can skip them. With a directory it also
+//! keeps each distinct case there, and each failing one (minimized by the
+//! runner) separately:
+//!
+//! ```text
+//! <dir>/distinct/<hash>/schema.proto
+//! <dir>/distinct/<hash>/messages.txt     one full message name per line
+//! <dir>/distinct/<hash>/value_<i>.txtpb  text format of message i
+//! <dir>/failing/<hash>/...
+//! ```
+//!
+//! A later campaign skips every case already in the directory, and
+//! `harness_test --replay <dir>` runs the stored cases in batch through the
+//! harness servers.
+
+use std::collections::HashSet;
+use std::fs;
+use std::io;
+use std::path::{Path, PathBuf};
+
+use crate::{SpecializedHarnesses, TestCase};
+
+/// Name of a stored case's schema file.
+const SCHEMA_FILE: &str = "schema.proto";
+
+/// Name of a stored case's file of message names.
+const MESSAGES_FILE: &str = "messages.txt";
+
+/// A test case as the harnesses see it: a schema, and one text format value
+/// per message.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StoredCase {
+    pub proto: String,
+    /// Full message names, e.g. `fuzz.test.Message0`.
+    pub names: Vec<String>,
+    /// The text format of each message in `names`.
+    pub texts: Vec<String>,
+}
+
+impl StoredCase {
+    /// The canonical form of `test_case`, as [`CaseCorpus`] stores it.
+    pub fn from_test_case(test_case: &TestCase) -> Self {
+        Self::from_test_case_raw(&test_case.canonical())
+    }
+
+    /// `test_case` exactly as generated, names included, for a failure its
+    /// canonical form does not reproduce.
+    pub fn from_test_case_raw(test_case: &TestCase) -> Self {
+        Self {
+            proto: test_case.to_proto(),
+            names: test_case
+                .values
+                .iter()
+                .map(|(name, _)| format!("{}.{}", test_case.schema.package, name))
+                .collect(),
+            texts: test_case
+                .values
+                .iter()
+                .map(|(_, value)| value.to_text_format())
+                .collect(),
+        }
+    }
+
+    /// A stable 64-bit hash of the case's schema and values, which names its
+    /// directory.
+    pub fn hash(&self) -> u64 {
+        let mut key = self.proto.clone();
+        for (name, text) in self.names.iter().zip(&self.texts) {
+            key.push_str(&format!("# {}\n{}\n", name, text));
+        }
+        SpecializedHarnesses::schema_hash(&key)
+    }
+
+    /// Write the case into `dir`, creating it.
+    pub fn write(&self, dir: &Path) -> io::Result<()> {
+        fs::create_dir_all(dir)?;
+        fs::write(dir.join(SCHEMA_FILE), &self.proto)?;
+        let mut names = self.names.join("\n");
+        names.push('\n');
+        fs::write(dir.join(MESSAGES_FILE), names)?;
+        for (i, text) in self.texts.iter().enumerate() {
+            fs::write(dir.join(format!("value_{}.txtpb", i)), text)?;
+        }
+        Ok(())
+    }
+
+    /// Read a case written by [`write`](Self::write).
+    pub fn read(dir: &Path) -> io::Result<Self> {
+        let proto = fs::read_to_string(dir.join(SCHEMA_FILE))?;
+        let names: Vec<String> = fs::read_to_string(dir.join(MESSAGES_FILE))?
+            .lines()
+            .filter(|line| !line.is_empty())
+            .map(String::from)
+            .collect();
+        let texts = (0..names.len())
+            .map(|i| fs::read_to_string(dir.join(format!("value_{}.txtpb", i))))
+            .collect::<io::Result<_>>()?;
+        Ok(Self {
+            proto,
+            names,
+            texts,
+        })
+    }
+
+    /// Every case under `path`: `path` itself if it is a case directory, and
+    /// otherwise every case directory below it, in path order.
+    pub fn read_all(path: &Path) -> io::Result<Vec<(PathBuf, Self)>> {
+        if path.join(SCHEMA_FILE).is_file() {
+            return Ok(vec![(path.to_path_buf(), Self::read(path)?)]);
+        }
+        let mut entries: Vec<PathBuf> = fs::read_dir(path)?
+            .map(|entry| entry.map(|entry| entry.path()))
+            .collect::<io::Result<_>>()?;
+        entries.sort();
+        let mut cases = Vec::new();
+        for entry in entries.into_iter().filter(|entry| entry.is_dir()) {
+            cases.extend(Self::read_all(&entry)?);
+        }
+        Ok(cases)
+    }
+}
+
+/// The cases a campaign has seen, by [`StoredCase::hash`], optionally kept
+/// on disk.
+pub struct CaseCorpus {
+    dir: Option<PathBuf>,
+    seen: HashSet<u64>,
+}
+
+impl CaseCorpus {
+    /// An empty in-memory corpus.
+    pub fn new() -> Self {
+        Self {
+            dir: None,
+            seen: HashSet::new(),
+        }
+    }
+
+    /// The corpus in `dir`, created if missing. Every case already stored
+    /// there counts as seen.
+    pub fn open(dir: PathBuf) -> io::Result<Self> {
+        let mut seen = HashSet::new();
+        for subdir in ["distinct", "failing"] {
+            fs::create_dir_all(dir.join(subdir))?;
+            for entry in fs::read_dir(dir.join(subdir))? {
+                let name = entry?.file_name();
+                if let Ok(hash) = u64::from_str_radix(&name.to_string_lossy(), 16) {
+                    seen.insert(hash);
+                }
+            }
+        }
+        Ok(Self {
+            dir: Some(dir),
+            seen,
+        })
+    }
+
+    /// Number of distinct cases seen, including those loaded from disk.
+    pub fn len(&self) -> usize {
+        self.seen.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.seen.is_empty()
+    }
+
+    /// Record `case`, storing it under `distinct/` if the corpus has a
+    /// directory. Returns false, storing nothing, if it was already seen.
+    pub fn insert(&mut self, case: &StoredCase) -> io::Result<bool> {
+        let hash = case.hash();
+        if !self.seen.insert(hash) {
+            return Ok(false);
+        }
+        if let Some(dir) = &self.dir {
+            case.write(&dir.join("distinct").join(format!("{:016x}", hash)))?;
+        }
+        Ok(true)
+    }
+
+    /// Store a failing (ideally minimized) case under `failing/`, returning
+    /// its directory, or `None` without a corpus directory.
+    pub fn record_failure(&mut self, case: &StoredCase) -> io::Result<Option<PathBuf>> {
+        let hash = case.hash();
+        self.seen.insert(hash);
+        let Some(dir) = &self.dir else {
+            return Ok(None);
+        };
+        let case_dir = dir.join("failing").join(format!("{:016x}", hash));
+        case.write(&case_dir)?;
+        Ok(Some(case_dir))
+    }
+}
+
+impl Default for CaseCorpus {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn case(value: &str) -> StoredCase {
+        StoredCase {
+            proto: "syntax = \"proto3\";\n\npackage fuzz.test;\n\nmessage Message0 {\n  string f0 = 1;\n}\n\n"
+                .to_string(),
+            names: vec!["fuzz.test.Message0".to_string()],
+            texts: vec![format!("f0: \"{}\"", value)],
+        }
+    }
+
+    #[test]
+    fn skips_repeats_and_persists_distinct_cases() {
+        let dir = tempfile::tempdir().unwrap();
+        let mut corpus = CaseCorpus::open(dir.path().to_path_buf()).unwrap();
+        assert!(corpus.insert(&case("a")).unwrap());
+        assert!(!corpus.insert(&case("a")).unwrap());
+        assert!(corpus.insert(&case("b")).unwrap());
+        let failing = corpus.record_failure(&case("c")).unwrap().unwrap();
+        assert_eq!(StoredCase::read(&failing).unwrap(), case("c"));
+
+        // A new campaign on the same directory has seen all three.
+        let mut reopened = CaseCorpus::open(dir.path().to_path_buf()).unwrap();
+        assert_eq!(reopened.len(), 3);
+        assert!(!reopened.insert(&case("b")).unwrap());
+        assert!(!reopened.insert(&case("c")).unwrap());
+
+        let stored: Vec<StoredCase> = StoredCase::read_all(dir.path())
+            .unwrap()
+            .into_iter()
+            .map(|(_, case)| case)
+            .collect();
+        assert_eq!(stored.len(), 3);
+        for value in ["a", "b", "c"] {
+            assert!(stored.contains(&case(value)));
+        }
+    }
+
+    #[test]
+    fn raw_case_keeps_generated_names() {
+        use arbitrary::Unstructured;
+
+        let data: Vec<u8> = (0..64).collect();
+        let test_case = TestCase::arbitrary(&mut Unstructured::new(&data)).unwrap();
+        let raw = StoredCase::from_test_case_raw(&test_case);
+        assert_eq!(raw.proto, test_case.to_proto());
+        for (stored, (name, _)) in raw.names.iter().zip(&test_case.values) {
+            assert_eq!(stored, &format!("fuzz.test.{}", name));
+        }
+        assert_eq!(raw.texts[0], test_case.values[0].1.to_text_format());
+        assert_ne!(raw, StoredCase::from_test_case(&test_case));
+
+        // A stored raw failure replays as generated.
+        let dir = tempfile::tempdir().unwrap();
+        let mut corpus = CaseCorpus::open(dir.path().to_path_buf()).unwrap();
+        let failing = corpus.record_failure(&raw).unwrap().unwrap();
+        assert_eq!(StoredCase::read(&failing).unwrap(), raw);
+    }
+
+    #[test]
+    fn in_memory_corpus_stores_nothing() {
+        let mut corpus = CaseCorpus::new();
+        assert!(corpus.insert(&case("a")).unwrap());
+        assert!(!corpus.insert(&case("a")).unwrap());
+        assert_eq!(corpus.record_failure(&case("b")).unwrap(), None);
+        assert_eq!(corpus.len(), 2);
+    }
+}
@@ -0,0 +1,280 @@
+//! Client for the harnesses' persistent `--mode=serve` protocol.
+//!
+//! Spawning the harness once per message means re-importing the schema and
+//! paying for a fork/exec every time. [`HarnessServer`] keeps one harness
+//! process alive and exchanges length-prefixed requests with it over its
+//! stdin/stdout instead. Each request carries its schema text, which the
+//! server compiles once and caches. The C++ and Go dynamic harnesses both
+//! speak it; see the protocol description in `harness/cpp/main.cpp`.
+
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::path::Path;
+use std::process::{Child, ChildStdin, ChildStdout, Command, Stdio};
+
+use crate::stats::HarnessStats;
+
+/// Status byte the server sends for a successful request.
+const STATUS_OK: u8 = 0;
+
+/// Verdict byte of a `binary_roundtrip` output whose canonical encoding
+/// equals the input.
+const CANONICAL_IDENTICAL: u8 = 1;
+
+/// The C++ canonical (deterministic) encoding of a binary input, as returned
+/// by the `binary_roundtrip` mode.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct CanonicalEncoding {
+    pub bytes: Vec<u8>,
+    /// Whether `bytes` is byte-for-byte the input.
+    pub matches_input: bool,
+}
+
+impl CanonicalEncoding {
+    /// Parse a `binary_roundtrip` output: a verdict byte followed by the
+    /// canonical bytes.
+    pub fn from_output(output: &[u8]) -> Result<Self, String> {
+        match output.split_first() {
+            Some((&verdict, bytes)) => Ok(Self {
+                bytes: bytes.to_vec(),
+                matches_input: verdict == CANONICAL_IDENTICAL,
+            }),
+            None => Err("Empty binary_roundtrip output".to_string()),
+        }
+    }
+}
+
+/// A long-lived C++ harness process running `--mode=serve`.
+pub struct HarnessServer {
+    child: Child,
+    stdin: Option<BufWriter<ChildStdin>>,
+    stdout: BufReader<ChildStdout>,
+}
+
+impl HarnessServer {
+    /// Spawn `harness_path` in serve mode.
+    pub fn spawn(harness_path: &Path) -> io::Result<Self> {
+        Self::spawn_with_args(harness_path, &[])
+    }
+
+    /// Spawn `harness_path` in serve mode with extra flags, such as
+    /// `--stats=json`.
+    pub fn spawn_with_args(harness_path: &Path, args: &[&str]) -> io::Result<Self> {
+        let mut child = Command::new(harness_path)
+            .arg("--mode=serve")
+            .args(args)
+            .stdin(Stdio::piped())
+            .stdout(Stdio::piped())
+            .stderr(Stdio::inherit())
+            .spawn()?;
+
+        let stdin = child.stdin.take().expect("stdin is piped");
+        let stdout = child.stdout.take().expect("stdout is piped");
+
+        Ok(Self {
+            child,
+            stdin: Some(BufWriter::new(stdin)),
+            stdout: BufReader::new(stdout),
+        })
+    }
+
+    /// Run `mode` ("encode", "decode" or "roundtrip") on `payload` as
+    /// `message` of the `.proto` source `schema`, returning the harness
+    /// output or its error message.
+    pub fn call(
+        &mut self,
+        mode: &str,
+        schema: &str,
+        message: &str,
+        payload: &[u8],
+    ) -> Result<Vec<u8>, String> {
+        self.try_call(mode, schema, message, payload)
+            .map_err(|e| format!("Harness server I/O error: {}", e))?
+    }
+
+    /// Reserialize binary `payload` with C++ and report whether its
+    /// canonical encoding is the payload itself, without any text format.
+    pub fn binary_roundtrip(
+        &mut self,
+        schema: &str,
+        message: &str,
+        payload: &[u8],
+    ) -> Result<CanonicalEncoding, String> {
+        CanonicalEncoding::from_output(&self.call("binary_roundtrip", schema, message, payload)?)
+    }
+
+    /// Run `mode` on every `(message, payload)` item in a single exchange,
+    /// returning one result per item. The outer error means the whole batch
+    /// failed: an unknown mode or schema, or a server I/O error.
+    pub fn call_batch(
+        &mut self,
+        mode: &str,
+        schema: &str,
+        items: &[(&str, &[u8])],
+    ) -> Result<Vec<Result<Vec<u8>, String>>, String> {
+        let mut payload = Vec::new();
+        write_batch(&mut payload, items)
+            .map_err(|e| format!("Failed to build batch request: {}", e))?;
+        let body = self.call(&format!("{}_batch", mode), schema, "", &payload)?;
+
+        let results =
+            read_batch_response(&body).map_err(|e| format!("Malformed batch response: {}", e))?;
+        if results.len() != items.len() {
+            return Err(format!(
+                "Batch response has {} results for {} items",
+                results.len(),
+                items.len()
+            ));
+        }
+        Ok(results)
+    }
+
+    /// The phase timings the server has collected so far. It must have
+    /// been spawned with `--stats=json`; only the C++ harness supports it.
+    pub fn stats(&mut self) -> Result<HarnessStats, String> {
+        let body = self.call("stats", "", "", &[])?;
+        HarnessStats::parse(&String::from_utf8_lossy(&body))
+            .ok_or_else(|| "Malformed stats response".to_string())
+    }
+
+    fn try_call(
+        &mut self,
+        mode: &str,
+        schema: &str,
+        message: &str,
+        payload: &[u8],
+    ) -> io::Result<Result<Vec<u8>, String>> {
+        let stdin = self.stdin.as_mut().expect("stdin is open until drop");
+        write_request(stdin, mode, schema, message, payload)?;
+        stdin.flush()?;
+        read_response(&mut self.stdout)
+    }
+}
+
+impl Drop for HarnessServer {
+    fn drop(&mut self) {
+        // Closing stdin is the server's signal to exit.
+        drop(self.stdin.take());
+        let _ = self.child.wait();
+    }
+}
+
+fn write_field<W: Write>(w: &mut W, data: &[u8]) -> io::Result<()> {
+    let len = u32::try_from(data.len())
+        .map_err(|_| io::Error::new(io::ErrorKind::InvalidInput, "request field too large"))?;
+    w.write_all(&len.to_le_bytes())?;
+    w.write_all(data)
+}
+
+/// Write one serve request: mode, schema, message name and payload.
+fn write_request<W: Write>(
+    w: &mut W,
+    mode: &str,
+    schema: &str,
+    message: &str,
+    payload: &[u8],
+) -> io::Result<()> {
+    write_field(w, mode.as_bytes())?;
+    write_field(w, schema.as_bytes())?;
+    write_field(w, message.as_bytes())?;
+    write_field(w, payload)
+}
+
+/// Write a batch payload: a message name and an input field per item.
+fn write_batch<W: Write>(w: &mut W, items: &[(&str, &[u8])]) -> io::Result<()> {
+    for (message, payload) in items {
+        write_field(w, message.as_bytes())?;
+        write_field(w, payload)?;
+    }
+    Ok(())
+}
+
+/// Split a batch response body into its per-item responses.
+fn read_batch_response(mut body: &[u8]) -> io::Result<Vec<Result<Vec<u8>, String>>> {
+    let mut results = Vec::new();
+    while !body.is_empty() {
+        results.push(read_response(&mut body)?);
+    }
+    Ok(results)
+}
+
+/// Read one serve response, mapping an error status to `Err(message)`.
+fn read_response<R: Read>(r: &mut R) -> io::Result<Result<Vec<u8>, String>> {
+    let mut header = [0u8; 5];
+    r.read_exact(&mut header)?;
+
+    let len = u32::from_le_bytes([header[1], header[2], header[3], header[4]]);
+    let mut body = vec![0u8; len as usize];
+    r.read_exact(&mut body)?;
+
+    if header[0] == STATUS_OK {
+        Ok(Ok(body))
+    } else {
+        Ok(Err(String::from_utf8_lossy(&body).into_owned()))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn request_framing() {
+        let mut buf = Vec::new();
+        write_request(&mut buf, "encode", "", "pkg.Msg", b"id: 1").unwrap();
+
+        let mut expected = Vec::new();
+        expected.extend_from_slice(&[6, 0, 0, 0]);
+        expected.extend_from_slice(b"encode");
+        expected.extend_from_slice(&[0, 0, 0, 0]);
+        expected.extend_from_slice(&[7, 0, 0, 0]);
+        expected.extend_from_slice(b"pkg.Msg");
+        expected.extend_from_slice(&[5, 0, 0, 0]);
+        expected.extend_from_slice(b"id: 1");
+        assert_eq!(buf, expected);
+    }
+
+    #[test]
+    fn batch_framing() {
+        let mut buf = Vec::new();
+        write_batch(&mut buf, &[("", b"id: 1"), ("pkg.Other", b"")]).unwrap();
+
+        let mut expected = Vec::new();
+        expected.extend_from_slice(&[0, 0, 0, 0]);
+        expected.extend_from_slice(&[5, 0, 0, 0]);
+        expected.extend_from_slice(b"id: 1");
+        expected.extend_from_slice(&[9, 0, 0, 0]);
+        expected.extend_from_slice(b"pkg.Other");
+        expected.extend_from_slice(&[0, 0, 0, 0]);
+        assert_eq!(buf, expected);
+
+        let body = [0, 1, 0, 0, 0, 0x2a, 1, 1, 0, 0, 0, b'x'];
+        assert_eq!(
+            read_batch_response(&body).unwrap(),
+            vec![Ok(vec![0x2a]), Err("x".to_string())]
+        );
+        assert!(read_batch_response(&body[..3]).is_err());
+    }
+
+    #[test]
+    fn canonical_encoding() {
+        assert_eq!(
+            CanonicalEncoding::from_output(&[1, 0x08, 0x05]),
+            Ok(CanonicalEncoding {
+                bytes: vec![0x08, 0x05],
+                matches_input: true,
+            })
+        );
+        assert!(!CanonicalEncoding::from_output(&[0]).unwrap().matches_input);
+        assert!(CanonicalEncoding::from_output(&[]).is_err());
+    }
+
+    #[test]
+    fn response_framing() {
+        let data = [0, 2, 0, 0, 0, 0x08, 0x01, 1, 3, 0, 0, 0, b'b', b'a', b'd'];
+        let mut r = &data[..];
+
+        assert_eq!(read_response(&mut r).unwrap(), Ok(vec![0x08, 0x01]));
+        assert_eq!(read_response(&mut r).unwrap(), Err("bad".to_string()));
+        assert!(read_response(&mut r).is_err());
+    }
+}
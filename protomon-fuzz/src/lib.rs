@@ -24,8 +24,26 @@
 //! }
 //! ```
 
+mod corpus;
+mod harness;
+#[cfg(feature = "cpp-oracle")]
+mod oracle;
+mod perf;
+mod specialize;
+mod stats;
 mod value;
 
+pub use corpus::{CaseCorpus, StoredCase};
+pub use harness::{CanonicalEncoding, HarnessServer};
+#[cfg(feature = "cpp-oracle")]
+pub use oracle::Oracle;
+pub use perf::{
+    bench_cpp_harness, compare, cpu_model, criterion_outputs, git_describe, read_criterion_result,
+    reference_drift, run_criterion_bench, split_list, workspace_dirs, Change, Json, PerfRun,
+    Summary,
+};
+pub use specialize::SpecializedHarnesses;
+pub use stats::HarnessStats;
 pub use value::{FieldValue, MessageValue, ScalarValue, TestCase};
 
 use arbitrary::{Arbitrary, Unstructured};
@@ -0,0 +1,162 @@
+//! In-process C++ protobuf oracle over the harness's C ABI (`harness/cpp/oracle.h`).
+//!
+//! [`HarnessServer`](crate::HarnessServer) still pays for a pipe round trip
+//! and, usually, a text format parse per message. [`Oracle`] links C++
+//! protobuf into the fuzzer itself and calls the same dynamic-message code
+//! directly, which keeps a libFuzzer target comparing against C++ at native
+//! speed. Available with the `cpp-oracle` feature; see `build.rs` for how to
+//! build and link the library.
+
+use std::ffi::{c_char, c_int, CString};
+use std::ptr::NonNull;
+
+/// Status code for a successful call.
+const PROTOMON_ORACLE_OK: c_int = 0;
+
+#[repr(C)]
+struct RawOracle {
+    _private: [u8; 0],
+}
+
+extern "C" {
+    fn protomon_oracle_new(
+        proto_path: *const c_char,
+        schema_cache_entries: usize,
+    ) -> *mut RawOracle;
+    fn protomon_oracle_free(oracle: *mut RawOracle);
+    fn protomon_oracle_call(
+        oracle: *mut RawOracle,
+        mode: *const c_char,
+        schema: *const c_char,
+        schema_len: usize,
+        message: *const c_char,
+        message_len: usize,
+        input: *const u8,
+        input_len: usize,
+        output: *mut *const u8,
+        output_len: *mut usize,
+    ) -> c_int;
+}
+
+/// A C++ protobuf instance with its own schema cache and arena.
+pub struct Oracle {
+    raw: NonNull<RawOracle>,
+}
+
+// The oracle has no thread affinity; it only must not be used concurrently,
+// which `&mut self` on every call already rules out.
+unsafe impl Send for Oracle {}
+
+impl Oracle {
+    /// Number of compiled schemas an oracle keeps by default.
+    pub const DEFAULT_SCHEMA_CACHE_ENTRIES: usize = 64;
+
+    /// Create an oracle that resolves schema imports from `proto_path`.
+    pub fn new(proto_path: &str) -> Self {
+        let proto_path = CString::new(proto_path).expect("proto_path contains a NUL byte");
+        let raw =
+            unsafe { protomon_oracle_new(proto_path.as_ptr(), Self::DEFAULT_SCHEMA_CACHE_ENTRIES) };
+        Self {
+            raw: NonNull::new(raw).expect("protomon_oracle_new failed to allocate"),
+        }
+    }
+
+    /// Run `mode` ("encode", "decode", "roundtrip", "reencode" or
+    /// "binary_roundtrip") on `input` as `message` of the `.proto` source
+    /// `schema`. The output borrows the oracle until the next call.
+    pub fn call(
+        &mut self,
+        mode: &str,
+        schema: &str,
+        message: &str,
+        input: &[u8],
+    ) -> Result<&[u8], String> {
+        let mode = CString::new(mode).map_err(|_| "mode contains a NUL byte".to_string())?;
+        let mut output: *const u8 = std::ptr::null();
+        let mut output_len = 0usize;
+        let status = unsafe {
+            protomon_oracle_call(
+                self.raw.as_ptr(),
+                mode.as_ptr(),
+                schema.as_ptr().cast(),
+                schema.len(),
+                message.as_ptr().cast(),
+                message.len(),
+                input.as_ptr(),
+                input.len(),
+                &mut output,
+                &mut output_len,
+            )
+        };
+
+        // The bytes live in the oracle until its next call, which needs
+        // `&mut self` and so cannot overlap this borrow.
+        let bytes = if output_len == 0 {
+            &[][..]
+        } else {
+            unsafe { std::slice::from_raw_parts(output, output_len) }
+        };
+        if status == PROTOMON_ORACLE_OK {
+            Ok(bytes)
+        } else {
+            Err(String::from_utf8_lossy(bytes).into_owned())
+        }
+    }
+}
+
+impl Drop for Oracle {
+    fn drop(&mut self) {
+        unsafe { protomon_oracle_free(self.raw.as_ptr()) }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const SCHEMA: &str = "syntax = \"proto3\";\npackage oracle.test;\nmessage M {\n  int32 a = 1;\n  string s = 2;\n}\n";
+
+    #[test]
+    fn encode_then_decode() {
+        let mut oracle = Oracle::new(".");
+        let binary = oracle
+            .call("encode", SCHEMA, "oracle.test.M", b"a: 150 s: \"hi\"")
+            .unwrap()
+            .to_vec();
+        assert_eq!(binary, [0x08, 0x96, 0x01, 0x12, 0x02, b'h', b'i']);
+
+        // The next call reuses the oracle's output buffer.
+        let text = oracle
+            .call("decode", SCHEMA, "oracle.test.M", &binary)
+            .unwrap();
+        let text = String::from_utf8_lossy(text);
+        assert!(text.contains("a: 150"), "{}", text);
+        assert!(text.contains("s: \"hi\""), "{}", text);
+
+        let verdict = oracle
+            .call("binary_roundtrip", SCHEMA, "oracle.test.M", &binary)
+            .unwrap();
+        assert_eq!(verdict[0], 1);
+        assert_eq!(&verdict[1..], &binary[..]);
+    }
+
+    #[test]
+    fn bad_schema_is_an_error() {
+        let mut oracle = Oracle::new(".");
+        let error = oracle
+            .call(
+                "encode",
+                "syntax = \"proto3\";\nmessage {",
+                "oracle.test.M",
+                b"a: 1",
+            )
+            .unwrap_err();
+        assert!(!error.is_empty());
+
+        // A failed call leaves the oracle usable.
+        let binary = oracle
+            .call("encode", SCHEMA, "oracle.test.M", b"a: 1")
+            .unwrap();
+        assert_eq!(binary, [0x08, 0x01]);
+    }
+}
@@ -0,0 +1,916 @@
+//! Benchmark history, for tracking performance across commits.
+//!
+//! `perf_history` times protomon's criterion benches and the C++ harness's
+//! `--mode=bench` on the same machine and appends one [`PerfRun`] per
+//! invocation to a JSON Lines history file: the commit, the CPU model, and a
+//! [`Summary`] of the per-sample times of every benchmark. [`compare`] then
+//! checks a run against an earlier one on the same CPU and flags the
+//! benchmarks whose change is both statistically significant (Welch's
+//! t-test) and larger than a noise threshold.
+//!
+//! Benchmark ids are prefixed by where they came from: `rust/<criterion id>`
+//! and `cpp/<test case>/<op>`. The C++ numbers don't depend on protomon's
+//! code, so they are the reference: when they move too, the machine changed,
+//! not protomon.
+
+use std::collections::BTreeMap;
+use std::ffi::OsStr;
+use std::fmt;
+use std::fs;
+use std::io::Write as _;
+use std::path::{Path, PathBuf};
+use std::process::{Command, Stdio};
+use std::time::SystemTime;
+
+use crate::value::escape_json_string;
+
+/// Mean, standard deviation and count of a benchmark's samples, in
+/// nanoseconds per iteration.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct Summary {
+    pub mean_ns: f64,
+    pub std_dev_ns: f64,
+    pub samples: u64,
+}
+
+impl Summary {
+    /// Summarize per-iteration times. Returns `None` for no samples.
+    pub fn from_samples(samples_ns: &[f64]) -> Option<Self> {
+        if samples_ns.is_empty() {
+            return None;
+        }
+        let n = samples_ns.len() as f64;
+        let mean_ns = samples_ns.iter().sum::<f64>() / n;
+        let variance = if samples_ns.len() > 1 {
+            samples_ns
+                .iter()
+                .map(|s| (s - mean_ns).powi(2))
+                .sum::<f64>()
+                / (n - 1.0)
+        } else {
+            0.0
+        };
+        Some(Self {
+            mean_ns,
+            std_dev_ns: variance.sqrt(),
+            samples: samples_ns.len() as u64,
+        })
+    }
+
+    /// Summarize a criterion `sample.json`: each sample is `times[i]`
+    /// nanoseconds for `iters[i]` iterations.
+    pub fn from_criterion_sample(json: &str) -> Option<Self> {
+        let sample = Json::parse(json)?;
+        let iters = sample.get("iters")?.numbers()?;
+        let times = sample.get("times")?.numbers()?;
+        if iters.len() != times.len() || iters.iter().any(|&i| i <= 0.0) {
+            return None;
+        }
+        let per_iter: Vec<f64> = times.iter().zip(&iters).map(|(t, i)| t / i).collect();
+        Self::from_samples(&per_iter)
+    }
+}
+
+/// The results of one `perf_history` invocation.
+#[derive(Debug, Clone, PartialEq)]
+pub struct PerfRun {
+    /// `git describe --always --dirty` of the tree that was measured.
+    pub commit: String,
+    /// The `feature_matrix` variant the benches were built as, e.g. `avx2`,
+    /// or `None` for a plain `perf_history` build. Variant runs are never
+    /// picked as a baseline.
+    pub variant: Option<String>,
+    /// CPU model name, e.g. from `/proc/cpuinfo`.
+    pub cpu: String,
+    /// Seconds since the Unix epoch when the run started.
+    pub timestamp: u64,
+    pub results: BTreeMap<String, Summary>,
+}
+
+impl PerfRun {
+    /// One line of the history file.
+    pub fn to_json(&self) -> String {
+        let results: Vec<String> = self
+            .results
+            .iter()
+            .map(|(id, s)| {
+                format!(
+                    "\"{}\":{{\"mean_ns\":{},\"std_dev_ns\":{},\"samples\":{}}}",
+                    escape_json_string(id),
+                    s.mean_ns,
+                    s.std_dev_ns,
+                    s.samples
+                )
+            })
+            .collect();
+        let variant = self
+            .variant
+            .as_ref()
+            .map(|variant| format!(",\"variant\":\"{}\"", escape_json_string(variant)))
+            .unwrap_or_default();
+        format!(
+            "{{\"commit\":\"{}\"{},\"cpu\":\"{}\",\"timestamp\":{},\"results\":{{{}}}}}",
+            escape_json_string(&self.commit),
+            variant,
+            escape_json_string(&self.cpu),
+            self.timestamp,
+            results.join(",")
+        )
+    }
+
+    /// Parse one line of the history file.
+    pub fn parse(line: &str) -> Option<Self> {
+        let run = Json::parse(line)?;
+        let Json::Object(results) = run.get("results")? else {
+            return None;
+        };
+        let results = results
+            .iter()
+            .map(|(id, s)| {
+                let summary = Summary {
+                    mean_ns: s.get("mean_ns")?.number()?,
+                    std_dev_ns: s.get("std_dev_ns")?.number()?,
+                    samples: s.get("samples")?.number()? as u64,
+                };
+                Some((id.clone(), summary))
+            })
+            .collect::<Option<_>>()?;
+        let variant = match run.get("variant") {
+            Some(variant) => Some(variant.string()?.to_string()),
+            None => None,
+        };
+        Some(Self {
+            commit: run.get("commit")?.string()?.to_string(),
+            variant,
+            cpu: run.get("cpu")?.string()?.to_string(),
+            timestamp: run.get("timestamp")?.number()? as u64,
+            results,
+        })
+    }
+
+    /// Parse a history file, skipping blank lines. Fails on the first line
+    /// that isn't a run, with its 1-based number.
+    pub fn parse_history(history: &str) -> Result<Vec<Self>, usize> {
+        history
+            .lines()
+            .enumerate()
+            .filter(|(_, line)| !line.trim().is_empty())
+            .map(|(i, line)| Self::parse(line).ok_or(i + 1))
+            .collect()
+    }
+
+    /// The latest run in `history` on `cpu` that measured a different commit
+    /// than `commit`, or the latest one of `baseline` if given. Runs of a
+    /// `feature_matrix` variant are skipped.
+    pub fn find_baseline<'a>(
+        history: &'a [PerfRun],
+        cpu: &str,
+        commit: &str,
+        baseline: Option<&str>,
+    ) -> Option<&'a PerfRun> {
+        history.iter().rev().find(|run| {
+            run.cpu == cpu
+                && run.variant.is_none()
+                && match baseline {
+                    Some(baseline) => run.commit == baseline,
+                    None => run.commit != commit,
+                }
+        })
+    }
+}
+
+/// How one benchmark moved between two runs.
+#[derive(Debug, Clone, PartialEq)]
+pub struct Change {
+    pub id: String,
+    pub baseline: Summary,
+    pub current: Summary,
+    /// Welch's t statistic; positive when `current` is slower.
+    pub t: f64,
+    /// Whether |t| exceeds the two-sided 95% critical value and the mean
+    /// moved by more than the noise threshold.
+    pub significant: bool,
+}
+
+impl Change {
+    /// How `id` moved from `baseline` to `current`, or `None` if the baseline
+    /// has no time to compare with. `noise` is the smallest relative change
+    /// worth flagging (0.02 for 2%).
+    pub fn new(id: &str, baseline: Summary, current: Summary, noise: f64) -> Option<Self> {
+        if baseline.mean_ns <= 0.0 {
+            return None;
+        }
+        let (t, df) = welch_t(&baseline, &current);
+        let moved = (current.mean_ns / baseline.mean_ns - 1.0).abs() > noise;
+        Some(Change {
+            id: id.to_string(),
+            baseline,
+            current,
+            t,
+            significant: moved && t.abs() > t_critical_95(df),
+        })
+    }
+
+    /// Current mean over baseline mean; above 1 is slower.
+    pub fn ratio(&self) -> f64 {
+        self.current.mean_ns / self.baseline.mean_ns
+    }
+
+    pub fn is_regression(&self) -> bool {
+        self.significant && self.t > 0.0
+    }
+
+    pub fn is_improvement(&self) -> bool {
+        self.significant && self.t < 0.0
+    }
+}
+
+impl fmt::Display for Change {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let verdict = if self.is_regression() {
+            "REGRESSION"
+        } else if self.is_improvement() {
+            "improved"
+        } else {
+            "no change"
+        };
+        write!(
+            f,
+            "{:<60} {:>12.1} ns -> {:>12.1} ns {:>+7.1}%  t={:>+7.2}  {}",
+            self.id,
+            self.baseline.mean_ns,
+            self.current.mean_ns,
+            (self.ratio() - 1.0) * 100.0,
+            self.t,
+            verdict
+        )
+    }
+}
+
+/// Compare every benchmark present in both runs, in id order. `noise` is
+/// the smallest relative change worth flagging (0.02 for 2%).
+pub fn compare(baseline: &PerfRun, current: &PerfRun, noise: f64) -> Vec<Change> {
+    current
+        .results
+        .iter()
+        .filter_map(|(id, &current)| Change::new(id, *baseline.results.get(id)?, current, noise))
+        .collect()
+}
+
+/// The median ratio of the `cpp/` benchmarks in `changes`, or `None` if
+/// there are none: how much the machine itself moved between the runs.
+pub fn reference_drift(changes: &[Change]) -> Option<f64> {
+    let mut ratios: Vec<f64> = changes
+        .iter()
+        .filter(|c| c.id.starts_with("cpp/"))
+        .map(Change::ratio)
+        .collect();
+    if ratios.is_empty() {
+        return None;
+    }
+    ratios.sort_by(f64::total_cmp);
+    Some(ratios[ratios.len() / 2])
+}
+
+/// Welch's t statistic for `b` against `a` and its Welch–Satterthwaite
+/// degrees of freedom.
+fn welch_t(a: &Summary, b: &Summary) -> (f64, f64) {
+    let va = a.std_dev_ns.powi(2) / a.samples.max(1) as f64;
+    let vb = b.std_dev_ns.powi(2) / b.samples.max(1) as f64;
+    let diff = b.mean_ns - a.mean_ns;
+    if va + vb == 0.0 {
+        // Noise-free samples: any difference is significant.
+        let t = if diff == 0.0 {
+            0.0
+        } else {
+            diff.signum() * f64::INFINITY
+        };
+        return (t, f64::INFINITY);
+    }
+    let t = diff / (va + vb).sqrt();
+    let df_denominator =
+        va.powi(2) / (a.samples.max(2) - 1) as f64 + vb.powi(2) / (b.samples.max(2) - 1) as f64;
+    (t, (va + vb).powi(2) / df_denominator)
+}
+
+/// Two-sided 95% critical value of Student's t with `df` degrees of freedom.
+fn t_critical_95(df: f64) -> f64 {
+    const TABLE: [f64; 30] = [
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160,
+        2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056,
+        2.052, 2.048, 2.045, 2.042,
+    ];
+    if df >= 30.0 {
+        return 1.96;
+    }
+    // Round down, which errs on the side of a larger critical value.
+    TABLE[(df.floor().max(1.0) as usize) - 1]
+}
+
+/// A parsed JSON value: just enough for criterion's output, the harness's
+/// bench lines and the history file.
+#[derive(Debug, Clone, PartialEq)]
+pub enum Json {
+    Null,
+    Bool(bool),
+    Number(f64),
+    String(String),
+    Array(Vec<Json>),
+    Object(BTreeMap<String, Json>),
+}
+
+impl Json {
+    /// Parse a complete JSON document.
+    pub fn parse(text: &str) -> Option<Self> {
+        let mut parser = JsonParser {
+            bytes: text.as_bytes(),
+            pos: 0,
+        };
+        let value = parser.value()?;
+        parser.skip_whitespace();
+        (parser.pos == parser.bytes.len()).then_some(value)
+    }
+
+    /// The member `key` of an object.
+    pub fn get(&self, key: &str) -> Option<&Json> {
+        match self {
+            Json::Object(members) => members.get(key),
+            _ => None,
+        }
+    }
+
+    pub fn number(&self) -> Option<f64> {
+        match self {
+            Json::Number(n) => Some(*n),
+            _ => None,
+        }
+    }
+
+    pub fn string(&self) -> Option<&str> {
+        match self {
+            Json::String(s) => Some(s),
+            _ => None,
+        }
+    }
+
+    /// The elements of an array of numbers.
+    pub fn numbers(&self) -> Option<Vec<f64>> {
+        match self {
+            Json::Array(elements) => elements.iter().map(Json::number).collect(),
+            _ => None,
+        }
+    }
+}
+
+struct JsonParser<'a> {
+    bytes: &'a [u8],
+    pos: usize,
+}
+
+impl JsonParser<'_> {
+    fn skip_whitespace(&mut self) {
+        while self
+            .bytes
+            .get(self.pos)
+            .is_some_and(u8::is_ascii_whitespace)
+        {
+            self.pos += 1;
+        }
+    }
+
+    fn peek(&mut self) -> Option<u8> {
+        self.skip_whitespace();
+        self.bytes.get(self.pos).copied()
+    }
+
+    fn expect(&mut self, byte: u8) -> Option<()> {
+        (self.peek()? == byte).then(|| self.pos += 1)
+    }
+
+    fn literal(&mut self, literal: &str, value: Json) -> Option<Json> {
+        let end = self.pos + literal.len();
+        (self.bytes.get(self.pos..end)? == literal.as_bytes()).then(|| {
+            self.pos = end;
+            value
+        })
+    }
+
+    fn value(&mut self) -> Option<Json> {
+        match self.peek()? {
+            b'n' => self.literal("null", Json::Null),
+            b't' => self.literal("true", Json::Bool(true)),
+            b'f' => self.literal("false", Json::Bool(false)),
+            b'"' => self.string().map(Json::String),
+            b'[' => {
+                self.pos += 1;
+                let mut elements = Vec::new();
+                if self.peek()? == b']' {
+                    self.pos += 1;
+                    return Some(Json::Array(elements));
+                }
+                loop {
+                    elements.push(self.value()?);
+                    match self.peek()? {
+                        b',' => self.pos += 1,
+                        b']' => break,
+                        _ => return None,
+                    }
+                }
+                self.pos += 1;
+                Some(Json::Array(elements))
+            }
+            b'{' => {
+                self.pos += 1;
+                let mut members = BTreeMap::new();
+                if self.peek()? == b'}' {
+                    self.pos += 1;
+                    return Some(Json::Object(members));
+                }
+                loop {
+                    self.peek()?;
+                    let key = self.string()?;
+                    self.expect(b':')?;
+                    members.insert(key, self.value()?);
+                    match self.peek()? {
+                        b',' => self.pos += 1,
+                        b'}' => break,
+                        _ => return None,
+                    }
+                }
+                self.pos += 1;
+                Some(Json::Object(members))
+            }
+            _ => self.number(),
+        }
+    }
+
+    fn number(&mut self) -> Option<Json> {
+        let start = self.pos;
+        while self
+            .bytes
+            .get(self.pos)
+            .is_some_and(|b| b.is_ascii_digit() || b"+-.eE".contains(b))
+        {
+            self.pos += 1;
+        }
+        let text = std::str::from_utf8(&self.bytes[start..self.pos]).ok()?;
+        text.parse().ok().map(Json::Number)
+    }
+
+    /// A string starting at the current position, which must be a quote.
+    fn string(&mut self) -> Option<String> {
+        if self.bytes.get(self.pos) != Some(&b'"') {
+            return None;
+        }
+        self.pos += 1;
+        let mut out = String::new();
+        loop {
+            let start = self.pos;
+            while !matches!(self.bytes.get(self.pos), Some(b'"' | b'\\') | None) {
+                self.pos += 1;
+            }
+            out.push_str(std::str::from_utf8(&self.bytes[start..self.pos]).ok()?);
+            match *self.bytes.get(self.pos)? {
+                b'"' => {
+                    self.pos += 1;
+                    return Some(out);
+                }
+                _ => {
+                    let escape = *self.bytes.get(self.pos + 1)?;
+                    self.pos += 2;
+                    match escape {
+                        b'"' => out.push('"'),
+                        b'\\' => out.push('\\'),
+                        b'/' => out.push('/'),
+                        b'n' => out.push('\n'),
+                        b'r' => out.push('\r'),
+                        b't' => out.push('\t'),
+                        b'b' => out.push('\u{8}'),
+                        b'f' => out.push('\u{c}'),
+                        b'u' => {
+                            let hex = std::str::from_utf8(self.bytes.get(self.pos..self.pos + 4)?);
+                            let code = u32::from_str_radix(hex.ok()?, 16).ok()?;
+                            self.pos += 4;
+                            // Surrogate pairs aren't needed for benchmark ids.
+                            out.push(char::from_u32(code)?);
+                        }
+                        _ => return None,
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Bytes each C++ harness measurement parses, so it takes about as long for
+/// every payload size.
+const CPP_BYTES_PER_RUN: usize = 64 << 20;
+
+/// Every criterion `new/` results directory under `dir`, with the time its
+/// `benchmark.json` was written. A bench run rewrites the ones it measured,
+/// so comparing two snapshots finds them.
+pub fn criterion_outputs(dir: &Path) -> BTreeMap<PathBuf, SystemTime> {
+    let mut outputs = BTreeMap::new();
+    let Ok(entries) = fs::read_dir(dir) else {
+        return outputs;
+    };
+    for entry in entries.flatten() {
+        let path = entry.path();
+        if !path.is_dir() {
+            continue;
+        }
+        if path.file_name().is_some_and(|name| name == "new") {
+            if let Ok(modified) =
+                fs::metadata(path.join("benchmark.json")).and_then(|m| m.modified())
+            {
+                outputs.insert(path, modified);
+            }
+        } else {
+            outputs.extend(criterion_outputs(&path));
+        }
+    }
+    outputs
+}
+
+/// The full id and [`Summary`] of the criterion benchmark whose results are
+/// in `dir`, a [`criterion_outputs`] directory.
+pub fn read_criterion_result(dir: &Path) -> Option<(String, Summary)> {
+    let json = Json::parse(&fs::read_to_string(dir.join("benchmark.json")).ok()?)?;
+    let id = json.get("full_id")?.string()?.to_string();
+    let summary =
+        Summary::from_criterion_sample(&fs::read_to_string(dir.join("sample.json")).ok()?)?;
+    Some((id, summary))
+}
+
+/// Run `cargo bench -p protomon --bench <bench>` in `workspace` with
+/// `target_dir` as its target directory and `envs` set, and return the
+/// [`Summary`] of every criterion benchmark it measured, by full id. A
+/// `RUSTFLAGS` in `envs` also unsets `CARGO_ENCODED_RUSTFLAGS`, which would
+/// take precedence over it.
+pub fn run_criterion_bench(
+    workspace: &Path,
+    target_dir: &Path,
+    bench: &str,
+    envs: &[(&str, &OsStr)],
+) -> BTreeMap<String, Summary> {
+    let criterion_dir = target_dir.join("criterion");
+    let before = criterion_outputs(&criterion_dir);
+    let mut cargo = Command::new(std::env::var_os("CARGO").unwrap_or_else(|| "cargo".into()));
+    cargo
+        .current_dir(workspace)
+        .args([
+            "bench", "-p", "protomon", "--bench", bench, "--", "--noplot",
+        ])
+        .env("CARGO_TARGET_DIR", target_dir)
+        .envs(envs.iter().copied());
+    if envs.iter().any(|&(key, _)| key == "RUSTFLAGS") {
+        cargo.env_remove("CARGO_ENCODED_RUSTFLAGS");
+    }
+    let status = cargo.status().expect("Failed to run cargo bench");
+    if !status.success() {
+        panic!("cargo bench --bench {} failed: {}", bench, status);
+    }
+
+    let mut results = BTreeMap::new();
+    for (dir, modified) in criterion_outputs(&criterion_dir) {
+        if before.get(&dir) == Some(&modified) {
+            continue;
+        }
+        match read_criterion_result(&dir) {
+            Some((id, summary)) => {
+                results.insert(id, summary);
+            }
+            None => eprintln!("Skipping unreadable criterion results in {}", dir.display()),
+        }
+    }
+    results
+}
+
+/// Bench every payload of `corpus` (a `generate_binaries --synthesize`
+/// output) with the C++ compiled harness's `--mode=bench`, `runs` times.
+/// Returns `<test case>/<op>` with one sample, the mean ns per message, per
+/// run.
+pub fn bench_cpp_harness(harness: &Path, corpus: &Path, runs: usize) -> BTreeMap<String, Summary> {
+    let manifest = fs::read_to_string(corpus.join("tests.txt"))
+        .unwrap_or_else(|e| panic!("Failed to read {}/tests.txt: {}", corpus.display(), e));
+    let mut results = BTreeMap::new();
+    for line in manifest
+        .lines()
+        .filter(|l| !l.is_empty() && !l.starts_with('#'))
+    {
+        let Some((name, message_type)) = line.split_once(' ') else {
+            panic!("Invalid line in tests.txt: {}", line);
+        };
+        let payload = fs::read(corpus.join(format!("{}.bin", name)))
+            .unwrap_or_else(|e| panic!("Failed to read {}.bin: {}", name, e));
+        // One varint-length-delimited record, the harness's stdin corpus.
+        let mut record = Vec::with_capacity(payload.len() + 10);
+        let mut len = payload.len() as u64;
+        while len >= 0x80 {
+            record.push(len as u8 | 0x80);
+            len >>= 7;
+        }
+        record.push(len as u8);
+        record.extend_from_slice(&payload);
+        let iterations = (CPP_BYTES_PER_RUN / (payload.len() + 64)).clamp(3, 10_000);
+
+        eprintln!("Running C++ harness bench on {}", name);
+        let mut samples: BTreeMap<String, Vec<f64>> = BTreeMap::new();
+        for _ in 0..runs {
+            let mut child = Command::new(harness)
+                .arg("--mode=bench")
+                .arg(format!("--message=conformance.{}", message_type))
+                .arg(format!("--iterations={}", iterations))
+                .arg("--warmup_iterations=1")
+                .stdin(Stdio::piped())
+                .stdout(Stdio::piped())
+                .spawn()
+                .unwrap_or_else(|e| panic!("Failed to spawn {}: {}", harness.display(), e));
+            child
+                .stdin
+                .take()
+                .expect("stdin is piped")
+                .write_all(&record)
+                .expect("Failed to write the corpus to the harness");
+            let output = child.wait_with_output().expect("Harness failed");
+            if !output.status.success() {
+                panic!("Harness bench failed on {}: {}", name, output.status);
+            }
+            for line in String::from_utf8_lossy(&output.stdout).lines() {
+                let Some(result) = Json::parse(line) else {
+                    continue;
+                };
+                let op = result.get("op").and_then(Json::string);
+                let per_sec = result.get("messages_per_sec").and_then(Json::number);
+                if let (Some(op), Some(per_sec)) = (op, per_sec) {
+                    if per_sec > 0.0 {
+                        samples
+                            .entry(op.to_string())
+                            .or_default()
+                            .push(1e9 / per_sec);
+                    }
+                }
+            }
+        }
+        for (op, ns) in samples {
+            if let Some(summary) = Summary::from_samples(&ns) {
+                results.insert(format!("{}/{}", name, op), summary);
+            }
+        }
+    }
+    results
+}
+
+/// The workspace root, and the target directory cargo builds it in:
+/// `CARGO_TARGET_DIR`, or the workspace's `target`.
+pub fn workspace_dirs() -> (PathBuf, PathBuf) {
+    let workspace = Path::new(env!("CARGO_MANIFEST_DIR"))
+        .parent()
+        .expect("protomon-fuzz is in the workspace")
+        .to_path_buf();
+    let target_dir = std::env::var_os("CARGO_TARGET_DIR")
+        .map(PathBuf::from)
+        .unwrap_or_else(|| workspace.join("target"));
+    (workspace, target_dir)
+}
+
+/// The entries of a comma-separated command-line list, without empty ones.
+pub fn split_list(list: &str) -> Vec<String> {
+    list.split(',')
+        .map(str::trim)
+        .filter(|s| !s.is_empty())
+        .map(String::from)
+        .collect()
+}
+
+/// `git describe --always --dirty` of the tree at `workspace`, or `unknown`
+/// outside a git checkout.
+pub fn git_describe(workspace: &Path) -> String {
+    Command::new("git")
+        .current_dir(workspace)
+        .args(["describe", "--always", "--dirty", "--abbrev=12"])
+        .output()
+        .ok()
+        .filter(|output| output.status.success())
+        .map(|output| String::from_utf8_lossy(&output.stdout).trim().to_string())
+        .unwrap_or_else(|| "unknown".to_string())
+}
+
+/// The CPU model, so results from different machines are never compared.
+pub fn cpu_model() -> String {
+    let from_cpuinfo = fs::read_to_string("/proc/cpuinfo")
+        .ok()
+        .and_then(|cpuinfo| {
+            cpuinfo.lines().find_map(|line| {
+                let (key, value) = line.split_once(':')?;
+                (key.trim() == "model name").then(|| value.trim().to_string())
+            })
+        });
+    let from_sysctl = || {
+        Command::new("sysctl")
+            .args(["-n", "machdep.cpu.brand_string"])
+            .output()
+            .ok()
+            .filter(|output| output.status.success())
+            .map(|output| String::from_utf8_lossy(&output.stdout).trim().to_string())
+    };
+    from_cpuinfo
+        .or_else(from_sysctl)
+        .filter(|model| !model.is_empty())
+        .unwrap_or_else(|| format!("unknown {}", std::env::consts::ARCH))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn summary(mean_ns: f64, std_dev_ns: f64, samples: u64) -> Summary {
+        Summary {
+            mean_ns,
+            std_dev_ns,
+            samples,
+        }
+    }
+
+    fn run(commit: &str, results: &[(&str, Summary)]) -> PerfRun {
+        PerfRun {
+            commit: commit.to_string(),
+            variant: None,
+            cpu: "Test CPU @ 3.0GHz".to_string(),
+            timestamp: 1_700_000_000,
+            results: results.iter().map(|(id, s)| (id.to_string(), *s)).collect(),
+        }
+    }
+
+    #[test]
+    fn summarizes_criterion_samples() {
+        let sample = r#"{"sampling_mode":"Linear","iters":[1.0,2.0,4.0],"times":[10.0,24.0,44.0]}"#;
+        let s = Summary::from_criterion_sample(sample).unwrap();
+        assert_eq!(s.samples, 3);
+        assert!((s.mean_ns - 11.0).abs() < 1e-9);
+        assert!((s.std_dev_ns - 1.0).abs() < 1e-9);
+
+        assert_eq!(
+            Summary::from_criterion_sample(r#"{"iters":[1.0],"times":[]}"#),
+            None
+        );
+        assert_eq!(
+            Summary::from_criterion_sample(r#"{"iters":[],"times":[]}"#),
+            None
+        );
+    }
+
+    #[test]
+    fn history_round_trips() {
+        let original = run(
+            "cc48d1c-dirty",
+            &[
+                ("rust/decode/\"quoted\"", summary(12.5, 0.25, 100)),
+                ("cpp/corpus/map_int64_10/parse", summary(3000.0, 40.0, 5)),
+            ],
+        );
+        let line = original.to_json();
+        assert!(!line.contains('\n'));
+        assert_eq!(PerfRun::parse(&line), Some(original.clone()));
+        assert_eq!(
+            PerfRun::parse_history(&format!("{}\n\n{}\n", line, line)),
+            Ok(vec![original.clone(), original])
+        );
+        assert_eq!(
+            PerfRun::parse_history(&format!("{}\nnot json\n", line)),
+            Err(2)
+        );
+    }
+
+    #[test]
+    fn variant_round_trips() {
+        let mut variant = run("cc48d1c", &[("rust/leb128", summary(4.0, 0.1, 100))]);
+        variant.variant = Some("avx2+bmi2".to_string());
+        let line = variant.to_json();
+        assert!(line.contains("\"variant\":\"avx2+bmi2\""));
+        assert_eq!(PerfRun::parse(&line), Some(variant));
+
+        // Runs recorded without a variant still parse.
+        let plain = run("cc48d1c", &[]);
+        assert!(!plain.to_json().contains("variant"));
+        assert_eq!(PerfRun::parse(&plain.to_json()), Some(plain));
+    }
+
+    #[test]
+    fn finds_baseline_on_same_cpu() {
+        let mut other_cpu = run("b", &[]);
+        other_cpu.cpu = "Other CPU".to_string();
+        let history = vec![run("a", &[]), run("b", &[]), other_cpu, run("c", &[])];
+        let cpu = "Test CPU @ 3.0GHz";
+
+        assert_eq!(
+            PerfRun::find_baseline(&history, cpu, "c", None)
+                .unwrap()
+                .commit,
+            "b"
+        );
+        assert_eq!(
+            PerfRun::find_baseline(&history, cpu, "d", None)
+                .unwrap()
+                .commit,
+            "c"
+        );
+        assert_eq!(
+            PerfRun::find_baseline(&history, cpu, "c", Some("a"))
+                .unwrap()
+                .commit,
+            "a"
+        );
+        assert_eq!(
+            PerfRun::find_baseline(&history, "Other CPU", "b", None),
+            None
+        );
+    }
+
+    #[test]
+    fn skips_variant_runs_as_baseline() {
+        let mut variant = run("b", &[]);
+        variant.variant = Some("avx2".to_string());
+        let history = vec![run("a", &[]), variant];
+        let cpu = "Test CPU @ 3.0GHz";
+
+        assert_eq!(
+            PerfRun::find_baseline(&history, cpu, "c", None)
+                .unwrap()
+                .commit,
+            "a"
+        );
+        assert_eq!(PerfRun::find_baseline(&history, cpu, "a", None), None);
+        assert_eq!(PerfRun::find_baseline(&history, cpu, "c", Some("b")), None);
+    }
+
+    #[test]
+    fn flags_significant_changes_only() {
+        let baseline = run(
+            "a",
+            &[
+                ("rust/slower", summary(100.0, 2.0, 100)),
+                ("rust/faster", summary(100.0, 2.0, 100)),
+                ("rust/noisy", summary(100.0, 50.0, 10)),
+                ("rust/tiny", summary(100.0, 0.1, 100)),
+                ("rust/removed", summary(100.0, 2.0, 100)),
+                ("cpp/case/parse", summary(200.0, 2.0, 5)),
+            ],
+        );
+        let current = run(
+            "b",
+            &[
+                ("rust/slower", summary(110.0, 2.0, 100)),
+                ("rust/faster", summary(90.0, 2.0, 100)),
+                ("rust/noisy", summary(130.0, 50.0, 10)),
+                ("rust/tiny", summary(101.0, 0.1, 100)),
+                ("rust/added", summary(100.0, 2.0, 100)),
+                ("cpp/case/parse", summary(202.0, 2.0, 5)),
+            ],
+        );
+
+        let changes = compare(&baseline, &current, 0.02);
+        let by_id: BTreeMap<&str, &Change> = changes.iter().map(|c| (c.id.as_str(), c)).collect();
+        assert_eq!(
+            by_id.keys().copied().collect::<Vec<_>>(),
+            vec![
+                "cpp/case/parse",
+                "rust/faster",
+                "rust/noisy",
+                "rust/slower",
+                "rust/tiny"
+            ]
+        );
+        assert!(by_id["rust/slower"].is_regression());
+        assert!(by_id["rust/faster"].is_improvement());
+        // A 30% change within the noise of 10 samples is not significant.
+        assert!(!by_id["rust/noisy"].significant);
+        // A significant 1% change is below the noise threshold.
+        assert!(!by_id["rust/tiny"].significant);
+        assert!((reference_drift(&changes).unwrap() - 1.01).abs() < 1e-9);
+    }
+
+    #[test]
+    fn parses_json() {
+        let value = Json::parse(r#" {"a": [1, -2.5e3, true, null], "b": {"c": "x\"\u0041\n"}} "#);
+        let value = value.unwrap();
+        assert_eq!(
+            value.get("a"),
+            Some(&Json::Array(vec![
+                Json::Number(1.0),
+                Json::Number(-2500.0),
+                Json::Bool(true),
+                Json::Null
+            ]))
+        );
+        assert_eq!(
+            value.get("b").unwrap().get("c").unwrap().string(),
+            Some("x\"A\n")
+        );
+
+        assert_eq!(Json::parse(""), None);
+        assert_eq!(Json::parse("{\"a\":1"), None);
+        assert_eq!(Json::parse("[1,]"), None);
+        assert_eq!(Json::parse("{} {}"), None);
+    }
+}
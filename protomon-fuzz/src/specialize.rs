@@ -0,0 +1,305 @@
+//! Schema-specialized C++ harnesses, built ahead of time for hot schemas.
+//!
+//! The dynamic C++ harness runs on `DynamicMessage` reflection, which is
+//! several times slower than generated code. When a campaign keeps hitting
+//! the same few schemas, [`SpecializedHarnesses`] notices one recurring,
+//! builds a `harness_compiled` binary for it with a build script (by
+//! default `harness/cpp/build_specialized.sh`, which runs `protoc --cpp_out`
+//! and `registry_gen`), and from then on hands that binary out for the
+//! schema. Schemas seen fewer times, or whose build failed, stay on the
+//! dynamic harness, and so does a schema while its build runs: builds run on
+//! background threads, so workers never wait for the compiler.
+//!
+//! Binaries are cached on disk under `<cache_dir>/<schema hash>/`, next to
+//! the schema they were built from, so later campaigns reuse them without
+//! waiting for the schema to recur again.
+
+use std::collections::HashMap;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::process::Command;
+use std::sync::{Arc, Mutex};
+use std::thread::{self, JoinHandle};
+
+/// Name of the schema file a build script is given, and kept in the cache.
+const SCHEMA_FILE: &str = "schema.proto";
+
+/// Name of the specialized binary in a cache entry.
+const BINARY_FILE: &str = "harness_compiled";
+
+/// How far a schema has got towards a specialized build.
+enum Entry {
+    /// Seen this many times, still below the threshold.
+    Counting(u32),
+    /// Being built on a background thread.
+    Building,
+    Built(PathBuf),
+    /// The build failed with this error, which has not been reported yet.
+    BuildFailed(String),
+    /// The build failed; the schema stays on the dynamic harness.
+    Failed,
+}
+
+/// On-disk cache of specialized harnesses, keyed by schema hash. Shared by
+/// every worker of a campaign.
+pub struct SpecializedHarnesses {
+    build_script: PathBuf,
+    cache_dir: PathBuf,
+    threshold: u32,
+    /// Most builds run at once; C++ compiles are heavy.
+    max_builds: usize,
+    schemas: Arc<Mutex<HashMap<u64, Entry>>>,
+    builds: Mutex<Vec<JoinHandle<()>>>,
+}
+
+impl SpecializedHarnesses {
+    /// Number of times a schema must be seen before it is built.
+    pub const DEFAULT_THRESHOLD: u32 = 3;
+
+    /// Cache builds of `build_script` in `cache_dir`, building a schema on
+    /// its `threshold`-th sighting. The script is run as
+    /// `build_script SCHEMA.proto OUTPUT` from the cache entry's directory.
+    pub fn new(build_script: PathBuf, cache_dir: PathBuf, threshold: u32) -> Self {
+        Self {
+            build_script,
+            cache_dir,
+            threshold: threshold.max(1),
+            max_builds: thread::available_parallelism().map_or(1, |n| n.get()),
+            schemas: Arc::new(Mutex::new(HashMap::new())),
+            builds: Mutex::new(Vec::new()),
+        }
+    }
+
+    /// A stable 64-bit FNV-1a hash of the schema text, used as its cache key.
+    pub fn schema_hash(schema: &str) -> u64 {
+        schema.bytes().fold(0xcbf2_9ce4_8422_2325, |hash, byte| {
+            (hash ^ u64::from(byte)).wrapping_mul(0x0100_0000_01b3)
+        })
+    }
+
+    /// Record one more case for `schema` and return its specialized harness,
+    /// if it has one: cached on disk or built by an earlier lookup. The
+    /// first lookup at the threshold with a build slot free starts its build
+    /// in the background and returns `None`, like every lookup until the
+    /// build lands. `Err` reports a failed build, once; the schema then stays
+    /// dynamic.
+    pub fn lookup(&self, schema: &str) -> Result<Option<PathBuf>, String> {
+        let hash = Self::schema_hash(schema);
+        let dir = self.cache_dir.join(format!("{:016x}", hash));
+        let mut schemas = self.schemas.lock().unwrap();
+        let building = schemas
+            .values()
+            .filter(|entry| matches!(entry, Entry::Building))
+            .count();
+        let entry = schemas
+            .entry(hash)
+            .or_insert_with(|| match cached_binary(&dir, schema) {
+                Some(binary) => Entry::Built(binary),
+                None => Entry::Counting(0),
+            });
+
+        match entry {
+            Entry::Built(binary) => Ok(Some(binary.clone())),
+            Entry::Building | Entry::Failed => Ok(None),
+            Entry::BuildFailed(e) => {
+                let e = format!("Specialized build for schema {:016x} failed: {}", hash, e);
+                *entry = Entry::Failed;
+                Err(e)
+            }
+            Entry::Counting(seen) => {
+                *seen = (*seen + 1).min(self.threshold);
+                // Past the threshold while every build slot is taken, the
+                // schema tries again on its next sighting.
+                if *seen < self.threshold || building >= self.max_builds {
+                    return Ok(None);
+                }
+                *entry = Entry::Building;
+                drop(schemas);
+
+                let schemas = Arc::clone(&self.schemas);
+                let build_script = self.build_script.clone();
+                let schema = schema.to_string();
+                let handle = thread::spawn(move || {
+                    let entry = match build(&build_script, &dir, &schema) {
+                        Ok(binary) => Entry::Built(binary),
+                        Err(e) => Entry::BuildFailed(e),
+                    };
+                    schemas.lock().unwrap().insert(hash, entry);
+                });
+                self.builds.lock().unwrap().push(handle);
+                Ok(None)
+            }
+        }
+    }
+
+    /// Number of schemas that currently have a specialized harness.
+    pub fn built(&self) -> usize {
+        self.count(|entry| matches!(entry, Entry::Built(_)))
+    }
+
+    /// Number of builds still running.
+    pub fn building(&self) -> usize {
+        self.count(|entry| matches!(entry, Entry::Building))
+    }
+
+    /// Wait for every build started so far, so its binary is cached for the
+    /// next lookup or campaign.
+    pub fn wait(&self) {
+        let builds = std::mem::take(&mut *self.builds.lock().unwrap());
+        for build in builds {
+            build.join().expect("specialized build thread panicked");
+        }
+    }
+
+    fn count(&self, filter: impl Fn(&Entry) -> bool) -> usize {
+        self.schemas
+            .lock()
+            .unwrap()
+            .values()
+            .filter(|entry| filter(entry))
+            .count()
+    }
+}
+
+/// The binary in cache entry `dir`, if there is one and it was built from
+/// exactly `schema` (guarding against hash collisions).
+fn cached_binary(dir: &Path, schema: &str) -> Option<PathBuf> {
+    let binary = dir.join(BINARY_FILE);
+    let cached_schema = fs::read_to_string(dir.join(SCHEMA_FILE)).ok()?;
+    (cached_schema == schema && binary.is_file()).then_some(binary)
+}
+
+/// Build `schema` into cache entry `dir`. The binary is written under a
+/// temporary name and renamed into place, so a concurrent campaign never
+/// runs a half-written one.
+fn build(build_script: &Path, dir: &Path, schema: &str) -> Result<PathBuf, String> {
+    fs::create_dir_all(dir).map_err(|e| format!("Failed to create {}: {}", dir.display(), e))?;
+    fs::write(dir.join(SCHEMA_FILE), schema)
+        .map_err(|e| format!("Failed to write schema: {}", e))?;
+
+    let binary = dir.join(BINARY_FILE);
+    let partial = dir.join(format!("{}.{}.tmp", BINARY_FILE, std::process::id()));
+    let output = Command::new(build_script)
+        .arg(SCHEMA_FILE)
+        .arg(&partial)
+        .current_dir(dir)
+        .output()
+        .map_err(|e| format!("Failed to run {}: {}", build_script.display(), e))?;
+    if !output.status.success() {
+        let _ = fs::remove_file(&partial);
+        return Err(format!(
+            "{} exited with {}:\n{}",
+            build_script.display(),
+            output.status,
+            String::from_utf8_lossy(&output.stderr)
+        ));
+    }
+
+    fs::rename(&partial, &binary).map_err(|e| format!("Failed to install binary: {}", e))?;
+    Ok(binary)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn schema_hash_is_stable() {
+        // FNV-1a test vectors; the hash names on-disk cache entries, so it
+        // must not change between builds or Rust versions.
+        assert_eq!(SpecializedHarnesses::schema_hash(""), 0xcbf2_9ce4_8422_2325);
+        assert_eq!(
+            SpecializedHarnesses::schema_hash("a"),
+            0xaf63_dc4c_8601_ec8c
+        );
+    }
+
+    #[test]
+    fn builds_on_threshold_and_reuses_cache() {
+        let cache = tempfile::tempdir().unwrap();
+        let script = cache.path().join("build.sh");
+        fs::write(
+            &script,
+            "#!/bin/sh\necho built >> ../builds\ncp \"$1\" \"$2\"\n",
+        )
+        .unwrap();
+        #[cfg(unix)]
+        {
+            use std::os::unix::fs::PermissionsExt;
+            fs::set_permissions(&script, fs::Permissions::from_mode(0o755)).unwrap();
+        }
+
+        let schema = "syntax = \"proto3\"; message M {}";
+        let harnesses = SpecializedHarnesses::new(script.clone(), cache.path().to_path_buf(), 2);
+        assert_eq!(harnesses.lookup(schema), Ok(None));
+        // The second sighting starts the build; the schema stays dynamic
+        // until it lands.
+        assert_eq!(harnesses.lookup(schema), Ok(None));
+        harnesses.wait();
+        assert_eq!(harnesses.building(), 0);
+        let binary = harnesses
+            .lookup(schema)
+            .unwrap()
+            .expect("built after the second sighting");
+        assert_eq!(fs::read_to_string(&binary).unwrap(), schema);
+        assert_eq!(harnesses.lookup(schema), Ok(Some(binary.clone())));
+        assert_eq!(harnesses.built(), 1);
+
+        // A fresh cache over the same directory picks the binary up at once.
+        let again = SpecializedHarnesses::new(script, cache.path().to_path_buf(), 2);
+        assert_eq!(again.lookup(schema), Ok(Some(binary)));
+        assert_eq!(
+            fs::read_to_string(cache.path().join("builds")).unwrap(),
+            "built\n"
+        );
+    }
+
+    #[test]
+    fn lookups_do_not_wait_for_builds() {
+        let cache = tempfile::tempdir().unwrap();
+        let script = cache.path().join("build.sh");
+        // Holds the build until the test creates `release`, for at most 10s.
+        fs::write(
+            &script,
+            "#!/bin/sh\nfor i in $(seq 1000); do [ -e ../release ] && break; sleep 0.01; done\ncp \"$1\" \"$2\"\n",
+        )
+        .unwrap();
+        #[cfg(unix)]
+        {
+            use std::os::unix::fs::PermissionsExt;
+            fs::set_permissions(&script, fs::Permissions::from_mode(0o755)).unwrap();
+        }
+
+        let mut harnesses = SpecializedHarnesses::new(script, cache.path().to_path_buf(), 1);
+        harnesses.max_builds = 1;
+        assert_eq!(harnesses.lookup("message A {}"), Ok(None));
+        assert_eq!(harnesses.lookup("message A {}"), Ok(None));
+        // The only build slot is taken, so B waits for a later sighting.
+        assert_eq!(harnesses.lookup("message B {}"), Ok(None));
+        assert_eq!(harnesses.building(), 1);
+        assert_eq!(harnesses.built(), 0);
+
+        fs::write(cache.path().join("release"), "").unwrap();
+        harnesses.wait();
+        assert!(harnesses.lookup("message A {}").unwrap().is_some());
+        assert_eq!(harnesses.lookup("message B {}"), Ok(None));
+        harnesses.wait();
+        assert!(harnesses.lookup("message B {}").unwrap().is_some());
+        assert_eq!(harnesses.built(), 2);
+    }
+
+    #[test]
+    fn failed_build_stays_dynamic() {
+        let cache = tempfile::tempdir().unwrap();
+        let harnesses = SpecializedHarnesses::new(
+            PathBuf::from("/nonexistent/build.sh"),
+            cache.path().to_path_buf(),
+            1,
+        );
+        assert_eq!(harnesses.lookup("message M {}"), Ok(None));
+        harnesses.wait();
+        assert!(harnesses.lookup("message M {}").is_err());
+        assert_eq!(harnesses.lookup("message M {}"), Ok(None));
+        assert_eq!(harnesses.built(), 0);
+    }
+}
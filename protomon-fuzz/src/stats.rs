@@ -0,0 +1,178 @@
+//! Aggregation of the C++ harness's `--stats=json` phase timings.
+//!
+//! The harness prints its totals as one flat JSON object of integer
+//! counters: `requests`, a `<phase>_ns` per phase (import, prototype,
+//! text_parse, binary_parse, serialize, compare, text_print, write) and,
+//! with `--stats_field_sizes`, `field_bytes.<type>` per field type. Spawned
+//! harnesses print it as the last line of stderr; a server returns it for a
+//! `stats` request. [`HarnessStats`] sums those objects across processes so a
+//! campaign can report where the time went.
+
+use std::collections::BTreeMap;
+use std::fmt;
+
+/// Suffix of the per-phase nanosecond counters.
+const PHASE_SUFFIX: &str = "_ns";
+
+/// Prefix of the per-field-type byte counters.
+const FIELD_BYTES_PREFIX: &str = "field_bytes.";
+
+/// Counters summed over any number of harness stats objects.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct HarnessStats {
+    counters: BTreeMap<String, u64>,
+}
+
+impl HarnessStats {
+    /// Parse one stats object. Returns `None` unless `json` is a flat object
+    /// of non-negative integers with a `requests` counter.
+    pub fn parse(json: &str) -> Option<Self> {
+        let body = json.trim().strip_prefix('{')?.strip_suffix('}')?;
+        let mut counters = BTreeMap::new();
+        for entry in body.split(',') {
+            let (key, value) = entry.split_once(':')?;
+            let key = key.trim().strip_prefix('"')?.strip_suffix('"')?;
+            counters.insert(key.to_string(), value.trim().parse().ok()?);
+        }
+        counters
+            .contains_key("requests")
+            .then_some(Self { counters })
+    }
+
+    /// Find and parse the stats line in a spawned harness's stderr.
+    pub fn from_stderr(stderr: &str) -> Option<Self> {
+        stderr
+            .lines()
+            .rev()
+            .find(|line| line.starts_with("{\"requests\":"))
+            .and_then(Self::parse)
+    }
+
+    /// Add every counter of `other` to this one.
+    pub fn merge(&mut self, other: &HarnessStats) {
+        for (key, value) in &other.counters {
+            *self.counters.entry(key.clone()).or_default() += value;
+        }
+    }
+
+    pub fn requests(&self) -> u64 {
+        self.counter("requests")
+    }
+
+    /// The value of `key`, or 0 if no object had it.
+    pub fn counter(&self, key: &str) -> u64 {
+        self.counters.get(key).copied().unwrap_or(0)
+    }
+
+    /// `(phase, nanoseconds)` for every phase, by name.
+    pub fn phases(&self) -> impl Iterator<Item = (&str, u64)> {
+        self.counters
+            .iter()
+            .filter_map(|(key, &ns)| Some((key.strip_suffix(PHASE_SUFFIX)?, ns)))
+    }
+
+    /// `(field type, bytes)` for every field type seen.
+    pub fn field_bytes(&self) -> impl Iterator<Item = (&str, u64)> {
+        self.counters
+            .iter()
+            .filter_map(|(key, &bytes)| Some((key.strip_prefix(FIELD_BYTES_PREFIX)?, bytes)))
+    }
+}
+
+fn percent(part: u64, total: u64) -> f64 {
+    if total == 0 {
+        0.0
+    } else {
+        part as f64 * 100.0 / total as f64
+    }
+}
+
+impl fmt::Display for HarnessStats {
+    /// A table of time per phase and bytes per field type, largest first.
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let requests = self.requests();
+        let mut phases: Vec<_> = self.phases().collect();
+        phases.sort_by(|a, b| b.1.cmp(&a.1));
+        let total_ns: u64 = phases.iter().map(|(_, ns)| ns).sum();
+
+        writeln!(
+            f,
+            "{} requests, {:.3} ms in timed phases",
+            requests,
+            total_ns as f64 / 1e6
+        )?;
+        for (phase, ns) in phases {
+            let per_request_us = if requests == 0 {
+                0.0
+            } else {
+                ns as f64 / requests as f64 / 1e3
+            };
+            writeln!(
+                f,
+                "  {:<14} {:>12.3} ms {:>6.1}% {:>10.2} us/request",
+                phase,
+                ns as f64 / 1e6,
+                percent(ns, total_ns),
+                per_request_us
+            )?;
+        }
+
+        let mut fields: Vec<_> = self.field_bytes().collect();
+        if fields.is_empty() {
+            return Ok(());
+        }
+        fields.sort_by(|a, b| b.1.cmp(&a.1));
+        let total_bytes: u64 = fields.iter().map(|(_, bytes)| bytes).sum();
+        writeln!(f, "{} serialized bytes by field type", total_bytes)?;
+        for (field_type, bytes) in fields {
+            writeln!(
+                f,
+                "  {:<14} {:>12} B {:>6.1}%",
+                field_type,
+                bytes,
+                percent(bytes, total_bytes)
+            )?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn parse_and_merge() {
+        let mut total = HarnessStats::parse(
+            r#"{"requests":2,"import_ns":100,"serialize_ns":50,"field_bytes.int32":4}"#,
+        )
+        .unwrap();
+        let other = HarnessStats::parse(r#"{"requests":1,"import_ns":20,"compare_ns":5}"#).unwrap();
+        total.merge(&other);
+
+        assert_eq!(total.requests(), 3);
+        assert_eq!(total.counter("import_ns"), 120);
+        assert_eq!(total.counter("text_print_ns"), 0);
+        assert_eq!(
+            total.phases().collect::<Vec<_>>(),
+            vec![("compare", 5), ("import", 120), ("serialize", 50)]
+        );
+        assert_eq!(total.field_bytes().collect::<Vec<_>>(), vec![("int32", 4)]);
+    }
+
+    #[test]
+    fn rejects_malformed_objects() {
+        assert_eq!(HarnessStats::parse(""), None);
+        assert_eq!(HarnessStats::parse(r#"{"import_ns":1}"#), None);
+        assert_eq!(HarnessStats::parse(r#"{"requests":-1}"#), None);
+        assert_eq!(HarnessStats::parse(r#"{"requests":"1"}"#), None);
+    }
+
+    #[test]
+    fn finds_stats_line_in_stderr() {
+        let stderr = "Roundtrip OK (3 bytes)\n{\"requests\":1,\"write_ns\":7}\n";
+        let stats = HarnessStats::from_stderr(stderr).unwrap();
+        assert_eq!(stats.counter("write_ns"), 7);
+        assert_eq!(HarnessStats::from_stderr("Roundtrip OK (3 bytes)\n"), None);
+    }
+}
@@ -236,6 +236,100 @@ impl TestCase {
             .map(|(name, value)| (format!("{}.json", name), value.to_json_pretty()))
             .collect()
     }
+
+    /// This test case with every message and field renamed by position
+    /// (`Message0`, `Nested1`, `f2`, ...). Field numbers, types and values
+    /// are kept, so the wire encoding is unchanged; two cases differing
+    /// only in the names the generator picked become identical.
+    pub fn canonical(&self) -> TestCase {
+        let messages: Vec<MessageDescriptor> = self
+            .schema
+            .messages
+            .iter()
+            .enumerate()
+            .map(|(i, message)| canonical_descriptor(message, format!("Message{}", i)))
+            .collect();
+        // Values are generated in schema order, one per top-level message.
+        let values = self
+            .values
+            .iter()
+            .map(|(name, value)| {
+                let i = self
+                    .schema
+                    .messages
+                    .iter()
+                    .position(|message| &message.name == name)
+                    .expect("test case value for a message not in its schema");
+                (
+                    messages[i].name.clone(),
+                    canonical_value(value, &self.schema.messages[i]),
+                )
+            })
+            .collect();
+        TestCase {
+            schema: Schema {
+                messages,
+                ..self.schema.clone()
+            },
+            values,
+        }
+    }
+}
+
+fn canonical_descriptor(message: &MessageDescriptor, name: String) -> MessageDescriptor {
+    MessageDescriptor {
+        name,
+        fields: message
+            .fields
+            .iter()
+            .enumerate()
+            .map(|(i, field)| FieldDescriptor {
+                name: format!("f{}", i),
+                ..field.clone()
+            })
+            .collect(),
+        nested_messages: message
+            .nested_messages
+            .iter()
+            .enumerate()
+            .map(|(i, nested)| canonical_descriptor(nested, format!("Nested{}", i)))
+            .collect(),
+    }
+}
+
+/// `value`, a value of `message`, with its fields renamed to match
+/// [`canonical_descriptor`].
+fn canonical_value(value: &MessageValue, message: &MessageDescriptor) -> MessageValue {
+    fn rename(
+        value: &FieldValue,
+        field: &FieldDescriptor,
+        message: &MessageDescriptor,
+    ) -> FieldValue {
+        match (value, &field.field_type) {
+            (FieldValue::Message(nested), FieldType::Message(idx)) => FieldValue::Message(
+                Box::new(canonical_value(nested, &message.nested_messages[*idx])),
+            ),
+            (FieldValue::Repeated(values), _) => {
+                FieldValue::Repeated(values.iter().map(|v| rename(v, field, message)).collect())
+            }
+            (other, _) => other.clone(),
+        }
+    }
+
+    let fields = value
+        .fields
+        .iter()
+        .map(|(name, field_value)| {
+            let (i, field) = message
+                .fields
+                .iter()
+                .enumerate()
+                .find(|(_, field)| &field.name == name)
+                .expect("message value field not in its descriptor");
+            (format!("f{}", i), rename(field_value, field, message))
+        })
+        .collect();
+    MessageValue { fields }
 }
 
 // Helper functions
@@ -338,7 +432,7 @@ fn field_value_to_json_pretty(value: &FieldValue, indent: usize) -> Option<Strin
     }
 }
 
-fn escape_json_string(s: &str) -> String {
+pub(crate) fn escape_json_string(s: &str) -> String {
     let mut result = String::with_capacity(s.len());
     for c in s.chars() {
         match c {
@@ -743,6 +837,103 @@ mod tests {
         "#);
     }
 
+    #[test]
+    fn test_canonical_ignores_generated_names() {
+        let case = |message: &str, nested: &str, field: &str| {
+            let schema = Schema {
+                package: "fuzz.test".to_string(),
+                syntax: ProtobufSyntax::Proto3,
+                messages: vec![MessageDescriptor {
+                    name: message.to_string(),
+                    fields: vec![
+                        FieldDescriptor {
+                            name: field.to_string(),
+                            number: 7,
+                            field_type: FieldType::Message(0),
+                            cardinality: FieldCardinality::Repeated,
+                        },
+                        FieldDescriptor {
+                            name: "field_z".to_string(),
+                            number: 2,
+                            field_type: FieldType::Scalar(ScalarType::Int32),
+                            cardinality: FieldCardinality::Singular,
+                        },
+                    ],
+                    nested_messages: vec![MessageDescriptor {
+                        name: nested.to_string(),
+                        fields: vec![FieldDescriptor {
+                            name: field.to_string(),
+                            number: 1,
+                            field_type: FieldType::Scalar(ScalarType::String),
+                            cardinality: FieldCardinality::Singular,
+                        }],
+                        nested_messages: vec![],
+                    }],
+                }],
+            };
+            let mut inner = MessageValue::new();
+            inner.fields.insert(
+                field.to_string(),
+                FieldValue::Scalar(ScalarValue::String("x".to_string())),
+            );
+            let mut value = MessageValue::new();
+            value.fields.insert(
+                field.to_string(),
+                FieldValue::Repeated(vec![FieldValue::Message(Box::new(inner))]),
+            );
+            value.fields.insert(
+                "field_z".to_string(),
+                FieldValue::Scalar(ScalarValue::Int32(3)),
+            );
+            TestCase {
+                schema,
+                values: vec![(message.to_string(), value)],
+            }
+        };
+
+        let key = |case: &TestCase| {
+            let canonical = case.canonical();
+            let (name, value) = &canonical.values[0];
+            format!(
+                "{}# {}\n{}",
+                canonical.to_proto(),
+                name,
+                value.to_text_format()
+            )
+        };
+        let a = case("RootMessageA", "NestedMessageB", "field_a");
+        let b = case("RootMessageQ", "NestedMessageR", "field_k");
+        assert_ne!(a.to_proto(), b.to_proto());
+        assert_eq!(key(&a), key(&b));
+        assert_snapshot!(key(&a), @r#"
+        syntax = "proto3";
+
+        package fuzz.test;
+
+        message Message0 {
+          message Nested0 {
+            string f0 = 1;
+          }
+          repeated Nested0 f0 = 7;
+          int32 f1 = 2;
+        }
+
+        # Message0
+        f0 {
+          f0: "x"
+        }
+        f1: 3
+        "#);
+
+        // A different value is a different case.
+        let mut c = case("RootMessageA", "NestedMessageB", "field_a");
+        c.values[0].1.fields.insert(
+            "field_z".to_string(),
+            FieldValue::Scalar(ScalarValue::Int32(4)),
+        );
+        assert_ne!(key(&a), key(&c));
+    }
+
     #[test]
     fn test_full_example() {
         // Manually construct a schema and values to show the full flow
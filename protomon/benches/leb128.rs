@@ -1,4 +1,6 @@
-use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use std::path::Path;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
 use protomon::leb128::{decode_u64_impl_a, LebCodec};
 
 fn leb128_decoding_single(c: &mut Criterion) {
@@ -88,6 +90,150 @@ fn leb128_decoding_many(c: &mut Criterion) {
         },
     );
 }
-criterion_group!(decoding, leb128_decoding_single, leb128_decoding_many);
+/// A varint payload from a `generate_binaries --synthesize` corpus, with what
+/// C++ `CodedInputStream::ReadVarint64` made of it (`varint_reference.txt`).
+struct ReferenceCase {
+    name: String,
+    values: u64,
+    sum: u64,
+    cpp_ns_per_pass: u64,
+    /// The packed varints, followed by 16 zero bytes so both decoders can
+    /// read past the last one.
+    packed: Vec<u8>,
+}
+
+/// Padding after the packed varints; `decode_u64_impl_a` reads 16 bytes.
+const CORPUS_PADDING: usize = 16;
+
+fn load_reference_cases(dir: &Path) -> Vec<ReferenceCase> {
+    let reference = std::fs::read_to_string(dir.join("varint_reference.txt")).unwrap_or_else(|e| {
+        panic!(
+            "Failed to read {}/varint_reference.txt: {}",
+            dir.display(),
+            e
+        )
+    });
+
+    reference
+        .lines()
+        .filter(|line| !line.is_empty() && !line.starts_with('#'))
+        .map(|line| {
+            let fields: Vec<&str> = line.split(' ').collect();
+            let [name, values, sum, ns] = fields[..] else {
+                panic!("Invalid line in varint_reference.txt: {}", line);
+            };
+            let path = dir.join(format!("{}.bin", name));
+            let payload =
+                std::fs::read(&path).unwrap_or_else(|e| panic!("Failed to read {:?}: {}", path, e));
+
+            // The payload is one packed field: skip its key and length.
+            let mut packed = Vec::new();
+            if !payload.is_empty() {
+                let (_key, key_len) = u64::decode_leb128_safe(&payload).expect("field key");
+                let key_len = usize::from(key_len.get());
+                let (len, len_len) =
+                    u64::decode_leb128_safe(&payload[key_len..]).expect("field length");
+                let start = key_len + usize::from(len_len.get());
+                assert_eq!(
+                    start as u64 + len,
+                    payload.len() as u64,
+                    "{}: trailing data",
+                    name
+                );
+                packed.extend_from_slice(&payload[start..]);
+            }
+            packed.resize(packed.len() + CORPUS_PADDING, 0);
+
+            ReferenceCase {
+                name: name.to_string(),
+                values: values.parse().unwrap(),
+                sum: sum.parse().unwrap(),
+                cpp_ns_per_pass: ns.parse().unwrap(),
+                packed,
+            }
+        })
+        .collect()
+}
+
+/// Decode every varint in `packed` with `decode`, returning their count and
+/// wrapping sum.
+#[inline(always)]
+fn decode_all(packed: &[u8], decode: impl Fn(*const u8) -> (u64, usize)) -> (u64, u64) {
+    let end = packed.len() - CORPUS_PADDING;
+    let (mut offset, mut count, mut sum) = (0, 0u64, 0u64);
+    while offset < end {
+        // SAFETY: `packed` has CORPUS_PADDING readable bytes past `end`.
+        let (value, len) = decode(unsafe { packed.as_ptr().add(offset) });
+        offset += len;
+        count += 1;
+        sum = sum.wrapping_add(value);
+    }
+    (count, sum)
+}
+
+fn decode_protomon(data: *const u8) -> (u64, usize) {
+    let (value, len) = unsafe { u64::decode_leb128(data) }.expect("valid varint");
+    (value, usize::from(len.get()))
+}
+
+fn decode_impl_a(data: *const u8) -> (u64, usize) {
+    let (value, len) = unsafe { decode_u64_impl_a(data) };
+    (value, len as usize)
+}
+
+/// Both decoders over the synthetic corpus's production-shaped varint
+/// payloads. Each must read the same values C++ did (same count and sum)
+/// before it is timed; C++'s own time per pass is printed alongside.
+///
+/// ```text
+/// PROTOMON_VARINT_CORPUS=/path/to/bench_corpus cargo bench --bench leb128 -- decoding_corpus
+/// ```
+fn leb128_decoding_corpus(c: &mut Criterion) {
+    let Some(dir) = std::env::var_os("PROTOMON_VARINT_CORPUS") else {
+        eprintln!("PROTOMON_VARINT_CORPUS is not set; skipping decoding_corpus");
+        return;
+    };
+
+    let mut group = c.benchmark_group("decoding_corpus");
+    for case in load_reference_cases(Path::new(&dir)) {
+        for (decoder, decode) in [
+            ("protomon", decode_protomon as fn(*const u8) -> (u64, usize)),
+            ("protomon impl_a", decode_impl_a),
+        ] {
+            assert_eq!(
+                decode_all(&case.packed, decode),
+                (case.values, case.sum),
+                "{} decodes {} differently from ReadVarint64",
+                decoder,
+                case.name
+            );
+        }
+        eprintln!(
+            "decoding_corpus/cpp ReadVarint64/{}: {:.3} ns/varint",
+            case.name,
+            case.cpp_ns_per_pass as f64 / case.values.max(1) as f64
+        );
+
+        group.throughput(Throughput::Elements(case.values));
+        group.bench_with_input(
+            BenchmarkId::new("protomon", &case.name),
+            &case,
+            |b, case| b.iter(|| decode_all(std::hint::black_box(&case.packed), decode_protomon)),
+        );
+        group.bench_with_input(
+            BenchmarkId::new("protomon impl_a", &case.name),
+            &case,
+            |b, case| b.iter(|| decode_all(std::hint::black_box(&case.packed), decode_impl_a)),
+        );
+    }
+    group.finish();
+}
+
+criterion_group!(
+    decoding,
+    leb128_decoding_single,
+    leb128_decoding_many,
+    leb128_decoding_corpus
+);
 
 criterion_main!(decoding);
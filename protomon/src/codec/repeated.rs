@@ -375,6 +375,14 @@ impl<T: ProtoDecode + Default + Clone + 'static> Iterator for RepeatedIter<'_, T
         }
     }
 
+    #[inline]
+    fn nth(&mut self, n: usize) -> Option<Self::Item> {
+        match self {
+            Self::Decode(iter) => iter.nth(n),
+            Self::Owned(iter) => iter.nth(n).cloned().map(Ok),
+        }
+    }
+
     #[inline]
     fn size_hint(&self) -> (usize, Option<usize>) {
         match self {
@@ -425,6 +433,16 @@ impl<T: ProtoDecode + Default> Iterator for RepeatedDecodeIter<'_, T> {
         Some(result.map(|()| value))
     }
 
+    /// Skips `n` elements without decoding them, so `step_by` and `skip`
+    /// only pay for the elements they return.
+    #[inline]
+    fn nth(&mut self, n: usize) -> Option<Self::Item> {
+        if n > 0 {
+            self.offset_iter.nth(n - 1)?;
+        }
+        self.next()
+    }
+
     #[inline]
     fn size_hint(&self) -> (usize, Option<usize>) {
         self.offset_iter.size_hint()
@@ -630,6 +648,41 @@ mod tests {
         assert_eq!(strings2, vec!["hello", "world", "!"]);
     }
 
+    #[test]
+    fn test_repeated_nth() {
+        let bytes_buf = bytes::Bytes::from(build_test_message());
+        let mut repeated: Repeated<ProtoString> = Repeated::default();
+        repeated.init_repeated(&bytes_buf, 2);
+        let mut slice = &bytes_buf[..];
+        while !slice.is_empty() {
+            let (wire_type, tag) = crate::wire::decode_key(&mut slice).unwrap().into_parts();
+            let value_offset = bytes_buf.len() - slice.len();
+            if tag == 2 {
+                <Repeated<ProtoString> as ProtoDecode>::decode_into(
+                    &mut slice,
+                    &mut repeated,
+                    value_offset,
+                )
+                .unwrap();
+            } else {
+                crate::wire::skip_field(wire_type, &mut slice).unwrap();
+            }
+        }
+
+        let every_other: Vec<String> = repeated
+            .iter()
+            .step_by(2)
+            .map(|r| r.unwrap().as_str().to_string())
+            .collect();
+        assert_eq!(every_other, vec!["hello", "!"]);
+        assert_eq!(repeated.iter().nth(1).unwrap().unwrap().as_str(), "world");
+        assert!(repeated.iter().nth(3).is_none());
+
+        let owned = Repeated::owned(vec![1i32, 2, 3]);
+        assert_eq!(owned.iter().nth(2).unwrap().unwrap(), 3);
+        assert!(owned.iter().nth(3).is_none());
+    }
+
     #[test]
     fn test_repeated_encode() {
         use crate::wire::decode_key;
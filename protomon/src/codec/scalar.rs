@@ -166,7 +166,7 @@ pub(crate) fn zigzag_decode_32(n: u32) -> i32 {
 }
 
 /// Wrapper for protobuf `sint32` (zigzag-encoded signed 32-bit integer).
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Default)]
 #[repr(transparent)]
 pub struct Sint32(pub i32);
 
@@ -216,7 +216,7 @@ pub(crate) fn zigzag_decode_64(n: u64) -> i64 {
 }
 
 /// Wrapper for protobuf `sint64` (zigzag-encoded signed 64-bit integer).
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Default)]
 #[repr(transparent)]
 pub struct Sint64(pub i64);
 
@@ -256,7 +256,7 @@ impl ProtoEncode for Sint64 {
 }
 
 /// Wrapper for protobuf `fixed32` (little-endian unsigned 32-bit integer).
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Default)]
 #[repr(transparent)]
 pub struct Fixed32(pub u32);
 
@@ -299,7 +299,7 @@ impl ProtoEncode for Fixed32 {
 }
 
 /// Wrapper for protobuf `fixed64` (little-endian unsigned 64-bit integer).
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Default)]
 #[repr(transparent)]
 pub struct Fixed64(pub u64);
 
@@ -342,7 +342,7 @@ impl ProtoEncode for Fixed64 {
 }
 
 /// Wrapper for protobuf `sfixed32` (little-endian signed 32-bit integer).
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Default)]
 #[repr(transparent)]
 pub struct Sfixed32(pub i32);
 
@@ -385,7 +385,7 @@ impl ProtoEncode for Sfixed32 {
 }
 
 /// Wrapper for protobuf `sfixed64` (little-endian signed 64-bit integer).
-#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Default)]
 #[repr(transparent)]
 pub struct Sfixed64(pub i64);
 